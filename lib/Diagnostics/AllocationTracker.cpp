@@ -0,0 +1,125 @@
+#include <AllocationTracker.h>
+
+// Core 2.4.x doesn't expose ESP.getMaxFreeBlockSize(), so go straight to the
+// allocator.  umm_info walks the heap and fills in ummHeapInfo.
+extern "C" {
+#include <umm_malloc/umm_malloc.h>
+}
+
+// umm_malloc allocates in 8 byte blocks
+#define UMM_BLOCK_SIZE 8
+
+static const char MQTT_TOPIC_STRING_NAME[] PROGMEM = "mqtt_topic_string";
+static const char MQTT_DISCOVERY_DOCUMENT_NAME[] PROGMEM = "mqtt_discovery_document";
+static const char PACKET_QUEUE_ENTRY_NAME[] PROGMEM = "packet_queue_entry";
+static const char TRANSITION_BUILDER_NAME[] PROGMEM = "transition_builder";
+static const char ABOUT_DOCUMENT_NAME[] PROGMEM = "about_document";
+static const char SETTINGS_DOCUMENT_NAME[] PROGMEM = "settings_document";
+
+static const char* const SITE_NAMES[] PROGMEM = {
+  MQTT_TOPIC_STRING_NAME,
+  MQTT_DISCOVERY_DOCUMENT_NAME,
+  PACKET_QUEUE_ENTRY_NAME,
+  TRANSITION_BUILDER_NAME,
+  ABOUT_DOCUMENT_NAME,
+  SETTINGS_DOCUMENT_NAME
+};
+
+static_assert(
+  sizeof(SITE_NAMES) / sizeof(SITE_NAMES[0]) == AllocationTracker::NUM_SITES,
+  "Every AllocationSite needs a name"
+);
+
+AllocationSiteStats AllocationTracker::siteStats[AllocationTracker::NUM_SITES] = { };
+uint32_t AllocationTracker::minFreeHeap = UINT32_MAX;
+
+void AllocationTracker::record(AllocationSite site, size_t bytes) {
+  AllocationSiteStats& stats = siteStats[static_cast<size_t>(site)];
+
+  ++stats.count;
+  stats.bytes += bytes;
+
+  // Allocations tend to be short-lived, so this is where the low points are
+  sampleFreeHeap();
+}
+
+void AllocationTracker::loop() {
+  sampleFreeHeap();
+}
+
+void AllocationTracker::sampleFreeHeap() {
+  uint32_t freeHeap = ESP.getFreeHeap();
+
+  if (freeHeap < minFreeHeap) {
+    minFreeHeap = freeHeap;
+  }
+}
+
+uint32_t AllocationTracker::getMinFreeHeap() {
+  sampleFreeHeap();
+  return minFreeHeap;
+}
+
+uint32_t AllocationTracker::getLargestFreeBlock() {
+  umm_info(NULL, 0);
+  return static_cast<uint32_t>(ummHeapInfo.maxFreeContiguousBlocks) * UMM_BLOCK_SIZE;
+}
+
+uint8_t AllocationTracker::getFragmentation() {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largestBlock = getLargestFreeBlock();
+
+  if (freeHeap == 0 || largestBlock >= freeHeap) {
+    return 0;
+  }
+
+  return 100 - ((largestBlock * 100) / freeHeap);
+}
+
+const AllocationSiteStats& AllocationTracker::getSiteStats(AllocationSite site) {
+  return siteStats[static_cast<size_t>(site)];
+}
+
+const __FlashStringHelper* AllocationTracker::siteName(AllocationSite site) {
+  return reinterpret_cast<const __FlashStringHelper*>(
+    pgm_read_ptr(&SITE_NAMES[static_cast<size_t>(site)])
+  );
+}
+
+void AllocationTracker::serialize(JsonObject json, size_t maxSites) {
+  json[F("free_heap")] = ESP.getFreeHeap();
+  json[F("min_free_heap")] = getMinFreeHeap();
+  json[F("largest_free_block")] = getLargestFreeBlock();
+  json[F("fragmentation")] = getFragmentation();
+
+#ifdef MILIGHT_ALLOCATION_TRACKING
+  json[F("tracking_enabled")] = true;
+#else
+  json[F("tracking_enabled")] = false;
+#endif
+
+  // Selection sort over a handful of sites -- cheaper than anything clever
+  bool reported[NUM_SITES] = { };
+  JsonArray sites = json.createNestedArray(F("top_sites"));
+
+  for (size_t i = 0; i < maxSites && i < NUM_SITES; i++) {
+    int8_t top = -1;
+
+    for (size_t j = 0; j < NUM_SITES; j++) {
+      if (!reported[j] && siteStats[j].count > 0 && (top == -1 || siteStats[j].bytes > siteStats[top].bytes)) {
+        top = j;
+      }
+    }
+
+    if (top == -1) {
+      break;
+    }
+
+    reported[top] = true;
+
+    JsonObject site = sites.createNestedObject();
+    site[F("site")] = siteName(static_cast<AllocationSite>(top));
+    site[F("count")] = siteStats[top].count;
+    site[F("bytes")] = siteStats[top].bytes;
+  }
+}
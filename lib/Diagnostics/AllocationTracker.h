@@ -0,0 +1,70 @@
+// Opt-in heap profiler.  Counts allocations made at known hot call sites and
+// tracks how low free heap gets.  Build with -D MILIGHT_ALLOCATION_TRACKING
+// to enable it.  Current free heap and fragmentation are always reported, but
+// without tracking the minimum is only sampled when stats are read, so it
+// isn't a real low-water mark.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#ifndef _ALLOCATION_TRACKER_H
+#define _ALLOCATION_TRACKER_H
+
+// Number of call sites included in reports, ordered by bytes allocated
+#ifndef ALLOCATION_TRACKER_TOP_SITES
+#define ALLOCATION_TRACKER_TOP_SITES 5
+#endif
+
+enum class AllocationSite : uint8_t {
+  MQTT_TOPIC_STRING = 0,
+  MQTT_DISCOVERY_DOCUMENT,
+  PACKET_QUEUE_ENTRY,
+  TRANSITION_BUILDER,
+  ABOUT_DOCUMENT,
+  SETTINGS_DOCUMENT,
+
+  // Not a site, keep last
+  NUM_SITES
+};
+
+struct AllocationSiteStats {
+  uint32_t count;
+  uint32_t bytes;
+};
+
+class AllocationTracker {
+public:
+  static const size_t NUM_SITES = static_cast<size_t>(AllocationSite::NUM_SITES);
+
+  static void record(AllocationSite site, size_t bytes);
+
+  // Samples free heap.  Call once per main loop iteration.
+  static void loop();
+
+  // Lowest free heap seen by a sample.  Only sampled every loop and at each
+  // tracked allocation when MILIGHT_ALLOCATION_TRACKING is on.
+  static uint32_t getMinFreeHeap();
+  static uint32_t getLargestFreeBlock();
+  // 0 is a single contiguous free region, 100 is fully fragmented
+  static uint8_t getFragmentation();
+  static const AllocationSiteStats& getSiteStats(AllocationSite site);
+  static const __FlashStringHelper* siteName(AllocationSite site);
+
+  static void serialize(JsonObject json, size_t maxSites = ALLOCATION_TRACKER_TOP_SITES);
+
+private:
+  static AllocationSiteStats siteStats[NUM_SITES];
+  static uint32_t minFreeHeap;
+
+  static void sampleFreeHeap();
+};
+
+#ifdef MILIGHT_ALLOCATION_TRACKING
+#define TRACK_ALLOCATION(site, bytes) AllocationTracker::record(AllocationSite::site, bytes)
+#define TRACK_HEAP() AllocationTracker::loop()
+#else
+#define TRACK_ALLOCATION(site, bytes)
+#define TRACK_HEAP()
+#endif
+
+#endif
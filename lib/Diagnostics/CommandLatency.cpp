@@ -0,0 +1,141 @@
+#include <CommandLatency.h>
+#include <algorithm>
+
+static const char UNKNOWN_NAME[] PROGMEM = "unknown";
+static const char HTTP_NAME[] PROGMEM = "http";
+static const char MQTT_NAME[] PROGMEM = "mqtt";
+static const char UDP_V5_NAME[] PROGMEM = "udp_v5";
+static const char UDP_V6_NAME[] PROGMEM = "udp_v6";
+static const char TRANSITION_NAME[] PROGMEM = "transition";
+
+static const char* const SOURCE_NAMES[] PROGMEM = {
+  UNKNOWN_NAME,
+  HTTP_NAME,
+  MQTT_NAME,
+  UDP_V5_NAME,
+  UDP_V6_NAME,
+  TRANSITION_NAME
+};
+
+static_assert(
+  sizeof(SOURCE_NAMES) / sizeof(SOURCE_NAMES[0]) == CommandLatency::NUM_SOURCES,
+  "Every CommandSource needs a name"
+);
+
+static const char DEQUEUE_NAME[] PROGMEM = "dequeue";
+static const char FIRST_TRANSMIT_NAME[] PROGMEM = "first_transmit";
+static const char SENT_NAME[] PROGMEM = "sent";
+
+static const char* const STAGE_NAMES[] PROGMEM = {
+  DEQUEUE_NAME,
+  FIRST_TRANSMIT_NAME,
+  SENT_NAME
+};
+
+static_assert(
+  sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == CommandLatency::NUM_STAGES,
+  "Every LatencyStage needs a name"
+);
+
+LatencyHistogram CommandLatency::histograms[CommandLatency::NUM_SOURCES][CommandLatency::NUM_STAGES] = { };
+
+void CommandLatency::record(const CommandStamp& stamp, LatencyStage stage) {
+  if (stamp.source == CommandSource::UNKNOWN) {
+    return;
+  }
+
+  const uint32_t elapsed = micros() - stamp.ingressMicros;
+  LatencyHistogram& histogram = histograms[static_cast<size_t>(stamp.source)][static_cast<size_t>(stage)];
+  uint16_t& bucket = histogram.buckets[bucketFor(elapsed)];
+
+  ++histogram.count;
+  histogram.total += elapsed;
+
+  if (elapsed > histogram.max) {
+    histogram.max = elapsed;
+  }
+  if (bucket < UINT16_MAX) {
+    ++bucket;
+  }
+}
+
+void CommandLatency::reset() {
+  memset(histograms, 0, sizeof(histograms));
+}
+
+const LatencyHistogram& CommandLatency::getHistogram(CommandSource source, LatencyStage stage) {
+  return histograms[static_cast<size_t>(source)][static_cast<size_t>(stage)];
+}
+
+const __FlashStringHelper* CommandLatency::sourceName(CommandSource source) {
+  return reinterpret_cast<const __FlashStringHelper*>(
+    pgm_read_ptr(&SOURCE_NAMES[static_cast<size_t>(source)])
+  );
+}
+
+const __FlashStringHelper* CommandLatency::stageName(LatencyStage stage) {
+  return reinterpret_cast<const __FlashStringHelper*>(
+    pgm_read_ptr(&STAGE_NAMES[static_cast<size_t>(stage)])
+  );
+}
+
+uint8_t CommandLatency::bucketFor(uint32_t micros) {
+  const uint32_t millis = micros / 1000;
+
+  if (millis == 0) {
+    return 0;
+  }
+
+  const uint8_t bucket = 32 - __builtin_clz(millis);
+  return std::min(bucket, static_cast<uint8_t>(COMMAND_LATENCY_BUCKETS - 1));
+}
+
+uint32_t CommandLatency::percentile(const LatencyHistogram& histogram, uint8_t percent) {
+  const uint32_t target = (histogram.count * percent + 99) / 100;
+  uint32_t seen = 0;
+
+  for (uint8_t i = 0; i < COMMAND_LATENCY_BUCKETS - 1; i++) {
+    seen += histogram.buckets[i];
+
+    if (seen >= target) {
+      // Upper edge of the bucket, but never more than was actually seen
+      return std::min(1000UL << i, static_cast<unsigned long>(histogram.max));
+    }
+  }
+
+  return histogram.max;
+}
+
+void CommandLatency::serialize(JsonObject json) {
+  JsonArray bounds = json.createNestedArray(F("bucket_upper_bounds_ms"));
+  for (uint8_t i = 0; i < COMMAND_LATENCY_BUCKETS - 1; i++) {
+    bounds.add(1UL << i);
+  }
+
+  JsonObject sources = json.createNestedObject(F("sources"));
+
+  // Unstamped packets aren't recorded, so skip UNKNOWN
+  for (size_t i = 1; i < NUM_SOURCES; i++) {
+    if (histograms[i][0].count == 0) {
+      continue;
+    }
+
+    JsonObject source = sources.createNestedObject(sourceName(static_cast<CommandSource>(i)));
+
+    for (size_t j = 0; j < NUM_STAGES; j++) {
+      const LatencyHistogram& histogram = histograms[i][j];
+      JsonObject stage = source.createNestedObject(stageName(static_cast<LatencyStage>(j)));
+
+      stage[F("count")] = histogram.count;
+      stage[F("avg_us")] = histogram.count > 0 ? static_cast<uint32_t>(histogram.total / histogram.count) : 0;
+      stage[F("p50_us")] = percentile(histogram, 50);
+      stage[F("p99_us")] = percentile(histogram, 99);
+      stage[F("max_us")] = histogram.max;
+
+      JsonArray buckets = stage.createNestedArray(F("histogram"));
+      for (uint8_t k = 0; k < COMMAND_LATENCY_BUCKETS; k++) {
+        buckets.add(histogram.buckets[k]);
+      }
+    }
+  }
+}
@@ -0,0 +1,87 @@
+// Traces commands from the moment they arrive to the moment their packets
+// are on the air.  Each command is stamped with its source and arrival time,
+// and the stamp travels with its packets through PacketSender.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#ifndef _COMMAND_LATENCY_H
+#define _COMMAND_LATENCY_H
+
+// Buckets are powers of two milliseconds: <1ms, 1-2ms, 2-4ms, ... and the
+// last one collects everything past ~1s
+#define COMMAND_LATENCY_BUCKETS 12
+
+enum class CommandSource : uint8_t {
+  // Packets nothing stamped.  Not traced.
+  UNKNOWN = 0,
+  HTTP,
+  MQTT,
+  UDP_V5,
+  UDP_V6,
+  TRANSITION,
+
+  // Not a source, keep last
+  NUM_SOURCES
+};
+
+// Points a command's packets pass on their way out.  Each is measured from
+// when the command arrived.
+enum class LatencyStage : uint8_t {
+  // Taken off the queue to be sent
+  DEQUEUE = 0,
+  // First repeat written to the radio
+  FIRST_TRANSMIT,
+  // Last repeat written, just before the packet sent handler runs
+  SENT,
+
+  // Not a stage, keep last
+  NUM_STAGES
+};
+
+struct CommandStamp {
+  CommandStamp()
+    : source(CommandSource::UNKNOWN),
+      ingressMicros(0)
+  { }
+
+  explicit CommandStamp(CommandSource source)
+    : source(source),
+      ingressMicros(micros())
+  { }
+
+  CommandSource source;
+  uint32_t ingressMicros;
+};
+
+struct LatencyHistogram {
+  uint32_t count;
+  uint32_t max;
+  uint64_t total;
+  uint16_t buckets[COMMAND_LATENCY_BUCKETS];
+};
+
+class CommandLatency {
+public:
+  static const size_t NUM_SOURCES = static_cast<size_t>(CommandSource::NUM_SOURCES);
+  static const size_t NUM_STAGES = static_cast<size_t>(LatencyStage::NUM_STAGES);
+
+  // Records the time from the stamp until now
+  static void record(const CommandStamp& stamp, LatencyStage stage);
+  static void reset();
+
+  static const LatencyHistogram& getHistogram(CommandSource source, LatencyStage stage);
+  static const __FlashStringHelper* sourceName(CommandSource source);
+  static const __FlashStringHelper* stageName(LatencyStage stage);
+
+  static void serialize(JsonObject json);
+
+private:
+  static LatencyHistogram histograms[NUM_SOURCES][NUM_STAGES];
+
+  static uint8_t bucketFor(uint32_t micros);
+  // Estimated from the histogram, in microseconds
+  static uint32_t percentile(const LatencyHistogram& histogram, uint8_t percent);
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include <LoopProfiler.h>
+#include <algorithm>
+
+// Histogram counts are 16 bits, and each stage runs at most once per loop
+static_assert(LOOP_PROFILER_WINDOW <= UINT16_MAX, "LOOP_PROFILER_WINDOW is too large");
+
+static const char HTTP_NAME[] PROGMEM = "http";
+static const char MQTT_NAME[] PROGMEM = "mqtt";
+static const char HA_DISCOVERY_NAME[] PROGMEM = "ha_discovery";
+static const char UDP_NAME[] PROGMEM = "udp";
+static const char DISCOVERY_NAME[] PROGMEM = "discovery";
+static const char LISTEN_NAME[] PROGMEM = "listen";
+static const char STATE_FLUSH_NAME[] PROGMEM = "state_flush";
+static const char PACKET_SENDER_NAME[] PROGMEM = "packet_sender";
+static const char LED_NAME[] PROGMEM = "led";
+static const char TRANSITIONS_NAME[] PROGMEM = "transitions";
+static const char PACKET_LOG_NAME[] PROGMEM = "packet_log";
+
+static const char* const STAGE_NAMES[] PROGMEM = {
+  HTTP_NAME,
+  MQTT_NAME,
+  HA_DISCOVERY_NAME,
+  UDP_NAME,
+  DISCOVERY_NAME,
+  LISTEN_NAME,
+  STATE_FLUSH_NAME,
+  PACKET_SENDER_NAME,
+  LED_NAME,
+  TRANSITIONS_NAME,
+  PACKET_LOG_NAME
+};
+
+static_assert(
+  sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == LoopProfiler::NUM_STAGES,
+  "Every LoopStage needs a name"
+);
+
+LoopProfiler::StageWindow LoopProfiler::windows[LoopProfiler::NUM_STAGES] = { };
+LoopStageSummary LoopProfiler::summaries[LoopProfiler::NUM_STAGES] = { };
+uint32_t LoopProfiler::budgets[LoopProfiler::NUM_STAGES] = { };
+uint32_t LoopProfiler::stageStart = 0;
+uint16_t LoopProfiler::loopsInWindow = 0;
+
+void LoopProfiler::beginLoop() {
+  if (++loopsInWindow >= LOOP_PROFILER_WINDOW) {
+    rollWindow();
+  }
+
+  stageStart = ESP.getCycleCount();
+}
+
+void LoopProfiler::endStage(LoopStage stage) {
+  // Unsigned subtraction copes with the counter wrapping
+  const uint32_t elapsed = (ESP.getCycleCount() - stageStart) / ESP.getCpuFreqMHz();
+  const size_t ix = static_cast<size_t>(stage);
+  StageWindow& window = windows[ix];
+
+  if (window.samples == 0 || elapsed < window.min) {
+    window.min = elapsed;
+  }
+  if (elapsed > window.max) {
+    window.max = elapsed;
+  }
+
+  ++window.samples;
+  window.total += elapsed;
+  ++window.histogram[bucketFor(elapsed)];
+
+  if (budgets[ix] > 0 && elapsed > budgets[ix]) {
+    ++window.overruns;
+
+    // Once per window is enough to point at the culprit
+    if (! window.warned) {
+      window.warned = true;
+
+      Serial.print(F("WARNING: loop stage "));
+      Serial.print(stageName(stage));
+      Serial.printf_P(
+        PSTR(" took %luus (budget %luus)\n"),
+        static_cast<unsigned long>(elapsed),
+        static_cast<unsigned long>(budgets[ix])
+      );
+    }
+  }
+
+  // Restart the clock last so the bookkeeping above isn't charged to the next stage
+  stageStart = ESP.getCycleCount();
+}
+
+void LoopProfiler::deferStage(LoopStage stage) {
+  ++windows[static_cast<size_t>(stage)].deferrals;
+}
+
+void LoopProfiler::setBudgets(const std::vector<uint32_t>& stageBudgets) {
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    budgets[i] = i < stageBudgets.size() ? stageBudgets[i] : 0;
+  }
+}
+
+const LoopStageSummary& LoopProfiler::getSummary(LoopStage stage) {
+  return summaries[static_cast<size_t>(stage)];
+}
+
+const __FlashStringHelper* LoopProfiler::stageName(LoopStage stage) {
+  return reinterpret_cast<const __FlashStringHelper*>(
+    pgm_read_ptr(&STAGE_NAMES[static_cast<size_t>(stage)])
+  );
+}
+
+int8_t LoopProfiler::stageFromName(const char* name) {
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    if (strcmp_P(name, reinterpret_cast<const char*>(pgm_read_ptr(&STAGE_NAMES[i]))) == 0) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+// Two buckets per power of two: 0, 1, 2, 3, 4-5, 6-7, 8-11, 12-15, ...
+uint8_t LoopProfiler::bucketFor(uint32_t micros) {
+  if (micros < 2) {
+    return micros;
+  }
+
+  const uint8_t log2 = 31 - __builtin_clz(micros);
+  const uint8_t bucket = 2*log2 + ((micros >> (log2 - 1)) & 1);
+
+  return bucket < LOOP_PROFILER_BUCKETS ? bucket : LOOP_PROFILER_BUCKETS - 1;
+}
+
+uint32_t LoopProfiler::bucketUpperBound(uint8_t bucket) {
+  if (bucket < 2) {
+    return bucket;
+  }
+
+  const uint8_t log2 = bucket / 2;
+  return (1UL << log2) + ((bucket & 1) + 1) * (1UL << (log2 - 1)) - 1;
+}
+
+void LoopProfiler::rollWindow() {
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    StageWindow& window = windows[i];
+    LoopStageSummary& summary = summaries[i];
+
+    summary.samples = window.samples;
+    summary.overruns = window.overruns;
+    summary.deferrals = window.deferrals;
+
+    if (window.samples == 0) {
+      summary.min = summary.avg = summary.p99 = summary.max = 0;
+    } else {
+      summary.min = window.min;
+      summary.avg = window.total / window.samples;
+      summary.max = window.max;
+
+      // Upper edge of the bucket holding the 99th percentile sample, which
+      // can't be more than the largest sample actually seen
+      const uint32_t target = (window.samples * 99 + 99) / 100;
+      uint32_t seen = 0;
+      uint8_t bucket = 0;
+
+      for (; bucket < LOOP_PROFILER_BUCKETS - 1; bucket++) {
+        seen += window.histogram[bucket];
+
+        if (seen >= target) {
+          break;
+        }
+      }
+
+      summary.p99 = std::min(bucketUpperBound(bucket), window.max);
+    }
+
+    memset(&window, 0, sizeof(window));
+  }
+
+  loopsInWindow = 0;
+}
+
+void LoopProfiler::serialize(JsonObject json) {
+  json[F("window")] = LOOP_PROFILER_WINDOW;
+  JsonObject stages = json.createNestedObject(F("stages"));
+
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    const LoopStageSummary& summary = summaries[i];
+
+    if (summary.samples == 0 && summary.deferrals == 0 && budgets[i] == 0) {
+      continue;
+    }
+
+    JsonObject stage = stages.createNestedObject(stageName(static_cast<LoopStage>(i)));
+    stage[F("samples")] = summary.samples;
+    stage[F("min_us")] = summary.min;
+    stage[F("avg_us")] = summary.avg;
+    stage[F("p99_us")] = summary.p99;
+    stage[F("max_us")] = summary.max;
+    stage[F("budget_us")] = budgets[i];
+    stage[F("overruns")] = summary.overruns;
+    stage[F("deferrals")] = summary.deferrals;
+  }
+}
+
+void LoopProfiler::serializeCompact(JsonObject json) {
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    const LoopStageSummary& summary = summaries[i];
+
+    if (summary.samples == 0) {
+      continue;
+    }
+
+    JsonArray stage = json.createNestedArray(stageName(static_cast<LoopStage>(i)));
+    stage.add(summary.avg);
+    stage.add(summary.p99);
+    stage.add(summary.max);
+  }
+}
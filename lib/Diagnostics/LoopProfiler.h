@@ -0,0 +1,98 @@
+// Times each stage of the main loop with the CPU cycle counter.  Keeps
+// min/avg/p99/max over a window of loop iterations, and warns when a stage
+// goes over its budget (see the loop_stage_budgets setting).
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+
+#ifndef _LOOP_PROFILER_H
+#define _LOOP_PROFILER_H
+
+// Number of loop iterations figures are reported over
+#ifndef LOOP_PROFILER_WINDOW
+#define LOOP_PROFILER_WINDOW 1000
+#endif
+
+// Histogram buckets used for p99.  Two per power of two microseconds, so
+// anything past ~65ms lands in the last one.
+#define LOOP_PROFILER_BUCKETS 32
+
+enum class LoopStage : uint8_t {
+  HTTP = 0,
+  MQTT,
+  HA_DISCOVERY,
+  UDP,
+  DISCOVERY,
+  LISTEN,
+  STATE_FLUSH,
+  PACKET_SENDER,
+  LED,
+  TRANSITIONS,
+  PACKET_LOG,
+
+  // Not a stage, keep last
+  NUM_STAGES
+};
+
+// Figures for the last complete window, in microseconds
+struct LoopStageSummary {
+  uint32_t samples;
+  uint32_t min;
+  uint32_t avg;
+  uint32_t p99;
+  uint32_t max;
+  uint32_t overruns;
+  uint32_t deferrals;
+};
+
+class LoopProfiler {
+public:
+  static const size_t NUM_STAGES = static_cast<size_t>(LoopStage::NUM_STAGES);
+
+  // Call at the top of loop()
+  static void beginLoop();
+
+  // Call after each stage.  Charges the time since the previous call to it.
+  static void endStage(LoopStage stage);
+
+  // Call when a stage was due but put off to keep the loop within its budget
+  static void deferStage(LoopStage stage);
+
+  // 0 disables the budget.  Indexed by LoopStage.
+  static void setBudgets(const std::vector<uint32_t>& budgets);
+
+  static const LoopStageSummary& getSummary(LoopStage stage);
+  static const __FlashStringHelper* stageName(LoopStage stage);
+  // Returns -1 for an unknown name
+  static int8_t stageFromName(const char* name);
+
+  // Full figures for each stage
+  static void serialize(JsonObject json);
+  // [avg, p99, max] for each stage, small enough for the MQTT birth message
+  static void serializeCompact(JsonObject json);
+
+private:
+  struct StageWindow {
+    uint32_t samples;
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+    uint32_t overruns;
+    uint32_t deferrals;
+    bool warned;
+    uint16_t histogram[LOOP_PROFILER_BUCKETS];
+  };
+
+  static StageWindow windows[NUM_STAGES];
+  static LoopStageSummary summaries[NUM_STAGES];
+  static uint32_t budgets[NUM_STAGES];
+  static uint32_t stageStart;
+  static uint16_t loopsInWindow;
+
+  static uint8_t bucketFor(uint32_t micros);
+  static uint32_t bucketUpperBound(uint8_t bucket);
+  static void rollWindow();
+};
+
+#endif
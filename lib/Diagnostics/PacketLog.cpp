@@ -0,0 +1,337 @@
+#include <PacketLog.h>
+#include <algorithm>
+
+static const uint8_t LOG_MAGIC[] = { 'P', 'L' };
+
+PacketLog::PacketLog(const char* path)
+  : path(path),
+    capacity(0),
+    next(0),
+    count(0),
+    loaded(false),
+    batchSize(0),
+    batchStarted(0),
+    dropped(0),
+    replaySpeed(1),
+    replayPosition(0),
+    replayCount(0),
+    replayOffset(0),
+    replayLastTimestamp(0),
+    replayStarted(0),
+    replaying(false)
+{ }
+
+void PacketLog::setCapacity(uint16_t capacity) {
+  if (capacity == this->capacity) {
+    return;
+  }
+
+  stopReplay();
+  this->capacity = capacity;
+  batchSize = 0;
+  loaded = false;
+
+  if (capacity == 0) {
+    clear();
+  }
+}
+
+void PacketLog::record(PacketDirection direction, const MiLightRadioConfig& radioConfig, const uint8_t* packet, size_t length) {
+  if (capacity == 0 || replaying) {
+    return;
+  }
+
+  if (batchSize == MILIGHT_PACKET_LOG_BATCH_SIZE) {
+    ++dropped;
+    return;
+  }
+
+  PacketLogEntry& entry = batch[batchSize];
+
+  entry.timestamp = millis();
+  entry.radioConfig = &radioConfig - MiLightRadioConfig::ALL_CONFIGS;
+  entry.direction = direction;
+  entry.length = std::min(length, static_cast<size_t>(MILIGHT_MAX_PACKET_LENGTH));
+  memset(entry.packet, 0, sizeof(entry.packet));
+  memcpy(entry.packet, packet, entry.length);
+
+  if (batchSize++ == 0) {
+    batchStarted = millis();
+  }
+}
+
+void PacketLog::loop() {
+  if (batchSize == MILIGHT_PACKET_LOG_BATCH_SIZE
+    || (batchSize > 0 && millis() - batchStarted >= MILIGHT_PACKET_LOG_FLUSH_INTERVAL)) {
+    flush();
+  }
+
+  if (replaying) {
+    replayLoop();
+  }
+}
+
+void PacketLog::flush() {
+  if (batchSize == 0 || capacity == 0) {
+    return;
+  }
+
+  load();
+
+  File f = SPIFFS.open(path, "r+");
+
+  if (!f) {
+    Serial.println(F("ERROR: could not open packet log for writing"));
+    batchSize = 0;
+    return;
+  }
+
+  // Only the newest entries fit if the ring is smaller than a batch
+  const size_t num = std::min(batchSize, static_cast<size_t>(capacity));
+  const PacketLogEntry* entries = batch + (batchSize - num);
+
+  // Split in two if the batch runs past the end of the ring
+  const size_t beforeWrap = std::min(num, static_cast<size_t>(capacity - next));
+  bool ok = writeEntries(f, next, entries, beforeWrap);
+
+  if (ok && beforeWrap < num) {
+    ok = writeEntries(f, 0, entries + beforeWrap, num - beforeWrap);
+  }
+
+  if (ok) {
+    next = (next + num) % capacity;
+    count = std::min(static_cast<size_t>(count + num), static_cast<size_t>(capacity));
+    writeHeader(f);
+  } else {
+    Serial.println(F("ERROR: could not write packet log"));
+  }
+
+  f.close();
+  batchSize = 0;
+}
+
+void PacketLog::clear() {
+  stopReplay();
+
+  if (SPIFFS.exists(path)) {
+    SPIFFS.remove(path);
+  }
+
+  next = 0;
+  count = 0;
+  batchSize = 0;
+  dropped = 0;
+  loaded = false;
+}
+
+bool PacketLog::startReplay(float speed, ReplayHandler handler) {
+  stopReplay();
+
+  if (capacity == 0) {
+    return false;
+  }
+
+  flush();
+  load();
+
+  if (count == 0) {
+    return false;
+  }
+
+  replayFile = SPIFFS.open(path, "r");
+
+  if (!replayFile) {
+    return false;
+  }
+
+  replayHandler = handler;
+  replaySpeed = speed;
+  replayPosition = count < capacity ? 0 : next;
+  replayCount = count;
+  replayOffset = 0;
+  replayStarted = millis();
+  replaying = true;
+
+  PacketLogEntry first;
+  if (readEntry(replayFile, replayPosition, first)) {
+    replayLastTimestamp = first.timestamp;
+  }
+
+  return true;
+}
+
+void PacketLog::stopReplay() {
+  if (replaying) {
+    replayFile.close();
+    replayHandler = nullptr;
+    replaying = false;
+  }
+}
+
+bool PacketLog::isReplaying() const {
+  return replaying;
+}
+
+void PacketLog::replayLoop() {
+  PacketLogEntry entry;
+
+  for (size_t i = 0; i < MILIGHT_PACKET_LOG_REPLAY_BATCH_SIZE && replayCount > 0; i++) {
+    if (!readEntry(replayFile, replayPosition, entry)) {
+      Serial.println(F("WARNING: stopping replay of unreadable packet log"));
+      stopReplay();
+      return;
+    }
+
+    // Timestamps going backwards mean the hub rebooted between entries
+    const uint32_t gap = entry.timestamp >= replayLastTimestamp ? entry.timestamp - replayLastTimestamp : 0;
+
+    if (replaySpeed > 0 && millis() - replayStarted < (replayOffset + gap) / replaySpeed) {
+      return;
+    }
+
+    if (!replayHandler(entry)) {
+      return;
+    }
+
+    replayOffset += gap;
+    replayLastTimestamp = entry.timestamp;
+    replayPosition = (replayPosition + 1) % capacity;
+    --replayCount;
+  }
+
+  if (replayCount == 0) {
+    stopReplay();
+  }
+}
+
+void PacketLog::serialize(JsonObject json) {
+  json[F("capacity")] = capacity;
+  json[F("count")] = count + batchSize;
+  json[F("dropped")] = dropped;
+  json[F("replaying")] = replaying;
+
+  if (replaying) {
+    json[F("replay_remaining")] = replayCount;
+  }
+}
+
+const char* PacketLog::getPath() const {
+  return path;
+}
+
+void PacketLog::load() {
+  if (loaded) {
+    return;
+  }
+
+  loaded = true;
+  next = 0;
+  count = 0;
+
+  if (SPIFFS.exists(path)) {
+    File f = SPIFFS.open(path, "r");
+    uint8_t header[HEADER_SIZE];
+    const size_t fileSize = f.size();
+    const size_t bytesRead = f.read(header, HEADER_SIZE);
+    f.close();
+
+    const uint16_t fileCapacity = header[4] | (header[5] << 8);
+    const uint16_t fileNext = header[6] | (header[7] << 8);
+    const uint16_t fileCount = header[8] | (header[9] << 8);
+
+    if (bytesRead == HEADER_SIZE
+      && header[0] == LOG_MAGIC[0]
+      && header[1] == LOG_MAGIC[1]
+      && header[2] == VERSION
+      && header[3] == ENTRY_SIZE
+      && fileCapacity == capacity
+      && fileCount <= capacity
+      && fileNext < capacity
+      && fileSize == HEADER_SIZE + fileCount * ENTRY_SIZE) {
+      next = fileNext;
+      count = fileCount;
+      return;
+    }
+
+    if (bytesRead != HEADER_SIZE || fileCapacity == capacity) {
+      Serial.println(F("WARNING: ignoring unreadable packet log"));
+    }
+  }
+
+  // Start a new, empty log
+  File f = SPIFFS.open(path, "w");
+
+  if (!f) {
+    Serial.println(F("ERROR: could not create packet log"));
+    return;
+  }
+
+  writeHeader(f);
+  f.close();
+}
+
+void PacketLog::writeHeader(File& f) {
+  const uint8_t header[HEADER_SIZE] = {
+    LOG_MAGIC[0],
+    LOG_MAGIC[1],
+    VERSION,
+    ENTRY_SIZE,
+    static_cast<uint8_t>(capacity & 0xFF),
+    static_cast<uint8_t>(capacity >> 8),
+    static_cast<uint8_t>(next & 0xFF),
+    static_cast<uint8_t>(next >> 8),
+    static_cast<uint8_t>(count & 0xFF),
+    static_cast<uint8_t>(count >> 8),
+    0,
+    0
+  };
+
+  f.seek(0, SeekSet);
+  f.write(header, HEADER_SIZE);
+}
+
+bool PacketLog::writeEntries(File& f, uint16_t slot, const PacketLogEntry* entries, size_t num) {
+  uint8_t buffer[MILIGHT_PACKET_LOG_BATCH_SIZE * ENTRY_SIZE];
+
+  for (size_t i = 0; i < num; i++) {
+    encodeEntry(entries[i], buffer + i * ENTRY_SIZE);
+  }
+
+  return f.seek(HEADER_SIZE + slot * ENTRY_SIZE, SeekSet)
+    && f.write(buffer, num * ENTRY_SIZE) == num * ENTRY_SIZE;
+}
+
+bool PacketLog::readEntry(File& f, uint16_t slot, PacketLogEntry& entry) {
+  uint8_t buffer[ENTRY_SIZE];
+
+  if (!f.seek(HEADER_SIZE + slot * ENTRY_SIZE, SeekSet) || f.read(buffer, ENTRY_SIZE) != ENTRY_SIZE) {
+    return false;
+  }
+
+  decodeEntry(buffer, entry);
+
+  return entry.radioConfig < MiLightRadioConfig::NUM_CONFIGS
+    && entry.length <= MILIGHT_MAX_PACKET_LENGTH;
+}
+
+void PacketLog::encodeEntry(const PacketLogEntry& entry, uint8_t* buffer) {
+  buffer[0] = entry.timestamp & 0xFF;
+  buffer[1] = (entry.timestamp >> 8) & 0xFF;
+  buffer[2] = (entry.timestamp >> 16) & 0xFF;
+  buffer[3] = entry.timestamp >> 24;
+  buffer[4] = entry.radioConfig;
+  buffer[5] = static_cast<uint8_t>(entry.direction);
+  buffer[6] = entry.length;
+  memcpy(buffer + 7, entry.packet, MILIGHT_MAX_PACKET_LENGTH);
+}
+
+void PacketLog::decodeEntry(const uint8_t* buffer, PacketLogEntry& entry) {
+  entry.timestamp = buffer[0]
+    | (buffer[1] << 8)
+    | (static_cast<uint32_t>(buffer[2]) << 16)
+    | (static_cast<uint32_t>(buffer[3]) << 24);
+  entry.radioConfig = buffer[4];
+  entry.direction = static_cast<PacketDirection>(buffer[5]);
+  entry.length = buffer[6];
+  memcpy(entry.packet, buffer + 7, MILIGHT_MAX_PACKET_LENGTH);
+}
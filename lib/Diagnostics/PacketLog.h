@@ -0,0 +1,125 @@
+// Records sent and received packets to a fixed size ring on SPIFFS, and plays
+// them back.  Meant for debugging and for load testing with real traffic.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <FS.h>
+#include <MiLightRadioConfig.h>
+#include <functional>
+
+#ifndef _PACKET_LOG_H
+#define _PACKET_LOG_H
+
+#define PACKET_LOG_FILE "/packets.log"
+
+// Entries held in RAM until they're written out together
+#ifndef MILIGHT_PACKET_LOG_BATCH_SIZE
+#define MILIGHT_PACKET_LOG_BATCH_SIZE 16
+#endif
+
+// Longest a batch waits before being written, in milliseconds
+#ifndef MILIGHT_PACKET_LOG_FLUSH_INTERVAL
+#define MILIGHT_PACKET_LOG_FLUSH_INTERVAL 2000
+#endif
+
+// Most entries replayed per call to loop()
+#ifndef MILIGHT_PACKET_LOG_REPLAY_BATCH_SIZE
+#define MILIGHT_PACKET_LOG_REPLAY_BATCH_SIZE 4
+#endif
+
+enum class PacketDirection : uint8_t {
+  SENT = 0,
+  RECEIVED
+};
+
+struct PacketLogEntry {
+  // millis() when the packet was sent or heard
+  uint32_t timestamp;
+  // Index into MiLightRadioConfig::ALL_CONFIGS
+  uint8_t radioConfig;
+  PacketDirection direction;
+  uint8_t length;
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH];
+};
+
+/*
+ * The file is a 12 byte header followed by a ring of fixed size entries:
+ *
+ *   header: 'P' | 'L' | version (1) | entry size (1) | capacity (2) | next (2) | count (2) | reserved (2)
+ *   entry:  timestamp (4) | radio config (1) | direction (1) | length (1) | packet (9)
+ *
+ * Numbers are little endian.  `next` is the slot the next entry goes in.  Once
+ * the ring has wrapped (count == capacity) it's also the oldest entry.
+ */
+class PacketLog {
+public:
+  static const uint8_t VERSION = 1;
+  static const size_t HEADER_SIZE = 12;
+  static const size_t ENTRY_SIZE = 7 + MILIGHT_MAX_PACKET_LENGTH;
+
+  // Called with each entry during replay.  Return false to be handed the same
+  // entry again on the next loop, e.g. when the send queue is full.
+  typedef std::function<bool(const PacketLogEntry& entry)> ReplayHandler;
+
+  PacketLog(const char* path = PACKET_LOG_FILE);
+
+  // Number of entries in the ring.  0 turns logging off.  Changing it starts
+  // a new log.
+  void setCapacity(uint16_t capacity);
+
+  // Doesn't touch flash.  Entries are dropped if the batch is full, and
+  // aren't recorded during replay.
+  void record(PacketDirection direction, const MiLightRadioConfig& radioConfig, const uint8_t* packet, size_t length);
+
+  // Writes out the batch when it's due, and steps any replay
+  void loop();
+  void flush();
+  void clear();
+
+  // Plays the log back oldest first, spacing entries as they were recorded
+  // divided by speed.  A speed of 0 goes as fast as the handler accepts them.
+  // Returns false if there's nothing to replay.
+  bool startReplay(float speed, ReplayHandler handler);
+  void stopReplay();
+  bool isReplaying() const;
+
+  void serialize(JsonObject json);
+  const char* getPath() const;
+
+private:
+  const char* path;
+  uint16_t capacity;
+  uint16_t next;
+  uint16_t count;
+  bool loaded;
+
+  PacketLogEntry batch[MILIGHT_PACKET_LOG_BATCH_SIZE];
+  size_t batchSize;
+  unsigned long batchStarted;
+  uint32_t dropped;
+
+  File replayFile;
+  ReplayHandler replayHandler;
+  float replaySpeed;
+  uint16_t replayPosition;
+  uint16_t replayCount;
+  // Recorded time since the first entry.  Added up entry to entry, since
+  // millis() starts over when the hub reboots.
+  uint32_t replayOffset;
+  uint32_t replayLastTimestamp;
+  unsigned long replayStarted;
+  bool replaying;
+
+  // Reads the ring's position from the file, starting a new one if it's
+  // missing or doesn't match the capacity
+  void load();
+  void writeHeader(File& f);
+  bool writeEntries(File& f, uint16_t slot, const PacketLogEntry* entries, size_t num);
+  bool readEntry(File& f, uint16_t slot, PacketLogEntry& entry);
+  void replayLoop();
+
+  static void encodeEntry(const PacketLogEntry& entry, uint8_t* buffer);
+  static void decodeEntry(const uint8_t* buffer, PacketLogEntry& entry);
+};
+
+#endif
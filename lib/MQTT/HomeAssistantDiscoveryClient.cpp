@@ -1,61 +1,131 @@
 #include <HomeAssistantDiscoveryClient.h>
 #include <MiLightCommands.h>
+#include <AllocationTracker.h>
 
-HomeAssistantDiscoveryClient::HomeAssistantDiscoveryClient(Settings& settings, MqttClient* mqttClient)
+HomeAssistantDiscoveryClient::HomeAssistantDiscoveryClient(Settings& settings, MqttClient*& mqttClient)
   : settings(settings)
   , mqttClient(mqttClient)
+  , publishing(false)
+  , cycleStats()
 { }
 
-void HomeAssistantDiscoveryClient::sendDiscoverableDevices(const std::map<String, BulbId>& aliases) {
+// 32-bit FNV-1a
+static uint32_t hashString(const char* str, uint32_t hash = 2166136261UL) {
+  while (*str) {
+    hash ^= static_cast<uint8_t>(*str++);
+    hash *= 16777619UL;
+  }
+
+  return hash;
+}
+
+uint32_t HomeAssistantDiscoveryClient::bulbKey(const BulbId& bulbId) {
+  return (static_cast<uint32_t>(bulbId.deviceId) << 16) | (bulbId.groupId << 8) | bulbId.deviceType;
+}
+
+void HomeAssistantDiscoveryClient::start() {
 #ifdef MQTT_DEBUG
   Serial.println(F("HomeAssistantDiscoveryClient: Sending discoverable devices..."));
 #endif
 
-  for (auto itr = aliases.begin(); itr != aliases.end(); ++itr) {
+  publishing = true;
+  nextAlias = "";
+  cycleStats = { };
+}
+
+bool HomeAssistantDiscoveryClient::isPublishing() const {
+  return publishing;
+}
+
+void HomeAssistantDiscoveryClient::forgetPublished() {
+  publishedHashes.clear();
+}
+
+void HomeAssistantDiscoveryClient::loop() {
+  if (! publishing || mqttClient == NULL || ! mqttClient->isConnected()) {
+    return;
+  }
+
+  // Nothing to publish to
+  if (settings.homeAssistantDiscoveryPrefix.length() == 0) {
+    finish();
+    return;
+  }
+
+  size_t budget = MILIGHT_DISCOVERY_CONFIGS_PER_LOOP;
+  const unsigned long loopStart = micros();
+
+  // Removals go first.  Each one is dropped from settings once it's sent.
+  std::map<uint32_t, BulbId>& deleted = settings.deletedGroupIdAliases;
+
+  while (budget > 0 && ! deleted.empty()) {
+    removeConfig(deleted.begin()->second);
+    deleted.erase(deleted.begin());
+    --budget;
+  }
+
+  const std::map<String, BulbId>& aliases = settings.groupIdAliases;
+  auto itr = aliases.lower_bound(nextAlias);
+
+  // Unchanged configs still have to be built to be hashed, so they count too
+  while (budget > 0 && itr != aliases.end()) {
     addConfig(itr->first.c_str(), itr->second);
+    ++itr;
+    --budget;
   }
-}
 
-void HomeAssistantDiscoveryClient::removeOldDevices(const std::map<uint32_t, BulbId>& aliases) {
-#ifdef MQTT_DEBUG
-  Serial.println(F("HomeAssistantDiscoveryClient: Removing discoverable devices..."));
-#endif
+  cycleStats.micros += micros() - loopStart;
 
-  for (auto itr = aliases.begin(); itr != aliases.end(); ++itr) {
-    removeConfig(itr->second);
+  if (itr == aliases.end() && deleted.empty()) {
+    Serial.printf_P(
+      PSTR("Home Assistant discovery: %u published, %u unchanged, %u bytes allocated, %lums\n"),
+      cycleStats.published,
+      cycleStats.unchanged,
+      cycleStats.bytesAllocated,
+      static_cast<unsigned long>(cycleStats.micros / 1000)
+    );
+
+    finish();
+  } else if (itr != aliases.end()) {
+    nextAlias = itr->first;
   }
 }
 
+void HomeAssistantDiscoveryClient::finish() {
+  publishing = false;
+  nextAlias = "";
+  configDocument.reset();
+  messageBuffer.reset();
+}
+
 void HomeAssistantDiscoveryClient::removeConfig(const BulbId& bulbId) {
   // Remove by publishing an empty message
   String topic = buildTopic(bulbId);
   mqttClient->send(topic.c_str(), "", true);
+
+  publishedHashes.erase(bulbKey(bulbId));
 }
 
-void HomeAssistantDiscoveryClient::addConfig(const char* alias, const BulbId& bulbId) {
-  String topic = buildTopic(bulbId);
-  DynamicJsonDocument config(1024);
+// Everything in a config that only depends on the remote type.  Serialized
+// without the surrounding braces so it can be spliced into each alias' config.
+const String& HomeAssistantDiscoveryClient::capabilityTemplate(MiLightRemoteType type) {
+  static const String NO_CAPABILITIES;
 
-  config[F("schema")] = F("json");
-  config[F("name")] = alias;
-  config[F("command_topic")] = mqttClient->bindTopicString(settings.mqttTopicPattern, bulbId);
-  config[F("state_topic")] = mqttClient->bindTopicString(settings.mqttStateTopicPattern, bulbId);
-  JsonObject deviceMetadata = config.createNestedObject(F("device"));
-
-  deviceMetadata[F("manufacturer")] = F("esp8266_milight_hub");
-  deviceMetadata[F("sw_version")] = QUOTE(MILIGHT_HUB_VERSION);
+  if (type >= MILIGHT_DISCOVERY_NUM_REMOTE_TYPES) {
+    return NO_CAPABILITIES;
+  }
 
-  JsonArray identifiers = deviceMetadata.createNestedArray(F("identifiers"));
-  identifiers.add(ESP.getChipId());
-  bulbId.serialize(identifiers);
+  String& cached = capabilityTemplates[type];
 
-  // HomeAssistant only supports simple client availability
-  if (settings.mqttClientStatusTopic.length() > 0 && settings.simpleMqttClientStatus) {
-    config[F("availability_topic")] = settings.mqttClientStatusTopic;
-    config[F("payload_available")] = F("connected");
-    config[F("payload_not_available")] = F("disconnected");
+  if (cached.length() > 0) {
+    return cached;
   }
 
+  DynamicJsonDocument config(MILIGHT_DISCOVERY_DOCUMENT_SIZE);
+  TRACK_ALLOCATION(MQTT_DISCOVERY_DOCUMENT, MILIGHT_DISCOVERY_DOCUMENT_SIZE);
+
+  config[F("schema")] = F("json");
+
   // Configure supported commands based on the bulb type
 
   // All supported bulbs support brightness and night mode
@@ -66,7 +136,7 @@ void HomeAssistantDiscoveryClient::addConfig(const char* alias, const BulbId& bu
   effects.add(MiLightCommandNames::NIGHT_MODE);
 
   // These bulbs support switching between rgb/white, and have a "white_mode" command
-  switch (bulbId.deviceType) {
+  switch (type) {
     case REMOTE_TYPE_FUT089:
     case REMOTE_TYPE_RGB_CCT:
     case REMOTE_TYPE_RGBW:
@@ -78,7 +148,7 @@ void HomeAssistantDiscoveryClient::addConfig(const char* alias, const BulbId& bu
 
   // All bulbs except CCT have 9 modes.  FUT029 and RGB/FUT096 has 9 modes, but they
   // are not selectable directly.  There are only "next mode" commands.
-  switch (bulbId.deviceType) {
+  switch (type) {
     case REMOTE_TYPE_CCT:
     case REMOTE_TYPE_RGB:
     case REMOTE_TYPE_FUT020:
@@ -89,7 +159,7 @@ void HomeAssistantDiscoveryClient::addConfig(const char* alias, const BulbId& bu
   }
 
   // These bulbs support RGB color
-  switch (bulbId.deviceType) {
+  switch (type) {
     case REMOTE_TYPE_FUT089:
     case REMOTE_TYPE_RGB:
     case REMOTE_TYPE_RGB_CCT:
@@ -101,7 +171,7 @@ void HomeAssistantDiscoveryClient::addConfig(const char* alias, const BulbId& bu
   }
 
   // These bulbs support adjustable white values
-  switch (bulbId.deviceType) {
+  switch (type) {
     case REMOTE_TYPE_CCT:
     case REMOTE_TYPE_FUT089:
     case REMOTE_TYPE_FUT091:
@@ -112,16 +182,86 @@ void HomeAssistantDiscoveryClient::addConfig(const char* alias, const BulbId& bu
       break; //nothing
   }
 
-  String message;
-  serializeJson(config, message);
+  String serialized;
+  serializeJson(config, serialized);
+  cached = serialized.substring(1, serialized.length() - 1);
+
+  cycleStats.bytesAllocated += MILIGHT_DISCOVERY_DOCUMENT_SIZE + cached.length();
+
+  return cached;
+}
+
+bool HomeAssistantDiscoveryClient::addConfig(const char* alias, const BulbId& bulbId) {
+  if (! configDocument) {
+    configDocument.reset(new DynamicJsonDocument(MILIGHT_DISCOVERY_ALIAS_DOCUMENT_SIZE));
+    messageBuffer.reset(new char[MILIGHT_DISCOVERY_DOCUMENT_SIZE]);
+    TRACK_ALLOCATION(MQTT_DISCOVERY_DOCUMENT, MILIGHT_DISCOVERY_ALIAS_DOCUMENT_SIZE + MILIGHT_DISCOVERY_DOCUMENT_SIZE);
+
+    cycleStats.bytesAllocated += MILIGHT_DISCOVERY_ALIAS_DOCUMENT_SIZE + MILIGHT_DISCOVERY_DOCUMENT_SIZE;
+  }
+
+  String topic = buildTopic(bulbId);
+  DynamicJsonDocument& config = *configDocument;
+  char* message = messageBuffer.get();
+  config.clear();
+
+  // Only the parts that differ between aliases are built here
+  config[F("name")] = alias;
+  config[F("command_topic")] = mqttClient->bindTopicString(settings.mqttTopicPattern, bulbId);
+  config[F("state_topic")] = mqttClient->bindTopicString(settings.mqttStateTopicPattern, bulbId);
+  JsonObject deviceMetadata = config.createNestedObject(F("device"));
+
+  deviceMetadata[F("manufacturer")] = F("esp8266_milight_hub");
+  deviceMetadata[F("sw_version")] = QUOTE(MILIGHT_HUB_VERSION);
+
+  JsonArray identifiers = deviceMetadata.createNestedArray(F("identifiers"));
+  identifiers.add(ESP.getChipId());
+  bulbId.serialize(identifiers);
+
+  // HomeAssistant only supports simple client availability
+  if (settings.mqttClientStatusTopic.length() > 0 && settings.simpleMqttClientStatus) {
+    config[F("availability_topic")] = settings.mqttClientStatusTopic;
+    config[F("payload_available")] = F("connected");
+    config[F("payload_not_available")] = F("disconnected");
+  }
+
+  const String& capabilities = capabilityTemplate(bulbId.deviceType);
+  size_t length = serializeJson(config, message, MILIGHT_DISCOVERY_DOCUMENT_SIZE);
+
+  // Swap the closing brace for the capabilities
+  if (capabilities.length() > 0) {
+    if (length + capabilities.length() + 2 > MILIGHT_DISCOVERY_DOCUMENT_SIZE) {
+      Serial.println(F("ERROR: Home Assistant discovery config is too large"));
+      return false;
+    }
+
+    message[length - 1] = ',';
+    memcpy(message + length, capabilities.c_str(), capabilities.length());
+    length += capabilities.length();
+    message[length++] = '}';
+    message[length] = 0;
+  }
+
+  // The topic covers the discovery prefix, which isn't in the message
+  const uint32_t hash = hashString(message, hashString(topic.c_str()));
+  const uint32_t key = bulbKey(bulbId);
+  auto published = publishedHashes.find(key);
+
+  if (published != publishedHashes.end() && published->second == hash) {
+    ++cycleStats.unchanged;
+    return false;
+  }
 
 #ifdef MQTT_DEBUG
   Serial.printf_P(PSTR("HomeAssistantDiscoveryClient: adding discoverable device: %s...\n"), alias);
-  Serial.printf_P(PSTR("  topic: %s\nconfig: %s\n"), topic.c_str(), message.c_str());
+  Serial.printf_P(PSTR("  topic: %s\nconfig: %s\n"), topic.c_str(), message);
 #endif
 
+  mqttClient->send(topic.c_str(), message, true);
+  publishedHashes[key] = hash;
+  ++cycleStats.published;
 
-  mqttClient->send(topic.c_str(), message.c_str(), true);
+  return true;
 }
 
 // Topic syntax:
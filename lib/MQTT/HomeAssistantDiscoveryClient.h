@@ -3,22 +3,94 @@
 #include <BulbId.h>
 #include <MqttClient.h>
 #include <map>
+#include <memory>
 
+// Number of discovery configs published (or removed) per main loop iteration
+#ifndef MILIGHT_DISCOVERY_CONFIGS_PER_LOOP
+#define MILIGHT_DISCOVERY_CONFIGS_PER_LOOP 2
+#endif
+
+// Size of a whole config once it's serialized
+#ifndef MILIGHT_DISCOVERY_DOCUMENT_SIZE
+#define MILIGHT_DISCOVERY_DOCUMENT_SIZE 1024
+#endif
+
+// Size of the per-alias part of a config (name, topics, device metadata)
+#ifndef MILIGHT_DISCOVERY_ALIAS_DOCUMENT_SIZE
+#define MILIGHT_DISCOVERY_ALIAS_DOCUMENT_SIZE 512
+#endif
+
+// Remote types are numbered from 0, see MiLightRemoteType
+#define MILIGHT_DISCOVERY_NUM_REMOTE_TYPES (REMOTE_TYPE_FUT020 + 1)
+
+// Work done by one discovery job, printed when it finishes
+struct DiscoveryCycleStats {
+  uint32_t micros;
+  uint16_t published;
+  uint16_t unchanged;
+  uint32_t bytesAllocated;
+};
+
+/*
+ * Publishes Home Assistant discovery configs for every group alias.  Runs in
+ * the background a few configs at a time so that a reconnect doesn't stall
+ * the main loop.
+ *
+ * Remembers a hash of each config it published, and skips aliases whose
+ * config hasn't changed.  Configs are retained, so the hashes hold across
+ * reconnects to the same broker.  Call forgetPublished() when the broker or
+ * the discovery prefix changes.
+ */
 class HomeAssistantDiscoveryClient {
 public:
-  HomeAssistantDiscoveryClient(Settings& settings, MqttClient* mqttClient);
+  HomeAssistantDiscoveryClient(Settings& settings, MqttClient*& mqttClient);
 
-  void addConfig(const char* alias, const BulbId& bulbId);
-  void removeConfig(const BulbId& bulbId);
+  // Queues up every alias (and every deleted alias) in settings.  Restarts the
+  // job if one is already running.
+  void start();
+
+  // Publishes up to MILIGHT_DISCOVERY_CONFIGS_PER_LOOP pending configs.  Does
+  // nothing while MQTT is disconnected, and picks up where it left off when
+  // it reconnects.
+  void loop();
 
-  void sendDiscoverableDevices(const std::map<String, BulbId>& aliases);
-  void removeOldDevices(const std::map<uint32_t, BulbId>& aliases);
+  bool isPublishing() const;
+
+  // Makes the next job publish every config in full
+  void forgetPublished();
+
+  // Returns false if the config was skipped because it's already published
+  bool addConfig(const char* alias, const BulbId& bulbId);
+  void removeConfig(const BulbId& bulbId);
 
 private:
   Settings& settings;
-  MqttClient* mqttClient;
+  MqttClient*& mqttClient;
+
+  bool publishing;
+  // Alias the job resumes from.  Looked up by key so edits to the alias map
+  // while the job is running don't invalidate it.
+  String nextAlias;
+
+  // Shared by every config in a job, and freed when it's done
+  std::unique_ptr<DynamicJsonDocument> configDocument;
+  std::unique_ptr<char[]> messageBuffer;
+
+  // Config hash last published for each bulb
+  std::map<uint32_t, uint32_t> publishedHashes;
+
+  // Capabilities for each remote type, built the first time they're needed
+  String capabilityTemplates[MILIGHT_DISCOVERY_NUM_REMOTE_TYPES];
+
+  DiscoveryCycleStats cycleStats;
+
+  void finish();
+  const String& capabilityTemplate(MiLightRemoteType type);
 
   String buildTopic(const BulbId& bulbId);
   String bindTopicVariables(const String& topic, const char* alias, const BulbId& bulbId);
   void addNumberedEffects(JsonArray& effectList, uint8_t start, uint8_t end);
-};
\ No newline at end of file
+
+  // Unlike BulbId::getCompactId, keeps the whole device ID
+  static uint32_t bulbKey(const BulbId& bulbId);
+};
@@ -7,6 +7,8 @@
 #include <WiFiClient.h>
 #include <MiLightRadioConfig.h>
 #include <AboutHelper.h>
+#include <AllocationTracker.h>
+#include <LoopProfiler.h>
 
 static const char* STATUS_CONNECTED = "connected";
 static const char* STATUS_DISCONNECTED = "disconnected_clean";
@@ -94,7 +96,8 @@ bool MqttClient::connect() {
 void MqttClient::sendBirthMessage() {
   if (settings.mqttClientStatusTopic.length() > 0) {
     String aboutStr = generateConnectionStatusMessage(STATUS_CONNECTED);
-    mqttClient.publish(settings.mqttClientStatusTopic.c_str(), aboutStr.c_str(), true);
+    // Loop timings make this too big for a single packet
+    send(settings.mqttClientStatusTopic.c_str(), aboutStr.c_str(), true);
   }
 }
 
@@ -131,6 +134,10 @@ void MqttClient::handleClient() {
   }
 }
 
+bool MqttClient::isConnected() {
+  return mqttClient.connected();
+}
+
 void MqttClient::sendUpdate(const MiLightRemoteConfig& remoteConfig, uint16_t deviceId, uint16_t groupId, const char* update) {
   publish(settings.mqttUpdateTopicPattern, remoteConfig, deviceId, groupId, update);
 }
@@ -205,6 +212,8 @@ void MqttClient::publish(
 }
 
 void MqttClient::publishCallback(char* topic, byte* payload, int length) {
+  milightClient->stampCommand(CommandSource::MQTT);
+
   uint16_t deviceId = 0;
   uint8_t groupId = 0;
   const MiLightRemoteConfig* config = &FUT092Config;
@@ -291,6 +300,8 @@ String MqttClient::bindTopicString(const String& topicPattern, const BulbId& bul
     boundTopic.replace(":device_alias", "__unnamed_group");
   }
 
+  TRACK_ALLOCATION(MQTT_TOPIC_STRING, boundTopic.length() + 1);
+
   return boundTopic;
 }
 
@@ -303,12 +314,18 @@ String MqttClient::generateConnectionStatusMessage(const char* connectionStatus)
       return "disconnected";
     }
   } else {
-    StaticJsonDocument<1024> json;
+    DynamicJsonDocument json(MQTT_STATUS_DOCUMENT_SIZE);
     json[GroupStateFieldNames::STATUS] = connectionStatus;
 
     // Fill other fields
     AboutHelper::generateAboutObject(json, true);
 
+    // Timings are stale by the time a last will is delivered, so only the
+    // birth message carries them
+    if (0 == strcmp(connectionStatus, STATUS_CONNECTED)) {
+      LoopProfiler::serializeCompact(json.createNestedObject("loop_stats"));
+    }
+
     String response;
     serializeJson(json, response);
 
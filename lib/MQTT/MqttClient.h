@@ -12,6 +12,11 @@
 #define MQTT_PACKET_CHUNK_SIZE 128
 #endif
 
+// Room for the about fields plus loop stage timings in the birth message
+#ifndef MQTT_STATUS_DOCUMENT_SIZE
+#define MQTT_STATUS_DOCUMENT_SIZE 1536
+#endif
+
 #ifndef _MQTT_CLIENT_H
 #define _MQTT_CLIENT_H
 
@@ -29,6 +34,7 @@ public:
   void sendState(const MiLightRemoteConfig& remoteConfig, uint16_t deviceId, uint16_t groupId, const char* update);
   void send(const char* topic, const char* message, const bool retain = false);
   void onConnect(OnConnectFn fn);
+  bool isConnected();
 
   String bindTopicString(const String& topicPattern, const BulbId& bulbId);
 
@@ -0,0 +1,118 @@
+#include <AdaptiveRepeats.h>
+#include <algorithm>
+#include <cmath>
+
+// Loss estimates are permille scaled by 2^LOSS_SCALE_BITS so the moving
+// average doesn't round small losses away
+#define LOSS_SCALE_BITS 4
+// Each window moves the average 1/2^LOSS_SMOOTHING_BITS of the way
+#define LOSS_SMOOTHING_BITS 3
+
+AdaptiveRepeats::AdaptiveRepeats(Settings& settings)
+  : settings(settings)
+  , links()
+{ }
+
+int8_t AdaptiveRepeats::linkIndex(const MiLightRadioConfig& config) {
+  for (size_t i = 0; i < MiLightRadioConfig::NUM_CONFIGS; i++) {
+    if (&MiLightRadioConfig::ALL_CONFIGS[i] == &config) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+uint16_t AdaptiveRepeats::frameLoss(uint16_t missed, uint16_t packets, uint32_t frames) {
+  if (missed == 0) {
+    return 0;
+  }
+
+  const double missRate = static_cast<double>(missed) / packets;
+  return 1000 * std::pow(missRate, static_cast<double>(packets) / frames) + 0.5;
+}
+
+void AdaptiveRepeats::observe(const MiLightRadioConfig& config, bool heard, size_t framesListened) {
+  const int8_t ix = linkIndex(config);
+
+  if (ix == -1 || framesListened == 0) {
+    return;
+  }
+
+  LinkEstimate* link = &links[ix];
+
+  ++link->packets;
+  link->frames += framesListened;
+
+  if (!heard) {
+    ++link->missed;
+  }
+
+  if (link->packets < ADAPTIVE_REPEATS_WINDOW_PACKETS) {
+    return;
+  }
+
+  const uint16_t loss = frameLoss(link->missed, link->packets, link->frames);
+  const int32_t scaledLoss = static_cast<int32_t>(loss) << LOSS_SCALE_BITS;
+
+  if (link->windows == 0) {
+    link->scaledLoss = scaledLoss;
+  } else {
+    link->scaledLoss += (scaledLoss - static_cast<int32_t>(link->scaledLoss)) >> LOSS_SMOOTHING_BITS;
+  }
+
+  if (link->windows < UINT8_MAX) {
+    ++link->windows;
+  }
+
+  link->packets = 0;
+  link->missed = 0;
+  link->frames = 0;
+}
+
+size_t AdaptiveRepeats::repeatsFor(const MiLightRemoteConfig& remoteConfig) const {
+  const int8_t ix = linkIndex(remoteConfig.radioConfig);
+
+  if (ix == -1 || links[ix].windows < ADAPTIVE_REPEATS_WARMUP_WINDOWS) {
+    return settings.packetRepeats;
+  }
+
+  return repeatsForLoss(
+    links[ix].scaledLoss >> LOSS_SCALE_BITS,
+    settings.packetRepeatMinimum,
+    settings.packetRepeats
+  );
+}
+
+size_t AdaptiveRepeats::repeatsForLoss(uint16_t lossPermille, size_t minimum, size_t maximum) {
+  // Chance (in ppm) that all of the first n repeats are lost
+  uint32_t missPpm = 1000000;
+  size_t n = 0;
+
+  while (n < maximum && missPpm > ADAPTIVE_REPEATS_TARGET_MISS_PPM) {
+    missPpm = (missPpm * lossPermille) / 1000;
+    ++n;
+  }
+
+  return std::max(n, std::min(minimum, maximum));
+}
+
+void AdaptiveRepeats::serialize(JsonObject json) const {
+  json[F("enabled")] = settings.adaptivePacketRepeats;
+
+  JsonObject remotes = json.createNestedObject(F("remotes"));
+
+  for (size_t i = 0; i < MiLightRemoteConfig::NUM_REMOTES; i++) {
+    const MiLightRemoteConfig* remote = MiLightRemoteConfig::ALL_REMOTES[i];
+    const int8_t ix = linkIndex(remote->radioConfig);
+
+    if (ix == -1) {
+      continue;
+    }
+
+    JsonObject remoteJson = remotes.createNestedObject(remote->name);
+    remoteJson[F("repeats")] = repeatsFor(*remote);
+    remoteJson[F("loss_permille")] = links[ix].scaledLoss >> LOSS_SCALE_BITS;
+    remoteJson[F("windows")] = links[ix].windows;
+  }
+}
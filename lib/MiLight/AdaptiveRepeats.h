@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <MiLightRadioConfig.h>
+#include <MiLightRemoteConfig.h>
+#include <Settings.h>
+
+// Packets sent while the listen radio was tuned in that are folded into its
+// loss estimate at a time
+#ifndef ADAPTIVE_REPEATS_WINDOW_PACKETS
+#define ADAPTIVE_REPEATS_WINDOW_PACKETS 16
+#endif
+
+// Windows needed before a learned count is used instead of packetRepeats
+#ifndef ADAPTIVE_REPEATS_WARMUP_WINDOWS
+#define ADAPTIVE_REPEATS_WARMUP_WINDOWS 4
+#endif
+
+// Acceptable chance, in parts per million, that every repeat of a packet is lost
+#ifndef ADAPTIVE_REPEATS_TARGET_MISS_PPM
+#define ADAPTIVE_REPEATS_TARGET_MISS_PPM 100
+#endif
+
+/*
+ * Learns how many repeats each remote type needs.
+ *
+ * Bulbs never acknowledge anything, so the link is judged by whether the hub
+ * hears itself.  With a second radio module listening while the first sends,
+ * every packet sent while the listener was tuned to its radio config is a
+ * trial: some repeat of it was heard back, or none was.  If a share m of those
+ * packets went unheard after n repeats each, a frame is assumed lost with
+ * probability
+ *
+ *    p = m^(1/n)
+ *
+ * and the learned count is the fewest repeats r with p^r under the target miss
+ * rate, clamped to [packetRepeatMinimum, packetRepeats].
+ *
+ * Without a listening module there are no trials and packetRepeats is always
+ * used.  Remote types sharing a radio config (syncword and channels) share a
+ * link, so estimates are kept per radio config.
+ */
+class AdaptiveRepeats {
+public:
+  AdaptiveRepeats(Settings& settings);
+
+  // Fold in one of our packets.  framesListened is the number of its repeats
+  // sent while the listen radio was tuned to its config.
+  void observe(const MiLightRadioConfig& config, bool heard, size_t framesListened);
+
+  // Learned number of repeats, or packetRepeats until there's enough data
+  size_t repeatsFor(const MiLightRemoteConfig& remoteConfig) const;
+
+  // Fewest repeats for which a per-frame loss (in permille) misses less often
+  // than the target
+  static size_t repeatsForLoss(uint16_t lossPermille, size_t minimum, size_t maximum);
+
+  void serialize(JsonObject json) const;
+
+private:
+  struct LinkEstimate {
+    // Trials in the window being collected
+    uint16_t packets;
+    uint16_t missed;
+    uint32_t frames;
+    // Moving average of loss, permille scaled up by 16
+    uint16_t scaledLoss;
+    uint8_t windows;
+  };
+
+  Settings& settings;
+  LinkEstimate links[MiLightRadioConfig::NUM_CONFIGS];
+
+  static int8_t linkIndex(const MiLightRadioConfig& config);
+  // Per-frame loss (permille) that makes this share of packets go unheard
+  static uint16_t frameLoss(uint16_t missed, uint16_t packets, uint32_t frames);
+};
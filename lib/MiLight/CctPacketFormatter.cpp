@@ -49,28 +49,22 @@ void CctPacketFormatter::finalizePacket(uint8_t* packet) {
 }
 
 void CctPacketFormatter::updateBrightness(uint8_t value) {
-  const GroupState* state = this->stateStore->get(deviceId, groupId, MiLightRemoteType::REMOTE_TYPE_CCT);
-  int8_t knownValue = (state != NULL && state->isSetBrightness()) ? state->getBrightness() : -1;
-
   valueByStepFunction(
     &PacketFormatter::increaseBrightness,
     &PacketFormatter::decreaseBrightness,
     CCT_INTERVALS,
     value / CCT_INTERVALS,
-    knownValue / CCT_INTERVALS
+    findStepRange(GroupStateField::BRIGHTNESS, CCT_INTERVALS, CCT_INTERVALS)
   );
 }
 
 void CctPacketFormatter::updateTemperature(uint8_t value) {
-  const GroupState* state = this->stateStore->get(deviceId, groupId, MiLightRemoteType::REMOTE_TYPE_CCT);
-  int8_t knownValue = (state != NULL && state->isSetKelvin()) ? state->getKelvin() : -1;
-
   valueByStepFunction(
     &PacketFormatter::increaseTemperature,
     &PacketFormatter::decreaseTemperature,
     CCT_INTERVALS,
     value / CCT_INTERVALS,
-    knownValue / CCT_INTERVALS
+    findStepRange(GroupStateField::KELVIN, CCT_INTERVALS, CCT_INTERVALS)
   );
 }
 
@@ -190,7 +184,7 @@ MiLightStatus CctPacketFormatter::cctCommandToStatus(uint8_t command) {
   }
 }
 
-BulbId CctPacketFormatter::parsePacket(const uint8_t* packet, JsonObject result) {
+BulbId CctPacketFormatter::parsePacket(const uint8_t* packet, ParsedPacket& result) {
   uint8_t command = packet[CCT_COMMAND_INDEX] & 0x7F;
 
   uint8_t onOffGroupId = cctCommandIdToGroup(command);
@@ -202,19 +196,19 @@ BulbId CctPacketFormatter::parsePacket(const uint8_t* packet, JsonObject result)
 
   // Night mode
   if (command & 0x10) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::NIGHT_MODE;
+    result.setCommand(MiLightCommandNames::NIGHT_MODE);
   } else if (onOffGroupId < 255) {
-    result[GroupStateFieldNames::STATE] = cctCommandToStatus(command) == ON ? "ON" : "OFF";
+    result.setState(cctCommandToStatus(command));
   } else if (command == CCT_BRIGHTNESS_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = "brightness_down";
+    result.setCommand(MiLightCommandNames::BRIGHTNESS_DOWN);
   } else if (command == CCT_BRIGHTNESS_UP) {
-    result[GroupStateFieldNames::COMMAND] = "brightness_up";
+    result.setCommand(MiLightCommandNames::BRIGHTNESS_UP);
   } else if (command == CCT_TEMPERATURE_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::TEMPERATURE_DOWN;
+    result.setCommand(MiLightCommandNames::TEMPERATURE_DOWN);
   } else if (command == CCT_TEMPERATURE_UP) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::TEMPERATURE_UP;
+    result.setCommand(MiLightCommandNames::TEMPERATURE_UP);
   } else {
-    result["button_id"] = command;
+    result.setButtonId(command);
   }
 
   return bulbId;
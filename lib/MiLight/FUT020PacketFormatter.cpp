@@ -1,5 +1,6 @@
 #include <FUT020PacketFormatter.h>
 #include <Units.h>
+#include <MiLightCommands.h>
 
 void FUT020PacketFormatter::updateColorRaw(uint8_t color) {
   command(static_cast<uint8_t>(FUT020Command::COLOR), color);
@@ -21,15 +22,16 @@ void FUT020PacketFormatter::nextMode() {
 }
 
 void FUT020PacketFormatter::updateBrightness(uint8_t value) {
-  const GroupState* state = this->stateStore->get(deviceId, groupId, MiLightRemoteType::REMOTE_TYPE_FUT020);
-  int8_t knownValue = (state != NULL && state->isSetBrightness()) ? state->getBrightness() : -1;
-
   valueByStepFunction(
     &PacketFormatter::increaseBrightness,
     &PacketFormatter::decreaseBrightness,
     FUT02xPacketFormatter::NUM_BRIGHTNESS_INTERVALS,
     value / FUT02xPacketFormatter::NUM_BRIGHTNESS_INTERVALS,
-    knownValue / FUT02xPacketFormatter::NUM_BRIGHTNESS_INTERVALS
+    findStepRange(
+      GroupStateField::BRIGHTNESS,
+      FUT02xPacketFormatter::NUM_BRIGHTNESS_INTERVALS,
+      FUT02xPacketFormatter::NUM_BRIGHTNESS_INTERVALS
+    )
   );
 }
 
@@ -45,7 +47,7 @@ void FUT020PacketFormatter::updateStatus(MiLightStatus status, uint8_t groupId)
   command(static_cast<uint8_t>(FUT020Command::ON_OFF), 0);
 }
 
-BulbId FUT020PacketFormatter::parsePacket(const uint8_t* packet, JsonObject result) {
+BulbId FUT020PacketFormatter::parsePacket(const uint8_t* packet, ParsedPacket& result) {
   FUT020Command command = static_cast<FUT020Command>(packet[FUT02xPacketFormatter::FUT02X_COMMAND_INDEX] & 0x0F);
 
   BulbId bulbId(
@@ -56,29 +58,29 @@ BulbId FUT020PacketFormatter::parsePacket(const uint8_t* packet, JsonObject resu
 
   switch (command) {
     case FUT020Command::ON_OFF:
-      result[F("state")] = F("ON");
+      result.setState(ON);
       break;
 
     case FUT020Command::BRIGHTNESS_DOWN:
-      result[F("command")] = F("brightness_down");
+      result.setCommand(MiLightCommandNames::BRIGHTNESS_DOWN);
       break;
 
     case FUT020Command::BRIGHTNESS_UP:
-      result[F("command")] = F("brightness_up");
+      result.setCommand(MiLightCommandNames::BRIGHTNESS_UP);
       break;
 
     case FUT020Command::MODE_SWITCH:
-      result[F("command")] = F("next_mode");
+      result.setCommand(MiLightCommandNames::NEXT_MODE);
       break;
 
     case FUT020Command::COLOR_WHITE_TOGGLE:
-      result[F("command")] = F("color_white_toggle");
+      result.setCommand(MiLightCommandNames::COLOR_WHITE_TOGGLE);
       break;
 
     case FUT020Command::COLOR:
       uint16_t remappedColor = Units::rescale<uint16_t, uint16_t>(packet[FUT02xPacketFormatter::FUT02X_ARGUMENT_INDEX], 360.0, 255.0);
       remappedColor = (remappedColor + 113) % 360;
-      result[GroupStateFieldNames::HUE] = remappedColor;
+      result.setHue(remappedColor);
       break;
   }
 
@@ -92,7 +92,7 @@ void FUT089PacketFormatter::enableNightMode() {
   command(FUT089_ON | 0x80, arg);
 }
 
-BulbId FUT089PacketFormatter::parsePacket(const uint8_t *packet, JsonObject result) {
+BulbId FUT089PacketFormatter::parsePacket(const uint8_t *packet, ParsedPacket& result) {
   if (stateStore == NULL) {
     Serial.println(F("ERROR: stateStore not set.  Prepare was not called!  **THIS IS A BUG**"));
     BulbId fakeId(0, 0, REMOTE_TYPE_FUT089);
@@ -114,42 +114,42 @@ BulbId FUT089PacketFormatter::parsePacket(const uint8_t *packet, JsonObject resu
 
   if (command == FUT089_ON) {
     if ((packetCopy[V2_COMMAND_INDEX] & 0x80) == 0x80) {
-      result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::NIGHT_MODE;
+      result.setCommand(MiLightCommandNames::NIGHT_MODE);
     } else if (arg == FUT089_MODE_SPEED_DOWN) {
-      result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_DOWN;
+      result.setCommand(MiLightCommandNames::MODE_SPEED_DOWN);
     } else if (arg == FUT089_MODE_SPEED_UP) {
-      result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_UP;
+      result.setCommand(MiLightCommandNames::MODE_SPEED_UP);
     } else if (arg == FUT089_WHITE_MODE) {
-      result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::SET_WHITE;
+      result.setCommand(MiLightCommandNames::SET_WHITE);
     } else if (arg <= 8) { // Group is not reliably encoded in group byte. Extract from arg byte
-      result[GroupStateFieldNames::STATE] = "ON";
+      result.setState(ON);
       bulbId.groupId = arg;
     } else if (arg >= 9 && arg <= 17) {
-      result[GroupStateFieldNames::STATE] = "OFF";
+      result.setState(OFF);
       bulbId.groupId = arg-9;
     }
   } else if (command == FUT089_COLOR) {
     uint8_t rescaledColor = (arg - FUT089_COLOR_OFFSET) % 0x100;
     uint16_t hue = Units::rescale<uint16_t, uint16_t>(rescaledColor, 360, 255.0);
-    result[GroupStateFieldNames::HUE] = hue;
+    result.setHue(hue);
   } else if (command == FUT089_BRIGHTNESS) {
     uint8_t level = constrain(arg, 0, 100);
-    result[GroupStateFieldNames::BRIGHTNESS] = Units::rescale<uint8_t, uint8_t>(level, 255, 100);
+    result.setBrightness(Units::rescale<uint8_t, uint8_t>(level, 255, 100));
   // saturation == kelvin. arg ranges are the same, so can't distinguish
   // without using state
   } else if (command == FUT089_SATURATION) {
     const GroupState* state = stateStore->get(bulbId);
 
     if (state != NULL && state->getBulbMode() == BULB_MODE_COLOR) {
-      result[GroupStateFieldNames::SATURATION] = 100 - constrain(arg, 0, 100);
+      result.setSaturation(100 - constrain(arg, 0, 100));
     } else {
-      result[GroupStateFieldNames::COLOR_TEMP] = Units::whiteValToMireds(100 - arg, 100);
+      result.setColorTemp(Units::whiteValToMireds(100 - arg, 100));
     }
   } else if (command == FUT089_MODE) {
-    result[GroupStateFieldNames::MODE] = arg;
+    result.setMode(arg);
   } else {
-    result["button_id"] = command;
-    result["argument"] = arg;
+    result.setButtonId(command);
+    result.setArgument(arg);
   }
 
   return bulbId;
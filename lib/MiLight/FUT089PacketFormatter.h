@@ -39,7 +39,8 @@ public:
   virtual void modeSpeedUp();
   virtual void updateMode(uint8_t mode);
 
-  virtual BulbId parsePacket(const uint8_t* packet, JsonObject result);
+  using PacketFormatter::parsePacket;
+  virtual BulbId parsePacket(const uint8_t* packet, ParsedPacket& result);
 };
 
 #endif
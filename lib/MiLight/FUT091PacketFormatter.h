@@ -19,7 +19,8 @@ public:
   virtual void updateTemperature(uint8_t value);
   virtual void enableNightMode();
 
-  virtual BulbId parsePacket(const uint8_t* packet, JsonObject result);
+  using PacketFormatter::parsePacket;
+  virtual BulbId parsePacket(const uint8_t* packet, ParsedPacket& result);
 };
 
 #endif
@@ -1,67 +1,99 @@
 #include <MiLightClient.h>
 #include <MiLightRadioConfig.h>
 #include <Arduino.h>
-#include <RGBConverter.h>
 #include <Units.h>
 #include <TokenIterator.h>
 #include <ParsedColor.h>
 #include <MiLightCommands.h>
-#include <functional>
-
-using namespace std::placeholders;
 
 static const uint8_t STATUS_UNDEFINED = 255;
 
-const char* MiLightClient::FIELD_ORDERINGS[] = {
-  // These are handled manually
-  // GroupStateFieldNames::STATE,
-  // GroupStateFieldNames::STATUS,
-  GroupStateFieldNames::HUE,
-  GroupStateFieldNames::SATURATION,
-  GroupStateFieldNames::KELVIN,
-  GroupStateFieldNames::TEMPERATURE,
-  GroupStateFieldNames::COLOR_TEMP,
-  GroupStateFieldNames::MODE,
-  GroupStateFieldNames::EFFECT,
-  GroupStateFieldNames::COLOR,
+struct FieldSetter {
+  const char* name;
+  // Field to transition when the request has a transition period
+  GroupStateField field;
+  void (*apply)(MiLightClient* client, JsonVariant value);
+};
+
+static void setHue(MiLightClient* client, JsonVariant value) {
+  client->updateHue(value.as<uint16_t>());
+}
+
+static void setSaturation(MiLightClient* client, JsonVariant value) {
+  client->updateSaturation(value.as<uint8_t>());
+}
+
+static void setKelvin(MiLightClient* client, JsonVariant value) {
+  client->updateTemperature(value.as<uint8_t>());
+}
+
+static void setColorTemp(MiLightClient* client, JsonVariant value) {
+  client->updateTemperature(Units::miredsToWhiteVal(value.as<uint16_t>(), 100));
+}
+
+static void setMode(MiLightClient* client, JsonVariant value) {
+  client->updateMode(value.as<uint8_t>());
+}
+
+static void setEffect(MiLightClient* client, JsonVariant value) {
+  client->handleEffect(value.as<String>());
+}
+
+static void setColor(MiLightClient* client, JsonVariant value) {
+  client->updateColor(value);
+}
+
+static void setLevel(MiLightClient* client, JsonVariant value) {
+  client->updateBrightness(value.as<uint8_t>());
+}
+
+static void setBrightness(MiLightClient* client, JsonVariant value) {
+  client->updateBrightness(Units::rescale<uint16_t, uint16_t>(value.as<uint16_t>(), 100, 255));
+}
+
+static void setCommand(MiLightClient* client, JsonVariant value) {
+  client->handleCommand(value);
+}
+
+static void setCommands(MiLightClient* client, JsonVariant value) {
+  client->handleCommands(value.as<JsonArray>());
+}
+
+// Fields are applied in this order.  State/status are handled separately.
+static constexpr FieldSetter FIELD_SETTERS[] = {
+  {GroupStateFieldNames::HUE, GroupStateField::HUE, setHue},
+  {GroupStateFieldNames::SATURATION, GroupStateField::SATURATION, setSaturation},
+  {GroupStateFieldNames::KELVIN, GroupStateField::KELVIN, setKelvin},
+  {GroupStateFieldNames::TEMPERATURE, GroupStateField::KELVIN, setKelvin},
+  {GroupStateFieldNames::COLOR_TEMP, GroupStateField::COLOR_TEMP, setColorTemp},
+  {GroupStateFieldNames::MODE, GroupStateField::MODE, setMode},
+  {GroupStateFieldNames::EFFECT, GroupStateField::EFFECT, setEffect},
+  {GroupStateFieldNames::COLOR, GroupStateField::COLOR, setColor},
   // Level/Brightness must be processed last because they're specific to a particular bulb mode.
   // So make sure bulb mode is set before applying level/brightness.
-  GroupStateFieldNames::LEVEL,
-  GroupStateFieldNames::BRIGHTNESS,
-  GroupStateFieldNames::COMMAND,
-  GroupStateFieldNames::COMMANDS
+  {GroupStateFieldNames::LEVEL, GroupStateField::LEVEL, setLevel},
+  {GroupStateFieldNames::BRIGHTNESS, GroupStateField::BRIGHTNESS, setBrightness},
+  {GroupStateFieldNames::COMMAND, GroupStateField::UNKNOWN, setCommand},
+  {GroupStateFieldNames::COMMANDS, GroupStateField::UNKNOWN, setCommands}
 };
 
-const std::map<const char*, std::function<void(MiLightClient*, JsonVariant)>, MiLightClient::cmp_str> MiLightClient::FIELD_SETTERS = {
-  {
-    GroupStateFieldNames::STATUS,
-    [](MiLightClient* client, JsonVariant val) {
-      client->updateStatus(parseMilightStatus(val));
-    }
-  },
-  {GroupStateFieldNames::LEVEL, &MiLightClient::updateBrightness},
-  {
-    GroupStateFieldNames::BRIGHTNESS,
-    [](MiLightClient* client, uint16_t arg) {
-      client->updateBrightness(Units::rescale<uint16_t, uint16_t>(arg, 100, 255));
-    }
-  },
-  {GroupStateFieldNames::HUE, &MiLightClient::updateHue},
-  {GroupStateFieldNames::SATURATION, &MiLightClient::updateSaturation},
-  {GroupStateFieldNames::KELVIN, &MiLightClient::updateTemperature},
-  {GroupStateFieldNames::TEMPERATURE, &MiLightClient::updateTemperature},
-  {
-    GroupStateFieldNames::COLOR_TEMP,
-    [](MiLightClient* client, uint16_t arg) {
-      client->updateTemperature(Units::miredsToWhiteVal(arg, 100));
-    }
-  },
-  {GroupStateFieldNames::MODE, &MiLightClient::updateMode},
-  {GroupStateFieldNames::COLOR, &MiLightClient::updateColor},
-  {GroupStateFieldNames::EFFECT, &MiLightClient::handleEffect},
-  {GroupStateFieldNames::COMMAND, &MiLightClient::handleCommand},
-  {GroupStateFieldNames::COMMANDS, &MiLightClient::handleCommands}
-};
+static constexpr size_t NUM_FIELD_SETTERS = sizeof(FIELD_SETTERS) / sizeof(FIELD_SETTERS[0]);
+
+// Setters are found through a perfect hash of the field name, see
+// GroupStateFieldHash
+static constexpr const char* hashedFieldName(const FieldSetter& setter) {
+  return setter.name;
+}
+
+static_assert(! GroupStateFieldHash::slotsCollide(FIELD_SETTERS), "Field setter names collide.  Pick a different GroupStateFieldHash::SEED.");
+static_assert(NUM_FIELD_SETTERS <= 16, "Field setter bitmask in MiLightClient::update is 16 bits");
+
+static constexpr GroupStateFieldHash::SlotTable FIELD_SETTER_SLOTS = GroupStateFieldHash::slotTable(FIELD_SETTERS);
+
+// Returns index into FIELD_SETTERS, or -1 if there's no setter for the field
+static int8_t findFieldSetter(const char* name) {
+  return GroupStateFieldHash::find(FIELD_SETTERS, FIELD_SETTER_SLOTS, name);
+}
 
 MiLightClient::MiLightClient(
   RadioSwitchboard& radioSwitchboard,
@@ -77,6 +109,7 @@ MiLightClient::MiLightClient(
   , packetSender(packetSender)
   , transitions(transitions)
   , repeatsOverride(0)
+  , updating(false)
 { }
 
 void MiLightClient::setHeld(bool held) {
@@ -305,6 +338,8 @@ void MiLightClient::update(JsonObject request) {
     this->updateBeginHandler();
   }
 
+  updating = true;
+
   const JsonVariant status = this->extractStatus(request);
   const uint8_t parsedStatus = this->parseStatus(status);
   const JsonVariant jsonTransition = request[RequestKeys::TRANSITION];
@@ -355,25 +390,35 @@ void MiLightClient::update(JsonObject request) {
     }
   }
 
-  for (const char* fieldName : FIELD_ORDERINGS) {
-    if (request.containsKey(fieldName)) {
-      auto handler = FIELD_SETTERS.find(fieldName);
-      JsonVariant value = request[fieldName];
-
-      if (handler != FIELD_SETTERS.end()) {
-        // No transition -- set field directly
-        if (transition == 0) {
-          handler->second(this, value);
-        } else {
-          GroupStateField field = GroupStateFieldHelpers::getFieldByName(fieldName);
-
-          if (   !GroupStateFieldHelpers::isBrightnessField(field)  // If field isn't brightness
-               || parsedStatus == STATUS_UNDEFINED                  // or if there was not a status field
-               || currentState->isOn()                              // or if bulb was already on
-          ) {
-            handleTransition(field, value, transition);
-          }
-        }
+  // Pick out fields with setters in a single pass, bucketed by the order they're applied in
+  JsonVariant fieldValues[NUM_FIELD_SETTERS];
+  uint16_t presentFields = 0;
+
+  for (JsonPair kv : request) {
+    const int8_t setterIx = findFieldSetter(kv.key().c_str());
+
+    if (setterIx >= 0) {
+      fieldValues[setterIx] = kv.value();
+      presentFields |= (1 << setterIx);
+    }
+  }
+
+  for (size_t i = 0; i < NUM_FIELD_SETTERS; i++) {
+    if (! (presentFields & (1 << i))) {
+      continue;
+    }
+
+    const FieldSetter& setter = FIELD_SETTERS[i];
+
+    // No transition -- set field directly
+    if (transition == 0) {
+      setter.apply(this, fieldValues[i]);
+    } else {
+      if (   !GroupStateFieldHelpers::isBrightnessField(setter.field)  // If field isn't brightness
+           || parsedStatus == STATUS_UNDEFINED                         // or if there was not a status field
+           || currentState->isOn()                                     // or if bulb was already on
+      ) {
+        handleTransition(setter.field, fieldValues[i], transition);
       }
     }
   }
@@ -392,6 +437,9 @@ void MiLightClient::update(JsonObject request) {
     }
   }
 
+  updating = false;
+  commandStamp = CommandStamp();
+
   if (this->updateEndHandler) {
     this->updateEndHandler();
   }
@@ -570,10 +618,19 @@ bool MiLightClient::handleTransition(JsonObject args, JsonDocument& responseObj)
       return false;
     }
 
+    // Default to stepping in RGB space
+    ColorSpace colorSpace = ColorSpace::RGB;
+    const char* colorSpaceName = args[FS(TransitionParams::COLOR_SPACE)];
+
+    if (colorSpaceName != nullptr && strcasecmp_P(colorSpaceName, PSTR("hsv")) == 0) {
+      colorSpace = ColorSpace::HSV;
+    }
+
     transitionBuilder = transitions.buildColorTransition(
       bulbId,
       _startValue,
-      endColor
+      endColor,
+      colorSpace
     );
   }
 
@@ -642,18 +699,32 @@ void MiLightClient::setRepeatsOverride(size_t repeats) {
   this->repeatsOverride = repeats;
 }
 
+void MiLightClient::stampCommand(CommandSource source) {
+  this->commandStamp = CommandStamp(source);
+}
+
+void MiLightClient::stampCommand(const CommandStamp& stamp) {
+  this->commandStamp = stamp;
+}
+
 void MiLightClient::clearRepeatsOverride() {
   this->repeatsOverride = PacketSender::DEFAULT_PACKET_SENDS_VALUE;
 }
 
 void MiLightClient::flushPacket() {
   PacketStream& stream = currentRemote->packetFormatter->buildPackets();
+  const uint16_t deviceId = currentRemote->packetFormatter->currentBulbId().deviceId;
 
   while (stream.hasNext()) {
-    packetSender.enqueue(stream.next(), currentRemote, repeatsOverride);
+    packetSender.enqueue(stream.next(), currentRemote, repeatsOverride, deviceId, commandStamp);
   }
 
   currentRemote->packetFormatter->reset();
+
+  // Later packets that nobody stamps shouldn't be traced to this command
+  if (! updating) {
+    commandStamp = CommandStamp();
+  }
 }
 
 void MiLightClient::onUpdateBegin(EventHandler handler) {
@@ -7,8 +7,6 @@
 #include <GroupStateStore.h>
 #include <PacketSender.h>
 #include <TransitionController.h>
-#include <cstring>
-#include <map>
 #include <set>
 
 #ifndef _MILIGHTCLIENT_H
@@ -29,6 +27,7 @@ namespace TransitionParams {
   static const char END_VALUE[] PROGMEM = "end_value";
   static const char DURATION[] PROGMEM = "duration";
   static const char PERIOD[] PROGMEM = "period";
+  static const char COLOR_SPACE[] PROGMEM = "color_space";
 }
 
 // Used to determine RGB colros that are approximately white
@@ -54,6 +53,12 @@ public:
   void prepare(const MiLightRemoteConfig* remoteConfig, const uint16_t deviceId = -1, const uint8_t groupId = -1);
   void prepare(const MiLightRemoteType type, const uint16_t deviceId = -1, const uint8_t groupId = -1);
 
+  // Marks the arrival of a command.  Packets built for it are traced back to
+  // it, see CommandLatency.  The stamp is dropped at the end of update(), or
+  // after the next packet when the command doesn't go through update().
+  void stampCommand(CommandSource source);
+  void stampCommand(const CommandStamp& stamp);
+
   void setResendCount(const unsigned int resendCount);
   bool available();
   size_t read(uint8_t packet[]);
@@ -116,14 +121,6 @@ public:
   JsonVariant extractStatus(JsonObject object);
 
 protected:
-  struct cmp_str {
-    bool operator()(char const *a, char const *b) const {
-        return std::strcmp(a, b) < 0;
-    }
-  };
-  static const std::map<const char*, std::function<void(MiLightClient*, JsonVariant)>, cmp_str> FIELD_SETTERS;
-  static const char* FIELD_ORDERINGS[];
-
   RadioSwitchboard& radioSwitchboard;
   std::vector<std::shared_ptr<MiLightRadio>> radios;
   std::shared_ptr<MiLightRadio> currentRadio;
@@ -141,6 +138,10 @@ protected:
   // If set, override the number of packet repeats used.
   size_t repeatsOverride;
 
+  CommandStamp commandStamp;
+  // Inside update(), which can flush several packets for one command
+  bool updating;
+
   void flushPacket();
 };
 
@@ -1,5 +1,6 @@
 #include <MiLightRemoteConfig.h>
 #include <MiLightRemoteType.h>
+#include <V2RFEncoding.h>
 
 /**
  * IMPORTANT NOTE: These should be in the same order as MiLightRemoteType.
@@ -30,25 +31,101 @@ const MiLightRemoteConfig* MiLightRemoteConfig::fromType(MiLightRemoteType type)
   return ALL_REMOTES[type];
 }
 
+// Remotes that share a radio config.  These are told apart by the protocol ID
+// in their (V2 encoded) packets.
+static const MiLightRemoteConfig* const V2_REMOTES[] = {
+  &FUT092Config,
+  &FUT089Config,
+  &FUT091Config
+};
+
+// Slots for V2 remotes are picked by the low bits of the protocol ID
+#define V2_PROTOCOL_SLOTS 8
+
+struct V2RemoteSlot {
+  uint8_t protocolId;
+  const MiLightRemoteConfig* remote;
+};
+
+// Received packets are classified in one step: the radio config they came in
+// on picks the remote, or for a shared radio config, the decoded protocol ID
+// does.  Built the first time it's needed.
+static const MiLightRemoteConfig* remotesByRadioConfig[MiLightRadioConfig::NUM_CONFIGS];
+static V2RemoteSlot remotesByProtocolId[V2_PROTOCOL_SLOTS];
+static bool receivedPacketClassifierBuilt = false;
+
+static void buildReceivedPacketClassifier() {
+  uint8_t remotesPerRadioConfig[MiLightRadioConfig::NUM_CONFIGS] = { };
+
+  for (size_t i = 0; i < MiLightRemoteConfig::NUM_REMOTES; i++) {
+    const MiLightRemoteConfig* remote = MiLightRemoteConfig::ALL_REMOTES[i];
+    const size_t radioIx = &remote->radioConfig - MiLightRadioConfig::ALL_CONFIGS;
+
+    remotesByRadioConfig[radioIx] = remote;
+    ++remotesPerRadioConfig[radioIx];
+  }
+
+  // Shared radio configs go through the protocol ID table instead
+  for (size_t i = 0; i < MiLightRadioConfig::NUM_CONFIGS; i++) {
+    if (remotesPerRadioConfig[i] > 1) {
+      remotesByRadioConfig[i] = NULL;
+    }
+  }
+
+  for (size_t i = 0; i < size(V2_REMOTES); i++) {
+    const MiLightRemoteConfig* remote = V2_REMOTES[i];
+    const uint8_t protocolId = static_cast<V2PacketFormatter*>(remote->packetFormatter)->getProtocolId();
+    V2RemoteSlot& slot = remotesByProtocolId[protocolId % V2_PROTOCOL_SLOTS];
+
+    if (slot.remote != NULL) {
+      Serial.print(F("ERROR: V2 protocol IDs collide in packet classifier: "));
+      Serial.println(remote->name);
+    }
+
+    slot.protocolId = protocolId;
+    slot.remote = remote;
+  }
+
+  receivedPacketClassifierBuilt = true;
+}
+
 const MiLightRemoteConfig* MiLightRemoteConfig::fromReceivedPacket(
   const MiLightRadioConfig& radioConfig,
   const uint8_t* packet,
   const size_t len
 ) {
-  for (size_t i = 0; i < MiLightRemoteConfig::NUM_REMOTES; i++) {
-    const MiLightRemoteConfig* config = MiLightRemoteConfig::ALL_REMOTES[i];
-    if (&config->radioConfig == &radioConfig
-      && config->packetFormatter->canHandle(packet, len)) {
-      return config;
+  if (! receivedPacketClassifierBuilt) {
+    buildReceivedPacketClassifier();
+  }
+
+  const size_t radioIx = &radioConfig - MiLightRadioConfig::ALL_CONFIGS;
+  const MiLightRemoteConfig* config = NULL;
+
+  if (radioIx < MiLightRadioConfig::NUM_CONFIGS) {
+    config = remotesByRadioConfig[radioIx];
+
+    if (config == NULL) {
+      if (len == V2_PACKET_LEN) {
+        const uint8_t protocolId = V2RFEncoding::decodeV2Byte(packet, V2_PROTOCOL_ID_INDEX);
+        const V2RemoteSlot& slot = remotesByProtocolId[protocolId % V2_PROTOCOL_SLOTS];
+
+        if (slot.remote != NULL && slot.protocolId == protocolId && &slot.remote->radioConfig == &radioConfig) {
+          config = slot.remote;
+        }
+      }
+    } else if (! config->packetFormatter->canHandle(packet, len)) {
+      config = NULL;
     }
   }
 
   // This can happen under normal circumstances, so not an error condition
 #ifdef DEBUG_PRINTF
-  Serial.println(F("MiLightRemoteConfig::fromReceivedPacket: ERROR - tried to fetch remote config for unknown packet"));
+  if (config == NULL) {
+    Serial.println(F("MiLightRemoteConfig::fromReceivedPacket: ERROR - tried to fetch remote config for unknown packet"));
+  }
 #endif
 
-  return NULL;
+  return config;
 }
 
 const MiLightRemoteConfig FUT096Config( //rgbw
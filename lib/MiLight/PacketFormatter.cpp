@@ -1,4 +1,5 @@
 #include <PacketFormatter.h>
+#include <MiLightRemoteConfig.h>
 
 static uint8_t* PACKET_BUFFER = new uint8_t[PACKET_FORMATTER_BUFFER_SIZE];
 
@@ -80,10 +81,18 @@ void PacketFormatter::enableNightMode() { }
 void PacketFormatter::updateTemperature(uint8_t value) { }
 void PacketFormatter::updateSaturation(uint8_t value) { }
 
-BulbId PacketFormatter::parsePacket(const uint8_t *packet, JsonObject result) {
+BulbId PacketFormatter::parsePacket(const uint8_t *packet, ParsedPacket& result) {
   return DEFAULT_BULB_ID;
 }
 
+BulbId PacketFormatter::parsePacket(const uint8_t *packet, JsonObject result) {
+  ParsedPacket parsed;
+  BulbId bulbId = parsePacket(packet, parsed);
+
+  parsed.serialize(result);
+  return bulbId;
+}
+
 void PacketFormatter::pair() {
   for (size_t i = 0; i < 5; i++) {
     updateStatus(ON);
@@ -105,33 +114,109 @@ PacketStream& PacketFormatter::buildPackets() {
   return packetStream;
 }
 
-void PacketFormatter::valueByStepFunction(StepFunction increase, StepFunction decrease, uint8_t numSteps, uint8_t targetValue, int8_t knownValue) {
-  StepFunction fn;
-  size_t numCommands = 0;
+void PacketFormatter::valueByStepFunction(StepFunction increase, StepFunction decrease, uint8_t numSteps, uint8_t targetValue, StepRange current) {
+  StepFunction firstFn, secondFn;
+  size_t firstCommands, secondCommands;
+
+  targetValue = min(targetValue, numSteps);
+
+  if (current.isKnown()) {
+    firstFn = targetValue < current.low ? decrease : increase;
+    firstCommands = targetValue < current.low ? (current.low - targetValue) : (targetValue - current.low);
+    secondFn = firstFn;
+    secondCommands = 0;
+  } else if ((current.high + targetValue) <= ((numSteps - current.low) + (numSteps - targetValue))) {
+    // Cheaper to bottom out and step up
+    firstFn = decrease;
+    firstCommands = current.high;
+    secondFn = increase;
+    secondCommands = targetValue;
+  } else {
+    firstFn = increase;
+    firstCommands = numSteps - current.low;
+    secondFn = decrease;
+    secondCommands = numSteps - targetValue;
+  }
+
+  for (size_t i = 0; i < firstCommands; i++) {
+    (this->*firstFn)();
+  }
+  for (size_t i = 0; i < secondCommands; i++) {
+    (this->*secondFn)();
+  }
+}
+
+static uint8_t toStepPosition(uint16_t value, uint8_t numSteps, uint8_t stepSize) {
+  return min(static_cast<uint16_t>(value / stepSize), static_cast<uint16_t>(numSteps));
+}
+
+// Where a single group's field could be: exact if its state has it, bounded
+// on one side if increment commands left scratch state, otherwise anywhere
+static StepRange groupStepRange(const GroupState* state, GroupStateField field, uint8_t numSteps, uint8_t stepSize) {
+  StepRange range = { 0, numSteps };
 
-  // If current value is not known, drive down to minimum value.  Then we can assume that we
-  // know the state (it'll be 0).
-  if (knownValue == -1) {
-    for (size_t i = 0; i < numSteps; i++) {
-      (this->*decrease)();
+  if (state == NULL) {
+    return range;
+  }
+
+  if (state->isSetField(field)) {
+    range.low = range.high = toStepPosition(state->getFieldValue(field), numSteps, stepSize);
+  } else if (state->isSetScratchField(field)) {
+    uint8_t scratch = toStepPosition(state->getScratchFieldValue(field), numSteps, 1);
+
+    if (state->isScratchFieldUpperBound(field)) {
+      range.high = scratch;
+    } else {
+      range.low = scratch;
     }
+  }
 
-    fn = increase;
-    numCommands = targetValue;
-  } else if (targetValue < knownValue) {
-    fn = decrease;
-    numCommands = (knownValue - targetValue);
-  } else if (targetValue > knownValue) {
-    fn = increase;
-    numCommands = (targetValue - knownValue);
-  } else {
-    return;
+  return range;
+}
+
+StepRange PacketFormatter::findStepRange(GroupStateField field, uint8_t numSteps, uint8_t stepSize) {
+  if (stateStore == NULL) {
+    StepRange range = { 0, numSteps };
+    return range;
   }
 
-  // Get to the desired value
-  for (size_t i = 0; i < numCommands; i++) {
-    (this->*fn)();
+  // Ranges are copied out as they're found, because fetching other groups can
+  // evict earlier ones from the cache
+  if (groupId != 0) {
+    StepRange range = groupStepRange(stateStore->get(deviceId, groupId, deviceType), field, numSteps, stepSize);
+
+    if (range.isKnown()) {
+      return range;
+    }
+
+    // Group 0 state is cleared as soon as an individual group diverges from it
+    const GroupState* group0State = stateStore->get(deviceId, 0, deviceType);
+
+    if (group0State != NULL && group0State->isSetField(field)) {
+      range.low = range.high = toStepPosition(group0State->getFieldValue(field), numSteps, stepSize);
+    }
+
+    return range;
+  }
+
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(deviceType);
+
+  if (remoteConfig == NULL || remoteConfig->numGroups == 0) {
+    return groupStepRange(stateStore->get(deviceId, 0, deviceType), field, numSteps, stepSize);
   }
+
+  // Group 0 commands reach every group, so the range has to cover all of them.
+  // Each group's own scratch is used rather than group 0's, which is dropped
+  // once the groups stop moving together.
+  StepRange groupsRange = { numSteps, 0 };
+
+  for (uint8_t i = 1; i <= remoteConfig->numGroups; i++) {
+    StepRange range = groupStepRange(stateStore->get(deviceId, i, deviceType), field, numSteps, stepSize);
+    groupsRange.low = min(groupsRange.low, range.low);
+    groupsRange.high = max(groupsRange.high, range.high);
+  }
+
+  return groupsRange;
 }
 
 void PacketFormatter::prepare(uint16_t deviceId, uint8_t groupId) {
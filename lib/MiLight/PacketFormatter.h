@@ -4,6 +4,7 @@
 #include <MiLightRemoteType.h>
 #include <ArduinoJson.h>
 #include <GroupState.h>
+#include <ParsedPacket.h>
 #include <GroupStateStore.h>
 #include <Settings.h>
 
@@ -15,6 +16,15 @@
 //   (10 * 7) + (10 * 7) = 140
 #define PACKET_FORMATTER_BUFFER_SIZE 140
 
+// Range of positions (in steps) a field controlled only by increment/decrement
+// commands could currently be in.
+struct StepRange {
+  uint8_t low;
+  uint8_t high;
+
+  bool isKnown() const { return low == high; }
+};
+
 struct PacketStream {
   PacketStream();
 
@@ -83,7 +93,10 @@ public:
   virtual void prepare(uint16_t deviceId, uint8_t groupId);
   virtual void format(uint8_t const* packet, char* buffer);
 
-  virtual BulbId parsePacket(const uint8_t* packet, JsonObject result);
+  // Decodes a packet straight into the fields it sets
+  virtual BulbId parsePacket(const uint8_t* packet, ParsedPacket& result);
+  // Same, as JSON.  Formatters only need to implement the typed version.
+  BulbId parsePacket(const uint8_t* packet, JsonObject result);
   virtual BulbId currentBulbId() const;
 
   static void formatV1Packet(uint8_t const* packet, char* buffer);
@@ -105,13 +118,17 @@ protected:
 
   void pushPacket();
 
-  // Get field into a desired state using only increment/decrement commands.  Do this by:
-  //   1. Driving it down to its minimum value
-  //   2. Applying the appropriate number of increase commands to get it to the desired
-  //      value.
-  // If the current state is already known, take that into account and apply the exact
-  // number of rpeeats for the appropriate command.
-  void valueByStepFunction(StepFunction increase, StepFunction decrease, uint8_t numSteps, uint8_t targetValue, int8_t knownValue = -1);
+  // Get field into a desired state using only increment/decrement commands.
+  //
+  // If the current position is known exactly, apply the exact number of repeats for the
+  // appropriate command.  Otherwise drive it to whichever extreme is cheaper given what
+  // we know, and step from there.
+  void valueByStepFunction(StepFunction increase, StepFunction decrease, uint8_t numSteps, uint8_t targetValue, StepRange current);
+
+  // Narrow down where a field could be using (in order of preference) this group's state,
+  // group 0's state, and scratch state left by increment commands.  Commands for group 0
+  // cover the range of every group.
+  StepRange findStepRange(GroupStateField field, uint8_t numSteps, uint8_t stepSize);
 
   virtual void initializePacket(uint8_t* packetStart) = 0;
   virtual void finalizePacket(uint8_t* packet);
@@ -1,14 +1,36 @@
 #include <PacketQueue.h>
+#include <AllocationTracker.h>
 
 PacketQueue::PacketQueue()
   : droppedPackets(0)
 { }
 
-void PacketQueue::push(const uint8_t* packet, const MiLightRemoteConfig* remoteConfig, const size_t repeatsOverride) {
+bool QueuedPacket::conflictsWith(const QueuedPacket& other) const {
+  // Raw packets could be addressed to anything, even under another remote type
+  if (deviceId == UNKNOWN_DEVICE || other.deviceId == UNKNOWN_DEVICE) {
+    return true;
+  }
+
+  return remoteConfig == other.remoteConfig && deviceId == other.deviceId;
+}
+
+std::shared_ptr<QueuedPacket> PacketQueue::push(
+  const uint8_t* packet,
+  const MiLightRemoteConfig* remoteConfig,
+  const size_t repeatsOverride,
+  const int32_t deviceId,
+  const CommandStamp& stamp
+) {
   std::shared_ptr<QueuedPacket> qp = checkoutPacket();
   memcpy(qp->packet, packet, remoteConfig->packetFormatter->getPacketLength());
   qp->remoteConfig = remoteConfig;
   qp->repeatsOverride = repeatsOverride;
+  qp->deviceId = deviceId;
+  qp->stamp = stamp;
+  qp->dequeued = false;
+  qp->transmitted = false;
+
+  return qp;
 }
 
 bool PacketQueue::isEmpty() const {
@@ -23,12 +45,41 @@ std::shared_ptr<QueuedPacket> PacketQueue::pop() {
   return queue.shift();
 }
 
+std::shared_ptr<QueuedPacket> PacketQueue::popInterleavable(const std::shared_ptr<QueuedPacket> active[], size_t numActive) {
+  for (ListNode<std::shared_ptr<QueuedPacket>>* node = queue.getHead(); node != NULL; node = node->next) {
+    const QueuedPacket& candidate = *node->data;
+
+    if (numActive > 0 && &candidate.remoteConfig->radioConfig != &active[0]->remoteConfig->radioConfig) {
+      break;
+    }
+
+    bool blocked = false;
+
+    for (size_t i = 0; i < numActive && !blocked; i++) {
+      blocked = active[i]->conflictsWith(candidate);
+    }
+
+    for (ListNode<std::shared_ptr<QueuedPacket>>* earlier = queue.getHead(); earlier != node && !blocked; earlier = earlier->next) {
+      blocked = earlier->data->conflictsWith(candidate);
+    }
+
+    if (!blocked) {
+      std::shared_ptr<QueuedPacket> packet = node->data;
+      queue.remove(node);
+      return packet;
+    }
+  }
+
+  return nullptr;
+}
+
 std::shared_ptr<QueuedPacket> PacketQueue::checkoutPacket() {
   if (queue.size() == MILIGHT_MAX_QUEUED_PACKETS) {
     ++droppedPackets;
     return queue.getLast();
   } else {
     std::shared_ptr<QueuedPacket> packet = std::make_shared<QueuedPacket>();
+    TRACK_ALLOCATION(PACKET_QUEUE_ENTRY, sizeof(QueuedPacket));
     queue.add(packet);
     return packet;
   }
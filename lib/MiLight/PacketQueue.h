@@ -5,23 +5,57 @@
 #include <CircularBuffer.h>
 #include <MiLightRadioConfig.h>
 #include <MiLightRemoteConfig.h>
+#include <CommandLatency.h>
 
 #ifndef MILIGHT_MAX_QUEUED_PACKETS
 #define MILIGHT_MAX_QUEUED_PACKETS 20
 #endif
 
+// Max number of packets whose repeats are interleaved with each other
+#ifndef MILIGHT_MAX_INTERLEAVED_PACKETS
+#define MILIGHT_MAX_INTERLEAVED_PACKETS 4
+#endif
+
 struct QueuedPacket {
+  static const int32_t UNKNOWN_DEVICE = -1;
+
   uint8_t packet[MILIGHT_MAX_PACKET_LENGTH];
   const MiLightRemoteConfig* remoteConfig;
   size_t repeatsOverride;
+  // Device ID the packet is addressed to, or UNKNOWN_DEVICE for raw packets
+  int32_t deviceId;
+
+  // Where the command came from, and which latency stages have been recorded
+  CommandStamp stamp;
+  bool dequeued;
+  bool transmitted;
+
+  // True if the packets could be for the same bulb, in which case their
+  // repeats can't be mixed without the bulb possibly acting on them twice or
+  // out of order.  Packets with an unknown device conflict with everything.
+  bool conflictsWith(const QueuedPacket& other) const;
 };
 
 class PacketQueue {
 public:
   PacketQueue();
 
-  void push(const uint8_t* packet, const MiLightRemoteConfig* remoteConfig, const size_t repeatsOverride);
+  // Returns the queued copy
+  std::shared_ptr<QueuedPacket> push(
+    const uint8_t* packet,
+    const MiLightRemoteConfig* remoteConfig,
+    const size_t repeatsOverride,
+    const int32_t deviceId = QueuedPacket::UNKNOWN_DEVICE,
+    const CommandStamp& stamp = CommandStamp()
+  );
   std::shared_ptr<QueuedPacket> pop();
+
+  // Removes and returns the oldest packet which can be sent alongside the
+  // active ones: it uses the same radio config, and no active or earlier
+  // queued packet conflicts with it.  Stops looking at the first packet for a
+  // different radio config so that one can't be starved.  Returns nullptr if
+  // nothing qualifies.
+  std::shared_ptr<QueuedPacket> popInterleavable(const std::shared_ptr<QueuedPacket> active[], size_t numActive);
   bool isEmpty() const;
   size_t size() const;
   size_t getDroppedPacketCount() const;
@@ -7,97 +7,157 @@ PacketSender::PacketSender(
   PacketSentHandler packetSentHandler
 ) : radioSwitchboard(radioSwitchboard)
   , settings(settings)
-  , currentPacket(nullptr)
-  , packetRepeatsRemaining(0)
+  , adaptiveRepeats(settings)
+  , numActivePackets(0)
+  , nextActiveIx(0)
   , packetSentHandler(packetSentHandler)
+  , recentPackets()
+  , nextRecentIx(0)
   , lastSend(0)
   , currentResendCount(settings.packetRepeats)
-  , throttleMultiplier(
-      std::ceil(
-        (settings.packetRepeatThrottleSensitivity / 1000.0) * settings.packetRepeats
-      )
-    )
-{ }
-
-void PacketSender::enqueue(uint8_t* packet, const MiLightRemoteConfig* remoteConfig, const size_t repeatsOverride) {
-#ifdef DEBUG_PRINTF
-  Serial.println("Enqueuing packet");
-#endif
-  size_t repeats = repeatsOverride == DEFAULT_PACKET_SENDS_VALUE
-    ? this->currentResendCount
-    : repeatsOverride;
+{
+  reloadSettings();
+}
+
+void PacketSender::reloadSettings() {
+  throttleMultiplier = std::ceil(
+    (settings.packetRepeatThrottleSensitivity / 1000.0) * settings.packetRepeats
+  );
 
-  queue.push(packet, remoteConfig, repeats);
+  if (currentResendCount > settings.packetRepeats) {
+    currentResendCount = settings.packetRepeats;
+  }
 }
 
-void PacketSender::loop() {
-  // Switch to the next packet if we're done with the current one
-  if (packetRepeatsRemaining == 0 && !queue.isEmpty()) {
-    nextPacket();
+void PacketSender::adoptPackets(PacketSender& previous) {
+  // Carry on with what was on the air rather than queueing it again, so
+  // nothing goes out of order and the queue has room for everything waiting
+  for (size_t i = 0; i < previous.numActivePackets; i++) {
+    activePackets[i] = previous.activePackets[i];
+    repeatsRemaining[i] = previous.repeatsRemaining[i];
+    previous.activePackets[i] = nullptr;
   }
 
-  // If there's a packet we're handling, deal with it
-  if (currentPacket != nullptr && packetRepeatsRemaining > 0) {
-    handleCurrentPacket();
+  numActivePackets = previous.numActivePackets;
+  nextActiveIx = previous.nextActiveIx;
+  previous.numActivePackets = 0;
+
+  while (!previous.queue.isEmpty()) {
+    std::shared_ptr<QueuedPacket> packet = previous.queue.pop();
+    queue.push(packet->packet, packet->remoteConfig, packet->repeatsOverride, packet->deviceId, packet->stamp);
   }
-}
 
-bool PacketSender::isSending() {
-  return packetRepeatsRemaining > 0 || !queue.isEmpty();
+  // Repeats the old sender just finished can still be heard
+  memcpy(recentPackets, previous.recentPackets, sizeof(recentPackets));
+  nextRecentIx = previous.nextRecentIx;
+
+  lastSend = previous.lastSend;
+  currentResendCount = previous.currentResendCount;
 }
 
-void PacketSender::nextPacket() {
+void PacketSender::enqueue(
+  uint8_t* packet,
+  const MiLightRemoteConfig* remoteConfig,
+  const size_t repeatsOverride,
+  const int32_t deviceId,
+  const CommandStamp& stamp
+) {
 #ifdef DEBUG_PRINTF
-  Serial.printf("Switching to next packet, %d packets in queue\n", queue.size());
+  Serial.println("Enqueuing packet");
 #endif
-  currentPacket = queue.pop();
+  size_t repeats = repeatsOverride;
+
+  if (repeats == DEFAULT_PACKET_SENDS_VALUE) {
+    repeats = this->currentResendCount;
 
-  if (currentPacket->repeatsOverride > 0) {
-    packetRepeatsRemaining = currentPacket->repeatsOverride;
-  } else {
-    packetRepeatsRemaining = settings.packetRepeats;
+    // Throttling can still take repeats lower than what the link needs
+    if (settings.adaptivePacketRepeats) {
+      repeats = std::min(repeats, adaptiveRepeats.repeatsFor(*remoteConfig));
+    }
   }
 
-  // Adjust resend count according to throttling rules
-  updateResendCount();
+  queue.push(packet, remoteConfig, repeats, deviceId, stamp);
 }
 
-void PacketSender::handleCurrentPacket() {
-  // Always switch radio.  could've been listening in another context
-  radioSwitchboard.switchRadio(currentPacket->remoteConfig);
-
-  size_t numToSend = std::min(packetRepeatsRemaining, settings.packetRepeatsPerLoop);
-  sendRepeats(numToSend);
-  packetRepeatsRemaining -= numToSend;
+void PacketSender::loop() {
+  // Switch to the next packet(s) if there's room
+  fillActivePackets();
 
-  // If we're done sending this packet, fire the sent packet callback
-  if (packetRepeatsRemaining == 0 && packetSentHandler != nullptr) {
-    packetSentHandler(currentPacket->packet, *currentPacket->remoteConfig);
+  // If there are packets we're handling, deal with them
+  if (numActivePackets > 0) {
+    sendActiveRepeats();
   }
 }
 
-size_t PacketSender::queueLength() const {
-  return queue.size();
+bool PacketSender::isSending() {
+  return numActivePackets > 0 || !queue.isEmpty();
 }
 
-size_t PacketSender::droppedPackets() const {
-  return queue.getDroppedPacketCount();
-}
+void PacketSender::fillActivePackets() {
+  const size_t maxActive = settings.interleavePacketRepeats ? MILIGHT_MAX_INTERLEAVED_PACKETS : 1;
 
-void PacketSender::sendRepeats(size_t num) {
-  size_t len = currentPacket->remoteConfig->packetFormatter->getPacketLength();
+  while (numActivePackets < maxActive && !queue.isEmpty()) {
+    std::shared_ptr<QueuedPacket> packet = queue.popInterleavable(activePackets, numActivePackets);
+
+    if (packet == nullptr) {
+      break;
+    }
 
 #ifdef DEBUG_PRINTF
-  Serial.printf_P(PSTR("Sending packet (%d repeats): \n"), num);
-  for (size_t i = 0; i < len; i++) {
-    Serial.printf_P(PSTR("%02X "), currentPacket->packet[i]);
+    Serial.printf("Switching to next packet, %d packets in queue\n", queue.size());
+#endif
+
+    if (!packet->dequeued) {
+      packet->dequeued = true;
+      CommandLatency::record(packet->stamp, LatencyStage::DEQUEUE);
+    }
+
+    activePackets[numActivePackets] = packet;
+    repeatsRemaining[numActivePackets] = packet->repeatsOverride > 0
+      ? packet->repeatsOverride
+      : settings.packetRepeats;
+    ++numActivePackets;
+
+    // Adjust resend count according to throttling rules
+    updateResendCount();
   }
-  Serial.println();
+}
+
+void PacketSender::sendActiveRepeats() {
+  size_t budget = settings.packetRepeatsPerLoop;
+
+#ifdef DEBUG_PRINTF
+  Serial.printf_P(PSTR("Sending repeats of %d packets\n"), numActivePackets);
   int iStart = millis();
 #endif
 
-  for (size_t i = 0; i < num; ++i) {
-    radioSwitchboard.write(currentPacket->packet, len);
+  // One repeat of each packet at a time, so every packet gets its first
+  // repeat out early.  Uses the same air time as sending them back to back.
+  while (budget > 0 && numActivePackets > 0) {
+    if (nextActiveIx >= numActivePackets) {
+      nextActiveIx = 0;
+    }
+
+    QueuedPacket& packet = *activePackets[nextActiveIx];
+    const size_t packetLength = packet.remoteConfig->packetFormatter->getPacketLength();
+
+    // Always switch radio.  could've been listening in another context
+    radioSwitchboard.switchRadio(packet.remoteConfig);
+    radioSwitchboard.write(packet.packet, packetLength);
+    rememberSent(packet, packetLength);
+
+    if (!packet.transmitted) {
+      packet.transmitted = true;
+      CommandLatency::record(packet.stamp, LatencyStage::FIRST_TRANSMIT);
+    }
+
+    --budget;
+
+    if (--repeatsRemaining[nextActiveIx] == 0) {
+      finishActivePacket(nextActiveIx);
+    } else {
+      ++nextActiveIx;
+    }
   }
 
 #ifdef DEBUG_PRINTF
@@ -107,6 +167,96 @@ void PacketSender::sendRepeats(size_t num) {
 #endif
 }
 
+void PacketSender::finishActivePacket(size_t ix) {
+  std::shared_ptr<QueuedPacket> packet = activePackets[ix];
+
+  // Keep the rest in the order they were started
+  for (size_t i = ix + 1; i < numActivePackets; i++) {
+    activePackets[i - 1] = activePackets[i];
+    repeatsRemaining[i - 1] = repeatsRemaining[i];
+  }
+
+  --numActivePackets;
+  activePackets[numActivePackets] = nullptr;
+
+  CommandLatency::record(packet->stamp, LatencyStage::SENT);
+
+  // If we're done sending this packet, fire the sent packet callback
+  if (packetSentHandler != nullptr) {
+    packetSentHandler(packet->packet, *packet->remoteConfig);
+  }
+}
+
+void PacketSender::rememberSent(const QueuedPacket& packet, size_t length) {
+  const MiLightRadioConfig* radioConfig = &packet.remoteConfig->radioConfig;
+  const bool listened = radioSwitchboard.listenConfig() == radioConfig;
+  const unsigned long now = millis();
+
+  for (size_t i = 0; i < MILIGHT_MAX_RECENT_PACKETS; i++) {
+    RecentPacket& recent = recentPackets[i];
+
+    if (recent.radioConfig == radioConfig
+      && recent.length == length
+      && now - recent.sentAt <= MILIGHT_ECHO_WINDOW
+      && memcmp(recent.packet, packet.packet, length) == 0) {
+      recent.sentAt = now;
+
+      if (listened && recent.framesListened < UINT8_MAX) {
+        ++recent.framesListened;
+      }
+
+      return;
+    }
+  }
+
+  RecentPacket& recent = recentPackets[nextRecentIx];
+  nextRecentIx = (nextRecentIx + 1) % MILIGHT_MAX_RECENT_PACKETS;
+  retireRecent(recent);
+
+  recent.radioConfig = radioConfig;
+  recent.length = std::min(length, static_cast<size_t>(MILIGHT_MAX_PACKET_LENGTH));
+  memcpy(recent.packet, packet.packet, recent.length);
+  recent.sentAt = now;
+  recent.framesListened = listened ? 1 : 0;
+  recent.heard = false;
+}
+
+void PacketSender::retireRecent(const RecentPacket& recent) {
+  if (recent.radioConfig != NULL && recent.framesListened > 0) {
+    adaptiveRepeats.observe(*recent.radioConfig, recent.heard, recent.framesListened);
+  }
+}
+
+bool PacketSender::isEcho(const MiLightRadioConfig& radioConfig, const uint8_t* packet, size_t length) {
+  const unsigned long now = millis();
+
+  for (size_t i = 0; i < MILIGHT_MAX_RECENT_PACKETS; i++) {
+    RecentPacket& recent = recentPackets[i];
+
+    if (recent.radioConfig == &radioConfig
+      && recent.length == length
+      && now - recent.sentAt <= MILIGHT_ECHO_WINDOW
+      && memcmp(recent.packet, packet, length) == 0) {
+      recent.heard = true;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+size_t PacketSender::queueLength() const {
+  return queue.size();
+}
+
+size_t PacketSender::droppedPackets() const {
+  return queue.getDroppedPacketCount();
+}
+
+AdaptiveRepeats& PacketSender::getAdaptiveRepeats() {
+  return adaptiveRepeats;
+}
+
 void PacketSender::updateResendCount() {
   unsigned long now = millis();
   long millisSinceLastSend = now - lastSend;
@@ -1,10 +1,22 @@
 #pragma once
 
+#include <AdaptiveRepeats.h>
 #include <MiLightRadioFactory.h>
 #include <MiLightRemoteConfig.h>
 #include <PacketQueue.h>
 #include <RadioSwitchboard.h>
 
+// How long after sending a packet a listen radio hearing it is taken to be
+// hearing us rather than a remote, in milliseconds
+#ifndef MILIGHT_ECHO_WINDOW
+#define MILIGHT_ECHO_WINDOW 300
+#endif
+
+// Sent packets remembered for echo checks
+#ifndef MILIGHT_MAX_RECENT_PACKETS
+#define MILIGHT_MAX_RECENT_PACKETS 8
+#endif
+
 class PacketSender {
 public:
   typedef std::function<void(uint8_t* packet, const MiLightRemoteConfig& config)> PacketSentHandler;
@@ -16,7 +28,13 @@ public:
     PacketSentHandler packetSentHandler
   );
 
-  void enqueue(uint8_t* packet, const MiLightRemoteConfig* remoteConfig, const size_t repeatsOverride = 0);
+  void enqueue(
+    uint8_t* packet,
+    const MiLightRemoteConfig* remoteConfig,
+    const size_t repeatsOverride = 0,
+    const int32_t deviceId = QueuedPacket::UNKNOWN_DEVICE,
+    const CommandStamp& stamp = CommandStamp()
+  );
   void loop();
 
   // Return true if there are queued packets
@@ -26,28 +44,72 @@ public:
   size_t queueLength() const;
   size_t droppedPackets() const;
 
+  // Learned repeat counts.  Fed by the listen loop.
+  AdaptiveRepeats& getAdaptiveRepeats();
+
+  // Picks up changes to the repeat and throttling settings
+  void reloadSettings();
+
+  // True if we sent this packet within the last MILIGHT_ECHO_WINDOW ms.  A
+  // second module listening while the first sends hears everything we send.
+  // Echoes are what adaptive repeats learns from, so they're counted here.
+  bool isEcho(const MiLightRadioConfig& radioConfig, const uint8_t* packet, size_t length);
+
+  // Takes over packets another sender hadn't finished with, including the
+  // remaining repeats of the ones it was sending.  Used on a fresh sender when
+  // the radios are rebuilt so that queued commands aren't lost.
+  void adoptPackets(PacketSender& previous);
+
 private:
   RadioSwitchboard& radioSwitchboard;
   Settings& settings;
   GroupStateStore* stateStore;
   PacketQueue queue;
+  AdaptiveRepeats adaptiveRepeats;
 
-  // The current packet we're sending and the number of repeats left
-  std::shared_ptr<QueuedPacket> currentPacket;
-  size_t packetRepeatsRemaining;
+  // Packets we're sending and the number of repeats left for each.  Holds one
+  // packet at a time unless interleavePacketRepeats is set, in which case the
+  // repeats of packets for different devices are sent round-robin.
+  std::shared_ptr<QueuedPacket> activePackets[MILIGHT_MAX_INTERLEAVED_PACKETS];
+  size_t repeatsRemaining[MILIGHT_MAX_INTERLEAVED_PACKETS];
+  size_t numActivePackets;
+  // Next active packet to send a repeat of
+  size_t nextActiveIx;
 
   // Handler called after packets are sent.  Will not be called multiple times
   // per repeat.
   PacketSentHandler packetSentHandler;
 
-  // Send a batch of repeats for the current packet
-  void handleCurrentPacket();
+  struct RecentPacket {
+    const MiLightRadioConfig* radioConfig;
+    uint8_t packet[MILIGHT_MAX_PACKET_LENGTH];
+    uint8_t length;
+    // millis() of the latest repeat
+    unsigned long sentAt;
+    // Repeats sent while the listen module was tuned to radioConfig, and
+    // whether it heard any of them
+    uint8_t framesListened;
+    bool heard;
+  };
+
+  // Ring of the packets we've sent most recently
+  RecentPacket recentPackets[MILIGHT_MAX_RECENT_PACKETS];
+  size_t nextRecentIx;
+
+  // Refreshes the packet's entry in recentPackets, or adds one
+  void rememberSent(const QueuedPacket& packet, size_t length);
+
+  // Tells adaptiveRepeats whether a packet about to be forgotten was heard
+  void retireRecent(const RecentPacket& recent);
+
+  // Pull packets off the queue while there's room to send them
+  void fillActivePackets();
 
-  // Switch to the next packet in the queue
-  void nextPacket();
+  // Send a batch of repeats across the active packets
+  void sendActiveRepeats();
 
-  // Send repeats of the current packet N times
-  void sendRepeats(size_t num);
+  // Fire the sent handler and drop an active packet
+  void finishActivePacket(size_t ix);
 
   // Used to track auto repeat limiting
   unsigned long lastSend;
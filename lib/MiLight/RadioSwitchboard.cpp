@@ -4,11 +4,27 @@ RadioSwitchboard::RadioSwitchboard(
   std::shared_ptr<MiLightRadioFactory> radioFactory,
   GroupStateStore* stateStore,
   Settings& settings
-) {
-  for (size_t i = 0; i < MiLightRadioConfig::NUM_CONFIGS; i++) {
-    std::shared_ptr<MiLightRadio> radio = radioFactory->create(MiLightRadioConfig::ALL_CONFIGS[i]);
-    radio->begin();
-    radios.push_back(radio);
+) : RadioSwitchboard(
+      std::vector<std::shared_ptr<MiLightRadioFactory>>{ radioFactory },
+      stateStore,
+      settings
+    )
+{ }
+
+RadioSwitchboard::RadioSwitchboard(
+  const std::vector<std::shared_ptr<MiLightRadioFactory>>& radioFactories,
+  GroupStateStore* stateStore,
+  Settings& settings
+) : modules(radioFactories.size())
+  , dedicatedListener(radioFactories.size() > 1 && settings.listenRepeats > 0)
+  , txModule(nullptr)
+{
+  for (size_t i = 0; i < radioFactories.size(); i++) {
+    for (size_t j = 0; j < MiLightRadioConfig::NUM_CONFIGS; j++) {
+      std::shared_ptr<MiLightRadio> radio = radioFactories[i]->create(MiLightRadioConfig::ALL_CONFIGS[j]);
+      radio->begin();
+      modules[i].radios.push_back(radio);
+    }
   }
 
   for (size_t i = 0; i < MiLightRemoteConfig::NUM_REMOTES; i++) {
@@ -16,59 +32,110 @@ RadioSwitchboard::RadioSwitchboard(
   }
 }
 
+std::shared_ptr<MiLightRadio> RadioSwitchboard::RadioModule::switchRadio(size_t configIx) {
+  if (configIx >= radios.size()) {
+    return NULL;
+  }
+
+  if (this->currentRadio != radios[configIx]) {
+    this->currentRadio = radios[configIx];
+    this->currentRadio->configure();
+  }
+
+  return this->currentRadio;
+}
+
 size_t RadioSwitchboard::getNumRadios() const {
-  return radios.size();
+  return modules.empty() ? 0 : modules.front().radios.size();
+}
+
+size_t RadioSwitchboard::getNumModules() const {
+  return modules.size();
 }
 
-std::shared_ptr<MiLightRadio> RadioSwitchboard::switchRadio(size_t radioIx) {
-  if (radioIx >= getNumRadios()) {
+bool RadioSwitchboard::canListenWhileSending() const {
+  return dedicatedListener;
+}
+
+const MiLightRadioConfig* RadioSwitchboard::listenConfig() {
+  if (! dedicatedListener || listenModule().currentRadio == nullptr) {
     return NULL;
   }
 
-  if (this->currentRadio != radios[radioIx]) {
-    this->currentRadio = radios[radioIx];
-    this->currentRadio->configure();
+  return &listenModule().currentRadio->config();
+}
+
+RadioSwitchboard::RadioModule& RadioSwitchboard::listenModule() {
+  return modules.back();
+}
+
+RadioSwitchboard::RadioModule& RadioSwitchboard::txModuleFor(size_t configIx) {
+  size_t numTxModules = dedicatedListener ? modules.size() - 1 : modules.size();
+  return modules[configIx % numTxModules];
+}
+
+int RadioSwitchboard::configIndex(const MiLightRadioConfig& config) {
+  for (size_t i = 0; i < MiLightRadioConfig::NUM_CONFIGS; i++) {
+    if (&MiLightRadioConfig::ALL_CONFIGS[i] == &config) {
+      return i;
+    }
   }
 
-  return this->currentRadio;
+  return -1;
 }
 
 std::shared_ptr<MiLightRadio> RadioSwitchboard::switchRadio(const MiLightRemoteConfig* remote) {
-  std::shared_ptr<MiLightRadio> radio = NULL;
+  int configIx = configIndex(remote->radioConfig);
 
-  for (size_t i = 0; i < radios.size(); i++) {
-    if (&this->radios[i]->config() == &remote->radioConfig) {
-      radio = switchRadio(i);
-      break;
-    }
+  if (modules.empty() || configIx == -1) {
+    return NULL;
   }
 
-  return radio;
+  this->txModule = &txModuleFor(configIx);
+  return this->txModule->switchRadio(configIx);
+}
+
+std::shared_ptr<MiLightRadio> RadioSwitchboard::switchListenRadio(size_t configIx) {
+  if (modules.empty()) {
+    return NULL;
+  }
+
+  return listenModule().switchRadio(configIx);
+}
+
+std::shared_ptr<MiLightRadio> RadioSwitchboard::switchListenRadio(const MiLightRemoteConfig* remote) {
+  int configIx = configIndex(remote->radioConfig);
+
+  if (configIx == -1) {
+    return NULL;
+  }
+
+  return switchListenRadio(configIx);
 }
 
 void RadioSwitchboard::write(uint8_t* packet, size_t len) {
-  if (this->currentRadio == nullptr) {
+  if (this->txModule == nullptr || this->txModule->currentRadio == nullptr) {
     return;
   }
 
-  this->currentRadio->write(packet, len);
+  this->txModule->currentRadio->write(packet, len);
 }
 
 size_t RadioSwitchboard::read(uint8_t* packet) {
-  if (currentRadio == nullptr) {
+  if (modules.empty() || listenModule().currentRadio == nullptr) {
     return 0;
   }
 
   size_t length;
-  currentRadio->read(packet, length);
+  listenModule().currentRadio->read(packet, length);
 
   return length;
 }
 
 bool RadioSwitchboard::available() {
-  if (currentRadio == nullptr) {
+  if (modules.empty() || listenModule().currentRadio == nullptr) {
     return false;
   }
 
-  return currentRadio->available();
-}
\ No newline at end of file
+  return listenModule().currentRadio->available();
+}
@@ -5,6 +5,16 @@
 #include <MiLightRadioConfig.h>
 #include <MiLightRadioFactory.h>
 
+/*
+ * Hands out MiLightRadios configured for a particular remote.
+ *
+ * Each physical radio module gets a MiLightRadio for every radio config.  With
+ * a single module, sending and listening take turns on it.  With more than
+ * one, the last module is dedicated to listening (when listening is enabled)
+ * and radio configs are spread over the rest, so listening carries on while
+ * packets are sent and alternating between protocols doesn't mean
+ * reconfiguring a module between every packet.
+ */
 class RadioSwitchboard {
 public:
   RadioSwitchboard(
@@ -13,15 +23,50 @@ public:
     Settings& settings
   );
 
+  RadioSwitchboard(
+    const std::vector<std::shared_ptr<MiLightRadioFactory>>& radioFactories,
+    GroupStateStore* stateStore,
+    Settings& settings
+  );
+
+  // Sending.  Switches the module that transmits for this remote.
   std::shared_ptr<MiLightRadio> switchRadio(const MiLightRemoteConfig* remote);
-  std::shared_ptr<MiLightRadio> switchRadio(size_t index);
-  size_t getNumRadios() const;
+  void write(uint8_t* packet, size_t length);
 
+  // Listening.  Index is into the radio configs.
+  std::shared_ptr<MiLightRadio> switchListenRadio(size_t index);
+  std::shared_ptr<MiLightRadio> switchListenRadio(const MiLightRemoteConfig* remote);
   bool available();
-  void write(uint8_t* packet, size_t length);
   size_t read(uint8_t* packet);
 
+  // Number of radio configs which can be listened to
+  size_t getNumRadios() const;
+  size_t getNumModules() const;
+
+  // True if a module is set aside for listening
+  bool canListenWhileSending() const;
+
+  // Radio config the listening module is tuned to while packets are sent, or
+  // NULL if nothing listens while sending
+  const MiLightRadioConfig* listenConfig();
+
 private:
-  std::vector<std::shared_ptr<MiLightRadio>> radios;
-  std::shared_ptr<MiLightRadio> currentRadio;
-};
\ No newline at end of file
+  // One physical radio module
+  struct RadioModule {
+    std::vector<std::shared_ptr<MiLightRadio>> radios;
+    std::shared_ptr<MiLightRadio> currentRadio;
+
+    std::shared_ptr<MiLightRadio> switchRadio(size_t configIx);
+  };
+
+  std::vector<RadioModule> modules;
+  bool dedicatedListener;
+  // Module most recently switched to for sending
+  RadioModule* txModule;
+
+  RadioModule& listenModule();
+  RadioModule& txModuleFor(size_t configIx);
+
+  // Position in MiLightRadioConfig::ALL_CONFIGS, or -1 if it isn't there
+  static int configIndex(const MiLightRadioConfig& config);
+};
@@ -50,7 +50,8 @@ public:
   virtual void nextMode();
   virtual void previousMode();
 
-  virtual BulbId parsePacket(const uint8_t* packet, JsonObject result);
+  using PacketFormatter::parsePacket;
+  virtual BulbId parsePacket(const uint8_t* packet, ParsedPacket& result);
 
 protected:
 
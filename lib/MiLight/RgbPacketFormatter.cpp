@@ -48,15 +48,12 @@ void RgbPacketFormatter::updateColorRaw(uint8_t value) {
 }
 
 void RgbPacketFormatter::updateBrightness(uint8_t value) {
-  const GroupState* state = this->stateStore->get(deviceId, groupId, MiLightRemoteType::REMOTE_TYPE_RGB);
-  int8_t knownValue = (state != NULL && state->isSetBrightness()) ? state->getBrightness() : -1;
-
   valueByStepFunction(
     &PacketFormatter::increaseBrightness,
     &PacketFormatter::decreaseBrightness,
     RGB_INTERVALS,
     value / RGB_INTERVALS,
-    knownValue / RGB_INTERVALS
+    findStepRange(GroupStateField::BRIGHTNESS, RGB_INTERVALS, RGB_INTERVALS)
   );
 }
 
@@ -84,7 +81,7 @@ void RgbPacketFormatter::previousMode() {
   command(RGB_MODE_DOWN, 0);
 }
 
-BulbId RgbPacketFormatter::parsePacket(const uint8_t* packet, JsonObject result) {
+BulbId RgbPacketFormatter::parsePacket(const uint8_t* packet, ParsedPacket& result) {
   uint8_t command = packet[RGB_COMMAND_INDEX] & 0x7F;
 
   BulbId bulbId(
@@ -94,27 +91,27 @@ BulbId RgbPacketFormatter::parsePacket(const uint8_t* packet, JsonObject result)
   );
 
   if (command == RGB_ON) {
-    result[GroupStateFieldNames::STATE] = "ON";
+    result.setState(ON);
   } else if (command == RGB_OFF) {
-    result[GroupStateFieldNames::STATE] = "OFF";
+    result.setState(OFF);
   } else if (command == 0) {
     uint16_t remappedColor = Units::rescale<uint16_t, uint16_t>(packet[RGB_COLOR_INDEX], 360.0, 255.0);
     remappedColor = (remappedColor + 320) % 360;
-    result[GroupStateFieldNames::HUE] = remappedColor;
+    result.setHue(remappedColor);
   } else if (command == RGB_MODE_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::PREVIOUS_MODE;
+    result.setCommand(MiLightCommandNames::PREVIOUS_MODE);
   } else if (command == RGB_MODE_UP) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::NEXT_MODE;
+    result.setCommand(MiLightCommandNames::NEXT_MODE);
   } else if (command == RGB_SPEED_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_DOWN;
+    result.setCommand(MiLightCommandNames::MODE_SPEED_DOWN);
   } else if (command == RGB_SPEED_UP) {
-    result[GroupStateFieldNames::COMMAND] = MiLightCommandNames::MODE_SPEED_UP;
+    result.setCommand(MiLightCommandNames::MODE_SPEED_UP);
   } else if (command == RGB_BRIGHTNESS_DOWN) {
-    result[GroupStateFieldNames::COMMAND] = "brightness_down";
+    result.setCommand(MiLightCommandNames::BRIGHTNESS_DOWN);
   } else if (command == RGB_BRIGHTNESS_UP) {
-    result[GroupStateFieldNames::COMMAND] = "brightness_up";
+    result.setCommand(MiLightCommandNames::BRIGHTNESS_UP);
   } else {
-    result["button_id"] = command;
+    result.setButtonId(command);
   }
 
   return bulbId;
@@ -10,15 +10,18 @@ V2PacketFormatter::V2PacketFormatter(const MiLightRemoteType deviceType, uint8_t
 { }
 
 bool V2PacketFormatter::canHandle(const uint8_t *packet, const size_t packetLen) {
-  uint8_t packetCopy[V2_PACKET_LEN];
-  memcpy(packetCopy, packet, V2_PACKET_LEN);
-  V2RFEncoding::decodeV2Packet(packetCopy);
+  // Only the protocol ID matters here, so don't decode the whole packet
+  const uint8_t packetProtocolId = V2RFEncoding::decodeV2Byte(packet, V2_PROTOCOL_ID_INDEX);
 
 #ifdef DEBUG_PRINTF
-  Serial.printf_P(PSTR("Testing whether formater for ID %d can handle packet: with protocol ID %d...\n"), protocolId, packetCopy[V2_PROTOCOL_ID_INDEX]);
+  Serial.printf_P(PSTR("Testing whether formater for ID %d can handle packet: with protocol ID %d...\n"), protocolId, packetProtocolId);
 #endif
 
-  return packetCopy[V2_PROTOCOL_ID_INDEX] == protocolId;
+  return packetProtocolId == protocolId;
+}
+
+uint8_t V2PacketFormatter::getProtocolId() const {
+  return protocolId;
 }
 
 void V2PacketFormatter::initializePacket(uint8_t* packet) {
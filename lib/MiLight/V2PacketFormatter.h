@@ -28,6 +28,7 @@ public:
   virtual void finalizePacket(uint8_t* packet);
 
   uint8_t groupCommandArg(MiLightStatus status, uint8_t groupId);
+  uint8_t getProtocolId() const;
 
   /*
    * Some protocols have scales which have the following characteristics:
@@ -53,6 +53,10 @@ void V2RFEncoding::decodeV2Packet(uint8_t *packet) {
   }
 }
 
+uint8_t V2RFEncoding::decodeV2Byte(const uint8_t* packet, size_t index) {
+  return decodeByte(packet[index], 0, xorKey(packet[0]), V2_OFFSET(index, packet[0], V2_OFFSET_JUMP_START));
+}
+
 void V2RFEncoding::encodeV2Packet(uint8_t *packet) {
   uint8_t key = xorKey(packet[0]);
   uint8_t sum = key;
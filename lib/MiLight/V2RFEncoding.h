@@ -10,6 +10,8 @@ class V2RFEncoding {
 public:
   static void encodeV2Packet(uint8_t* packet);
   static void decodeV2Packet(uint8_t* packet);
+  // Decodes one byte (1-8) of a packet without touching the rest
+  static uint8_t decodeV2Byte(const uint8_t* packet, size_t index);
   static uint8_t xorKey(uint8_t key);
   static uint8_t encodeByte(uint8_t byte, uint8_t s1, uint8_t xorKey, uint8_t s2);
   static uint8_t decodeByte(uint8_t byte, uint8_t s1, uint8_t xorKey, uint8_t s2);
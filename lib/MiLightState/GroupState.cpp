@@ -1,7 +1,7 @@
 #include <GroupState.h>
 #include <Units.h>
 #include <MiLightRemoteConfig.h>
-#include <RGBConverter.h>
+#include <ColorConverter.h>
 #include <BulbId.h>
 #include <MiLightCommands.h>
 
@@ -32,6 +32,43 @@ static const GroupStateField ALL_SCRATCH_FIELDS[] = {
 // Number of units each increment command counts for
 static const uint8_t INCREMENT_COMMAND_VALUE = 10;
 
+// Fields GroupState::patch(JsonObject) reads.  Indexes into PATCH_FIELD_NAMES.
+enum PatchField {
+  PATCH_STATE = 0,
+  PATCH_BRIGHTNESS,
+  PATCH_HUE,
+  PATCH_SATURATION,
+  PATCH_MODE,
+  PATCH_COLOR_TEMP,
+  PATCH_COMMAND,
+  NUM_PATCH_FIELDS
+};
+
+static constexpr const char* PATCH_FIELD_NAMES[] = {
+  GroupStateFieldNames::STATE,
+  GroupStateFieldNames::BRIGHTNESS,
+  GroupStateFieldNames::HUE,
+  GroupStateFieldNames::SATURATION,
+  GroupStateFieldNames::MODE,
+  GroupStateFieldNames::COLOR_TEMP,
+  GroupStateFieldNames::COMMAND
+};
+
+static_assert(
+  sizeof(PATCH_FIELD_NAMES) / sizeof(PATCH_FIELD_NAMES[0]) == NUM_PATCH_FIELDS,
+  "Every PatchField needs a name"
+);
+
+// Keys are found through a perfect hash, see GroupStateFieldHash
+static_assert(! GroupStateFieldHash::slotsCollide(PATCH_FIELD_NAMES), "Patch field names collide.  Pick a different GroupStateFieldHash::SEED.");
+
+static constexpr GroupStateFieldHash::SlotTable PATCH_FIELD_SLOTS = GroupStateFieldHash::slotTable(PATCH_FIELD_NAMES);
+
+// Returns the PatchField for a key, or -1 if patch() ignores it
+static int8_t findPatchField(const char* name) {
+  return GroupStateFieldHash::find(PATCH_FIELD_NAMES, PATCH_FIELD_SLOTS, name);
+}
+
 static const GroupState DEFAULT_STATE = GroupState();
 static const GroupState DEFAULT_RGB_ONLY_STATE = GroupState::initDefaultRgbState();
 static const GroupState DEFAULT_WHITE_ONLY_STATE = GroupState::initDefaultWhiteState();
@@ -90,10 +127,14 @@ void GroupState::initFields() {
   state.fields._isSetNightMode       = 0;
   state.fields._isNightMode          = 0;
 
-  scratchpad.fields._isSetBrightnessScratch = 0;
-  scratchpad.fields._brightnessScratch      = 0;
-  scratchpad.fields._isSetKelvinScratch     = 0;
-  scratchpad.fields._kelvinScratch          = 0;
+  scratchpad.fields._isSetBrightnessScratch   = 0;
+  scratchpad.fields._brightnessScratch        = 0;
+  scratchpad.fields._isSetKelvinScratch       = 0;
+  scratchpad.fields._kelvinScratch            = 0;
+  scratchpad.fields._kelvinScratchIsUpper     = 0;
+  scratchpad.fields._brightnessScratchIsUpper = 0;
+  scratchpad.fields._kelvinStepped            = 0;
+  scratchpad.fields._brightnessStepped        = 0;
 }
 
 GroupState& GroupState::operator=(const GroupState& other) {
@@ -119,14 +160,18 @@ GroupState::GroupState(const GroupState* previousState, JsonObject jsonState)
   : previousState(previousState)
 {
   initFields();
-
-  if (previousState != NULL) {
-    this->scratchpad = previousState->scratchpad;
-  }
-
+  inheritScratchpad();
   patch(jsonState);
 }
 
+GroupState::GroupState(const GroupState* previousState, const ParsedPacket& packet)
+  : previousState(previousState)
+{
+  initFields();
+  inheritScratchpad();
+  patch(packet);
+}
+
 bool GroupState::operator==(const GroupState& other) const {
   return memcmp(state.rawData, other.state.rawData, DATA_LONGS * sizeof(uint32_t)) == 0;
 }
@@ -368,6 +413,78 @@ void GroupState::setScratchFieldValue(GroupStateField field, uint16_t value) {
   }
 }
 
+bool GroupState::isScratchFieldUpperBound(GroupStateField field) const {
+  switch (field) {
+    case GroupStateField::BRIGHTNESS:
+      return scratchpad.fields._brightnessScratchIsUpper;
+    case GroupStateField::KELVIN:
+      return scratchpad.fields._kelvinScratchIsUpper;
+    default:
+      return false;
+  }
+}
+
+void GroupState::clearScratchField(GroupStateField field) {
+  switch (field) {
+    case GroupStateField::BRIGHTNESS:
+      scratchpad.fields._isSetBrightnessScratch = 0;
+      scratchpad.fields._brightnessScratch = 0;
+      scratchpad.fields._brightnessScratchIsUpper = 0;
+      break;
+    case GroupStateField::KELVIN:
+      scratchpad.fields._isSetKelvinScratch = 0;
+      scratchpad.fields._kelvinScratch = 0;
+      scratchpad.fields._kelvinScratchIsUpper = 0;
+      break;
+    default:
+      Serial.print(F("WARNING: tried to clear unknown scratch field: "));
+      Serial.println(static_cast<unsigned int>(field));
+      break;
+  }
+}
+
+bool GroupState::isSteppedField(GroupStateField field) const {
+  switch (field) {
+    case GroupStateField::BRIGHTNESS:
+      return scratchpad.fields._brightnessStepped;
+    case GroupStateField::KELVIN:
+      return scratchpad.fields._kelvinStepped;
+    default:
+      return false;
+  }
+}
+
+void GroupState::invalidateScratchFields(const GroupState& other) {
+  for (size_t i = 0; i < size(ALL_SCRATCH_FIELDS); ++i) {
+    if (other.isSteppedField(ALL_SCRATCH_FIELDS[i])) {
+      clearScratchField(ALL_SCRATCH_FIELDS[i]);
+    }
+  }
+}
+
+void GroupState::inheritScratchpad() {
+  if (previousState != NULL) {
+    this->scratchpad = previousState->scratchpad;
+    scratchpad.fields._kelvinStepped = 0;
+    scratchpad.fields._brightnessStepped = 0;
+  }
+}
+
+void GroupState::copyScratchField(const GroupState& other, GroupStateField field) {
+  if (! other.isSetScratchField(field)) {
+    clearScratchField(field);
+    return;
+  }
+
+  setScratchFieldValue(field, other.getScratchFieldValue(field));
+
+  if (field == GroupStateField::BRIGHTNESS) {
+    scratchpad.fields._brightnessScratchIsUpper = other.scratchpad.fields._brightnessScratchIsUpper;
+  } else {
+    scratchpad.fields._kelvinScratchIsUpper = other.scratchpad.fields._kelvinScratchIsUpper;
+  }
+}
+
 bool GroupState::isSetState() const { return state.fields._isSetState; }
 MiLightStatus GroupState::getState() const { return state.fields._state ? ON : OFF; }
 bool GroupState::isOn() const {
@@ -622,6 +739,17 @@ void GroupState::dump(Stream& stream) const {
   }
 }
 
+void GroupState::load(const uint8_t* buffer) {
+  static_assert(DUMP_SIZE == sizeof(state.rawData), "DUMP_SIZE must match persisted state");
+
+  memcpy(state.rawData, buffer, DUMP_SIZE);
+  clearDirty();
+}
+
+void GroupState::dump(uint8_t* buffer) const {
+  memcpy(buffer, state.rawData, DUMP_SIZE);
+}
+
 bool GroupState::applyIncrementCommand(GroupStateField field, IncrementDirection dir) {
   if (field != GroupStateField::KELVIN && field != GroupStateField::BRIGHTNESS) {
     Serial.print(F("WARNING: tried to apply increment for unsupported field: "));
@@ -631,6 +759,12 @@ bool GroupState::applyIncrementCommand(GroupStateField field, IncrementDirection
 
   int8_t dirValue = static_cast<int8_t>(dir);
 
+  if (field == GroupStateField::BRIGHTNESS) {
+    scratchpad.fields._brightnessStepped = 1;
+  } else {
+    scratchpad.fields._kelvinStepped = 1;
+  }
+
   // If there's already a known value, update it
   if (previousState != NULL && previousState->isSetField(field)) {
     int8_t currentValue = static_cast<int8_t>(previousState->getFieldValue(field));
@@ -655,10 +789,18 @@ bool GroupState::applyIncrementCommand(GroupStateField field, IncrementDirection
       } else {
         setScratchFieldValue(field, newValue);
       }
-    } else if (dir == IncrementDirection::DECREASE) {
-      setScratchFieldValue(field, 9);
     } else {
-      setScratchFieldValue(field, 1);
+      const bool isDecrease = dir == IncrementDirection::DECREASE;
+
+      setScratchFieldValue(field, isDecrease ? 9 : 1);
+
+      // Decreasing from an unknown value assumes we started at the max, so
+      // the real value can only be lower than the scratch value.
+      if (field == GroupStateField::BRIGHTNESS) {
+        scratchpad.fields._brightnessScratchIsUpper = isDecrease;
+      } else {
+        scratchpad.fields._kelvinScratchIsUpper = isDecrease;
+      }
     }
 
 #ifdef STATE_DEBUG
@@ -722,11 +864,53 @@ void GroupState::patch(const GroupState& other) {
   for (size_t i = 0; i < size(ALL_SCRATCH_FIELDS); ++i) {
     GroupStateField field = ALL_SCRATCH_FIELDS[i];
 
-    // All scratch field updates require that the bulb is on.
-    if (isOn() && other.isSetScratchField(field)) {
-      setScratchFieldValue(field, other.getScratchFieldValue(field));
+    // Only steps are copied, since other's scratch may be older than ours.
+    // Bulbs that are off ignore steps.
+    if (isOn() && other.isSteppedField(field)) {
+      copyScratchField(other, field);
+    }
+  }
+}
+
+bool GroupState::patch(JsonObject state) {
+#ifdef STATE_DEBUG
+  Serial.print(F("Patching existing state with: "));
+  serializeJson(state, Serial);
+  Serial.println();
+#endif
+
+  // Pick out the fields we care about in a single pass
+  ParsedPacket packet;
+
+  for (JsonPair kv : state) {
+    JsonVariant value = kv.value();
+
+    switch (findPatchField(kv.key().c_str())) {
+      case PATCH_STATE:
+        packet.setState(value == "ON" ? ON : OFF);
+        break;
+      case PATCH_BRIGHTNESS:
+        packet.setBrightness(value.as<uint8_t>());
+        break;
+      case PATCH_HUE:
+        packet.setHue(value.as<uint16_t>());
+        break;
+      case PATCH_SATURATION:
+        packet.setSaturation(value.as<uint8_t>());
+        break;
+      case PATCH_MODE:
+        packet.setMode(value.as<uint8_t>());
+        break;
+      case PATCH_COLOR_TEMP:
+        packet.setColorTemp(value.as<uint16_t>());
+        break;
+      case PATCH_COMMAND:
+        packet.setCommand(value.as<const char*>());
+        break;
     }
   }
+
+  return patch(packet);
 }
 
 /*
@@ -737,58 +921,54 @@ void GroupState::patch(const GroupState& other) {
 
   Returns true if the packet changes affects a state change
 */
-bool GroupState::patch(JsonObject state) {
+bool GroupState::patch(const ParsedPacket& packet) {
   bool changes = false;
 
-#ifdef STATE_DEBUG
-  Serial.print(F("Patching existing state with: "));
-  serializeJson(state, Serial);
-  Serial.println();
-#endif
-
-  if (state.containsKey(GroupStateFieldNames::STATE)) {
-    bool stateChange = setState(state[GroupStateFieldNames::STATE] == "ON" ? ON : OFF);
+  // Fields are applied in a fixed order, state first, regardless of the order
+  // they came in
+  if (packet.has(ParsedPacketField::STATE)) {
+    bool stateChange = setState(packet.state);
     changes |= stateChange;
   }
 
   // Devices do not support changing their state while off, so don't apply state
   // changes to devices we know are off.
 
-  if (isOn() && state.containsKey(GroupStateFieldNames::BRIGHTNESS)) {
-    bool stateChange = setBrightness(Units::rescale(state[GroupStateFieldNames::BRIGHTNESS].as<uint8_t>(), 100, 255));
+  if (isOn() && packet.has(ParsedPacketField::BRIGHTNESS)) {
+    bool stateChange = setBrightness(Units::rescale(packet.brightness, 100, 255));
     changes |= stateChange;
   }
-  if (isOn() && state.containsKey(GroupStateFieldNames::HUE)) {
-    changes |= setHue(state[GroupStateFieldNames::HUE]);
+  if (isOn() && packet.has(ParsedPacketField::HUE)) {
+    changes |= setHue(packet.hue);
     changes |= setBulbMode(BULB_MODE_COLOR);
   }
-  if (isOn() && state.containsKey(GroupStateFieldNames::SATURATION)) {
-    changes |= setSaturation(state[GroupStateFieldNames::SATURATION]);
+  if (isOn() && packet.has(ParsedPacketField::SATURATION)) {
+    changes |= setSaturation(packet.saturation);
   }
-  if (isOn() && state.containsKey(GroupStateFieldNames::MODE)) {
-    changes |= setMode(state[GroupStateFieldNames::MODE]);
+  if (isOn() && packet.has(ParsedPacketField::MODE)) {
+    changes |= setMode(packet.mode);
     changes |= setBulbMode(BULB_MODE_SCENE);
   }
-  if (isOn() && state.containsKey(GroupStateFieldNames::COLOR_TEMP)) {
-    changes |= setMireds(state[GroupStateFieldNames::COLOR_TEMP]);
+  if (isOn() && packet.has(ParsedPacketField::COLOR_TEMP)) {
+    changes |= setMireds(packet.colorTemp);
     changes |= setBulbMode(BULB_MODE_WHITE);
   }
 
-  if (state.containsKey(GroupStateFieldNames::COMMAND)) {
-    const String& command = state[GroupStateFieldNames::COMMAND];
+  if (packet.has(ParsedPacketField::COMMAND) && packet.command != NULL) {
+    const char* command = packet.command;
 
-    if (isOn() && command == MiLightCommandNames::SET_WHITE) {
+    if (isOn() && strcmp(command, MiLightCommandNames::SET_WHITE) == 0) {
       changes |= setBulbMode(BULB_MODE_WHITE);
-    } else if (command == MiLightCommandNames::NIGHT_MODE) {
+    } else if (strcmp(command, MiLightCommandNames::NIGHT_MODE) == 0) {
       changes |= setBulbMode(BULB_MODE_NIGHT);
-    } else if (isOn() && command == "brightness_up") {
+    } else if (isOn() && strcmp(command, MiLightCommandNames::BRIGHTNESS_UP) == 0) {
       changes |= applyIncrementCommand(GroupStateField::BRIGHTNESS, IncrementDirection::INCREASE);
-    } else if (isOn() && command == "brightness_down") {
+    } else if (isOn() && strcmp(command, MiLightCommandNames::BRIGHTNESS_DOWN) == 0) {
       changes |= applyIncrementCommand(GroupStateField::BRIGHTNESS, IncrementDirection::DECREASE);
-    } else if (isOn() && command == MiLightCommandNames::TEMPERATURE_UP) {
+    } else if (isOn() && strcmp(command, MiLightCommandNames::TEMPERATURE_UP) == 0) {
       changes |= applyIncrementCommand(GroupStateField::KELVIN, IncrementDirection::INCREASE);
       changes |= setBulbMode(BULB_MODE_WHITE);
-    } else if (isOn() && command == MiLightCommandNames::TEMPERATURE_DOWN) {
+    } else if (isOn() && strcmp(command, MiLightCommandNames::TEMPERATURE_DOWN) == 0) {
       changes |= applyIncrementCommand(GroupStateField::KELVIN, IncrementDirection::DECREASE);
       changes |= setBulbMode(BULB_MODE_WHITE);
     }
@@ -984,17 +1164,11 @@ bool GroupState::isSetColor() const {
 
 ParsedColor GroupState::getColor() const {
   uint8_t rgb[3];
-  RGBConverter converter;
   uint16_t hue = getHue();
+  // Default to fully saturated
   uint8_t sat = isSetSaturation() ? getSaturation() : 100;
 
-  converter.hsvToRgb(
-    hue / 360.0,
-    // Default to fully saturated
-    sat / 100.0,
-    1,
-    rgb
-  );
+  ColorConverter::hsvToRgb(hue, sat, rgb);
 
   return {
     .success = true,
@@ -4,6 +4,7 @@
 #include <MiLightStatus.h>
 #include <MiLightRadioConfig.h>
 #include <GroupStateField.h>
+#include <ParsedPacket.h>
 #include <ArduinoJson.h>
 #include <BulbId.h>
 #include <ParsedColor.h>
@@ -37,6 +38,7 @@ public:
   // Convenience constructor that patches transient state from a previous GroupState,
   // and defaults with JSON state
   GroupState(const GroupState* previousState, JsonObject jsonState);
+  GroupState(const GroupState* previousState, const ParsedPacket& packet);
 
   void initFields();
 
@@ -53,6 +55,17 @@ public:
   bool isSetScratchField(GroupStateField field) const;
   uint16_t getScratchFieldValue(GroupStateField field) const;
   void setScratchFieldValue(GroupStateField field, uint16_t value);
+  // Scratch values start from an assumed extreme, so they bound the real
+  // value on one side.  True if the real value is at most the scratch value.
+  bool isScratchFieldUpperBound(GroupStateField field) const;
+  void clearScratchField(GroupStateField field);
+  // True if an increment command for the field was applied to this state, as
+  // opposed to the state it was built on
+  bool isSteppedField(GroupStateField field) const;
+  // Drops scratch for the fields other was stepped on.  Used on group 0 when
+  // its groups stop moving together, since its scratch no longer describes
+  // every bulb.
+  void invalidateScratchFields(const GroupState& other);
 
   // 1 bit
   bool isSetState() const;
@@ -119,6 +132,9 @@ public:
   // true if there were any changes.
   bool patch(JsonObject state);
 
+  // Same, with fields decoded directly from a packet
+  bool patch(const ParsedPacket& packet);
+
   // It's a little weird to need to pass in a BulbId here.  The purpose is to
   // support fields like DEVICE_ID, which aren't otherweise available to the
   // state in this class.  The alternative is to have every GroupState object
@@ -151,6 +167,11 @@ public:
   void load(Stream& stream);
   void dump(Stream& stream) const;
 
+  // Same as above, for callers batching several states into one buffer
+  static const size_t DUMP_SIZE = 8;
+  void load(const uint8_t* buffer);
+  void dump(uint8_t* buffer) const;
+
   void debugState(char const *debugMessage) const;
 
   static const GroupState& defaultState(MiLightRemoteType remoteType);
@@ -193,13 +214,17 @@ private:
   // Transient scratchpad that is never persisted.  Used to track and compute state for
   // protocols that only have increment commands (like CCT).
   union TransientData {
-    uint16_t rawData;
+    uint32_t rawData;
     struct Fields {
-      uint16_t
-        _isSetKelvinScratch     : 1,
-        _kelvinScratch          : 7,
-        _isSetBrightnessScratch : 1,
-        _brightnessScratch      : 8;
+      uint32_t
+        _isSetKelvinScratch       : 1,
+        _kelvinScratch            : 7,
+        _isSetBrightnessScratch   : 1,
+        _brightnessScratch        : 8,
+        _kelvinScratchIsUpper     : 1,
+        _brightnessScratchIsUpper : 1,
+        _kelvinStepped            : 1,
+        _brightnessStepped        : 1;
     } fields;
   };
 
@@ -212,6 +237,10 @@ private:
   // it here.
   const GroupState* previousState;
 
+  // Starts from the previous state's scratch, without its stepped flags
+  void inheritScratchpad();
+  void copyScratchField(const GroupState& other, GroupStateField field);
+
   void applyColor(JsonObject state, uint8_t r, uint8_t g, uint8_t b) const;
   void applyColor(JsonObject state) const;
   // Apply OpenHAB-style color, e.g., {"color":"0,0,0"}
@@ -0,0 +1,98 @@
+#include <GroupStateSnapshot.h>
+#include <FS.h>
+#include <memory>
+
+static const uint8_t SNAPSHOT_MAGIC[] = { 'G', 'S' };
+static const size_t HEADER_SIZE = 4;
+static const size_t ENTRY_SIZE = 4 + GroupState::DUMP_SIZE;
+
+size_t GroupStateSnapshot::save(GroupStateCache& cache, size_t maxEntries) {
+  maxEntries = std::min(maxEntries, static_cast<size_t>(UINT8_MAX));
+
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[HEADER_SIZE + maxEntries * ENTRY_SIZE]);
+  uint8_t* entry = buffer.get() + HEADER_SIZE;
+  size_t count = 0;
+
+  for (ListNode<GroupCacheNode*>* node = cache.getHead(); node != NULL && count < maxEntries; node = node->next) {
+    const BulbId& id = node->data->id;
+
+    entry[0] = id.deviceId & 0xFF;
+    entry[1] = id.deviceId >> 8;
+    entry[2] = id.groupId;
+    entry[3] = id.deviceType;
+    node->data->state.dump(entry + 4);
+
+    entry += ENTRY_SIZE;
+    ++count;
+  }
+
+  buffer[0] = SNAPSHOT_MAGIC[0];
+  buffer[1] = SNAPSHOT_MAGIC[1];
+  buffer[2] = VERSION;
+  buffer[3] = count;
+
+  File f = SPIFFS.open(GROUP_STATE_SNAPSHOT_FILE, "w");
+
+  if (!f) {
+    Serial.println(F("ERROR: could not open group state snapshot for writing"));
+    return 0;
+  }
+
+  f.write(buffer.get(), HEADER_SIZE + count * ENTRY_SIZE);
+  f.close();
+
+  return count;
+}
+
+size_t GroupStateSnapshot::load(GroupStateCache& cache) {
+  if (!SPIFFS.exists(GROUP_STATE_SNAPSHOT_FILE)) {
+    return 0;
+  }
+
+  File f = SPIFFS.open(GROUP_STATE_SNAPSHOT_FILE, "r");
+  const size_t fileSize = f.size();
+
+  if (fileSize < HEADER_SIZE || fileSize > HEADER_SIZE + UINT8_MAX * ENTRY_SIZE) {
+    f.close();
+    return 0;
+  }
+
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[fileSize]);
+  const size_t bytesRead = f.read(buffer.get(), fileSize);
+  f.close();
+
+  const size_t count = buffer[3];
+
+  if (bytesRead != fileSize
+    || buffer[0] != SNAPSHOT_MAGIC[0]
+    || buffer[1] != SNAPSHOT_MAGIC[1]
+    || buffer[2] != VERSION
+    || fileSize != HEADER_SIZE + count * ENTRY_SIZE) {
+    Serial.println(F("WARNING: ignoring unreadable group state snapshot"));
+    return 0;
+  }
+
+  // The cache pushes new entries to the front, so go from least to most
+  // recently used
+  GroupState state;
+
+  for (size_t i = count; i > 0; i--) {
+    const uint8_t* entry = buffer.get() + HEADER_SIZE + (i - 1) * ENTRY_SIZE;
+    BulbId id(
+      entry[0] | (entry[1] << 8),
+      entry[2],
+      static_cast<MiLightRemoteType>(entry[3])
+    );
+
+    state.load(entry + 4);
+    cache.set(id, state);
+  }
+
+  return count;
+}
+
+void GroupStateSnapshot::clear() {
+  if (SPIFFS.exists(GROUP_STATE_SNAPSHOT_FILE)) {
+    SPIFFS.remove(GROUP_STATE_SNAPSHOT_FILE);
+  }
+}
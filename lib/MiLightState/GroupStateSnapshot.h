@@ -0,0 +1,37 @@
+#include <GroupState.h>
+#include <GroupStateCache.h>
+
+#ifndef _GROUP_STATE_SNAPSHOT_H
+#define _GROUP_STATE_SNAPSHOT_H
+
+#define GROUP_STATE_SNAPSHOT_FILE "/group_states.snapshot"
+
+// Number of most recently used states kept in the snapshot
+#ifndef MILIGHT_STATE_SNAPSHOT_SIZE
+#define MILIGHT_STATE_SNAPSHOT_SIZE 32
+#endif
+
+/*
+ * The most recently used entries of a GroupStateCache, in a single file.  Lets
+ * the cache start warm after a reboot without opening a file per bulb.
+ *
+ * Format is a 4 byte header ('G', 'S', version, count) followed by count
+ * entries, most recently used first:
+ *
+ *    deviceId (2, little endian) | groupId (1) | deviceType (1) | state (8)
+ */
+class GroupStateSnapshot {
+public:
+  static const uint8_t VERSION = 1;
+
+  // Returns the number of states written
+  size_t save(GroupStateCache& cache, size_t maxEntries);
+
+  // Adds the snapshot's states to the cache, keeping their LRU order.  Returns
+  // the number of states loaded.
+  size_t load(GroupStateCache& cache);
+
+  void clear();
+};
+
+#endif
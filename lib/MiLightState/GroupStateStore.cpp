@@ -4,7 +4,9 @@
 GroupStateStore::GroupStateStore(const size_t maxSize, const size_t flushRate)
   : cache(GroupStateCache(maxSize)),
     flushRate(flushRate),
-    lastFlush(0)
+    lastFlush(0),
+    lastSnapshot(0),
+    snapshotCurrent(false)
 { }
 
 GroupState* GroupStateStore::get(const BulbId& id) {
@@ -63,17 +65,28 @@ GroupState* GroupStateStore::set(const BulbId &id, const GroupState& state) {
     state.debugState("group 0 state = ");
 #endif
 
+    bool allOn = true;
+
     for (size_t i = 1; i <= remote->numGroups; i++) {
       otherId.groupId = i;
 
       GroupState* individualState = get(otherId);
       individualState->patch(state);
+      allOn = allOn && individualState->isOn();
+    }
+
+    // Groups that are off ignored any steps, so group 0's count of them no
+    // longer holds for every bulb
+    if (! allOn) {
+      get(id)->invalidateScratchFields(state);
     }
   } else {
     otherId.groupId = 0;
     GroupState* group0State = get(otherId);
 
     group0State->clearNonMatchingFields(state);
+    // This group's bulbs have moved without the others
+    group0State->invalidateScratchFields(state);
   }
 
   return storedState;
@@ -113,6 +126,13 @@ bool GroupStateStore::flush() {
   ListNode<GroupCacheNode*>* curr = cache.getHead();
   bool anythingFlushed = false;
 
+  // Once per-bulb persistence changes, the snapshot could bring back older
+  // state after a reboot.  Drop it until the next one is taken.
+  if (snapshotCurrent && ((curr != NULL && curr->data->state.isDirty()) || evictedIds.size() > 0)) {
+    snapshot.clear();
+    snapshotCurrent = false;
+  }
+
   while (curr != NULL && curr->data->state.isDirty() && !anythingFlushed) {
     persistence.set(curr->data->id, curr->data->state);
     curr->data->state.clearDirty();
@@ -145,6 +165,38 @@ void GroupStateStore::limitedFlush() {
   if ((lastFlush + flushRate) < now) {
     if (flush()) {
       lastFlush = now;
+    } else if (!snapshotCurrent && (now - lastSnapshot) >= MILIGHT_STATE_SNAPSHOT_INTERVAL) {
+      saveSnapshot();
     }
   }
 }
+
+void GroupStateStore::setFlushRate(const size_t flushRate) {
+  this->flushRate = flushRate;
+}
+
+size_t GroupStateStore::saveSnapshot() {
+  // flush() only writes from the head of the cache, but everything in the
+  // snapshot has to be persisted or it could be lost once it's invalidated
+  for (ListNode<GroupCacheNode*>* node = cache.getHead(); node != NULL; node = node->next) {
+    if (node->data->state.isDirty()) {
+      persistence.set(node->data->id, node->data->state);
+      node->data->state.clearDirty();
+    }
+  }
+
+  while (flush()) { }
+
+  size_t saved = snapshot.save(cache, MILIGHT_STATE_SNAPSHOT_SIZE);
+  lastSnapshot = millis();
+  snapshotCurrent = true;
+
+  return saved;
+}
+
+size_t GroupStateStore::loadSnapshot() {
+  size_t loaded = snapshot.load(cache);
+  snapshotCurrent = loaded > 0;
+
+  return loaded;
+}
@@ -1,6 +1,12 @@
 #include <GroupState.h>
 #include <GroupStateCache.h>
 #include <GroupStatePersistence.h>
+#include <GroupStateSnapshot.h>
+
+// Minimum time between periodic cache snapshots (ms)
+#ifndef MILIGHT_STATE_SNAPSHOT_INTERVAL
+#define MILIGHT_STATE_SNAPSHOT_INTERVAL 300000
+#endif
 
 #ifndef _GROUP_STATE_STORE_H
 #define _GROUP_STATE_STORE_H
@@ -36,16 +42,35 @@ public:
 
   /*
    * Flushes at most one dirty state to persistent storage.  Rate limit
-   * specified by Settings.
+   * specified by Settings.  When there's nothing left to flush, refreshes the
+   * cache snapshot if it's out of date.
    */
   void limitedFlush();
 
+  void setFlushRate(const size_t flushRate);
+
+  /*
+   * Flushes everything, then writes the most recently used states to the
+   * snapshot.  Call before a clean restart.  Returns the number of states
+   * written.
+   */
+  size_t saveSnapshot();
+
+  /*
+   * Warms the cache from the snapshot.  Returns the number of states loaded.
+   */
+  size_t loadSnapshot();
+
 private:
   GroupStateCache cache;
   GroupStatePersistence persistence;
+  GroupStateSnapshot snapshot;
   LinkedList<BulbId> evictedIds;
-  const size_t flushRate;
+  size_t flushRate;
   unsigned long lastFlush;
+  unsigned long lastSnapshot;
+  // True while the snapshot on flash agrees with per-bulb persistence
+  bool snapshotCurrent;
 
   void trackEviction();
 };
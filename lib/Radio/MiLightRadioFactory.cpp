@@ -1,18 +1,60 @@
 #include <MiLightRadioFactory.h>
 
 std::shared_ptr<MiLightRadioFactory> MiLightRadioFactory::fromSettings(const Settings& settings) {
-  switch (settings.radioInterfaceType) {
+  return fromInterface(settings.radioInterfaceType, settings.csnPin, settings.cePin, settings.resetPin, settings);
+}
+
+std::vector<std::shared_ptr<MiLightRadioFactory>> MiLightRadioFactory::allFromSettings(const Settings& settings) {
+  std::vector<std::shared_ptr<MiLightRadioFactory>> factories;
+  std::shared_ptr<MiLightRadioFactory> primary = fromSettings(settings);
+
+  if (primary == NULL) {
+    return factories;
+  }
+
+  factories.push_back(primary);
+
+  if (settings.secondaryCsnPin == settings.csnPin) {
+    if (settings.secondaryRadioInterfaceType != NoRadio) {
+      Serial.println(F("ERROR: secondary radio can't share a CSN pin with the primary radio"));
+    }
+    return factories;
+  }
+
+  std::shared_ptr<MiLightRadioFactory> secondary = fromInterface(
+    settings.secondaryRadioInterfaceType,
+    settings.secondaryCsnPin,
+    settings.secondaryCePin,
+    settings.secondaryResetPin,
+    settings
+  );
+
+  if (secondary != NULL) {
+    factories.push_back(secondary);
+  }
+
+  return factories;
+}
+
+std::shared_ptr<MiLightRadioFactory> MiLightRadioFactory::fromInterface(
+  RadioInterfaceType type,
+  uint8_t csnPin,
+  uint8_t cePin,
+  uint8_t resetPin,
+  const Settings& settings
+) {
+  switch (type) {
     case nRF24:
       return std::make_shared<NRF24Factory>(
-        settings.csnPin,
-        settings.cePin,
+        csnPin,
+        cePin,
         settings.rf24PowerLevel,
         settings.rf24Channels,
         settings.rf24ListenChannel
       );
 
     case LT8900:
-      return std::make_shared<LT8900Factory>(settings.csnPin, settings.resetPin, settings.cePin);
+      return std::make_shared<LT8900Factory>(csnPin, resetPin, cePin);
 
     default:
       return NULL;
@@ -21,6 +21,19 @@ public:
 
   static std::shared_ptr<MiLightRadioFactory> fromSettings(const Settings& settings);
 
+  // One factory per physical radio module, primary first
+  static std::vector<std::shared_ptr<MiLightRadioFactory>> allFromSettings(const Settings& settings);
+
+protected:
+
+  static std::shared_ptr<MiLightRadioFactory> fromInterface(
+    RadioInterfaceType type,
+    uint8_t csnPin,
+    uint8_t cePin,
+    uint8_t resetPin,
+    const Settings& settings
+  );
+
 };
 
 class NRF24Factory : public MiLightRadioFactory {
@@ -0,0 +1,78 @@
+#include <LoopScheduler.h>
+
+LoopScheduler::LoopScheduler(uint32_t budgetMicros)
+  : budgetMicros(budgetMicros)
+{ }
+
+void LoopScheduler::addTask(LoopStage stage, LoopTaskPriority priority, uint32_t interval, TaskFn fn) {
+  tasks.push_back({ stage, priority, interval, fn, 0, 0, false });
+}
+
+bool LoopScheduler::isDue(const Task& task, unsigned long now) {
+  return task.interval == 0 || now - task.lastRun >= task.interval;
+}
+
+bool LoopScheduler::moreUrgent(const Task& a, const Task& b, unsigned long now) {
+  if (a.priority != b.priority) {
+    return a.priority < b.priority;
+  }
+  if (a.pending != b.pending) {
+    return a.pending > b.pending;
+  }
+
+  // Both are due, so neither of these goes negative
+  return (now - a.lastRun - a.interval) > (now - b.lastRun - b.interval);
+}
+
+void LoopScheduler::loop() {
+  const unsigned long start = micros();
+  const unsigned long now = millis();
+  bool overBudget = false;
+
+  for (size_t i = 0; i < tasks.size(); i++) {
+    tasks[i].ran = false;
+  }
+
+  while (true) {
+    Task* next = NULL;
+
+    for (size_t i = 0; i < tasks.size(); i++) {
+      Task& task = tasks[i];
+
+      if (task.ran || ! isDue(task, now)) {
+        continue;
+      }
+      if (overBudget && task.priority != LoopTaskPriority::CRITICAL && task.pending < MILIGHT_LOOP_MAX_DEFERRALS) {
+        continue;
+      }
+      if (next == NULL || moreUrgent(task, *next, now)) {
+        next = &task;
+      }
+    }
+
+    if (next == NULL) {
+      break;
+    }
+
+    next->fn();
+    next->lastRun = millis();
+    next->pending = 0;
+    next->ran = true;
+    LoopProfiler::endStage(next->stage);
+
+    if (micros() - start >= budgetMicros) {
+      overBudget = true;
+    }
+  }
+
+  // Whatever was due and didn't get a turn goes to the front of its priority
+  // next time
+  for (size_t i = 0; i < tasks.size(); i++) {
+    Task& task = tasks[i];
+
+    if (! task.ran && isDue(task, now)) {
+      ++task.pending;
+      LoopProfiler::deferStage(task.stage);
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#include <Arduino.h>
+#include <LoopProfiler.h>
+#include <functional>
+#include <vector>
+
+#ifndef _LOOP_SCHEDULER_H
+#define _LOOP_SCHEDULER_H
+
+// Once this much of an iteration has been used, only critical tasks and tasks
+// which have been put off too many times are started
+#ifndef MILIGHT_LOOP_BUDGET_MICROS
+#define MILIGHT_LOOP_BUDGET_MICROS 5000
+#endif
+
+// Number of iterations in a row a task can be put off before it runs anyway
+#ifndef MILIGHT_LOOP_MAX_DEFERRALS
+#define MILIGHT_LOOP_MAX_DEFERRALS 4
+#endif
+
+// Lower values are more urgent
+enum class LoopTaskPriority : uint8_t {
+  // Runs every iteration, regardless of budget
+  CRITICAL = 0,
+  URGENT,
+  NORMAL,
+  BACKGROUND
+};
+
+/*
+ * Cooperative scheduler for the main loop.  Each iteration, due tasks run in
+ * order of priority, then by how long they've been waiting.  When the
+ * iteration's budget runs out, the rest are put off until the next one, so a
+ * busy network can't hold up the radio for long.
+ */
+class LoopScheduler {
+public:
+  using TaskFn = std::function<void()>;
+
+  LoopScheduler(uint32_t budgetMicros = MILIGHT_LOOP_BUDGET_MICROS);
+
+  // A task is due once interval milliseconds have passed since it last ran.
+  // 0 makes it due every iteration.  Time spent in the task is charged to
+  // stage in LoopProfiler.
+  void addTask(LoopStage stage, LoopTaskPriority priority, uint32_t interval, TaskFn fn);
+
+  // Runs one iteration
+  void loop();
+
+private:
+  struct Task {
+    LoopStage stage;
+    LoopTaskPriority priority;
+    uint32_t interval;
+    TaskFn fn;
+    unsigned long lastRun;
+    // Iterations in a row this has been put off
+    uint8_t pending;
+    bool ran;
+  };
+
+  const uint32_t budgetMicros;
+  std::vector<Task> tasks;
+
+  static bool isDue(const Task& task, unsigned long now);
+  static bool moreUrgent(const Task& a, const Task& b, unsigned long now);
+};
+
+#endif
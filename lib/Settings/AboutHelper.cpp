@@ -2,9 +2,11 @@
 #include <ArduinoJson.h>
 #include <Settings.h>
 #include <ESP8266WiFi.h>
+#include <AllocationTracker.h>
 
 String AboutHelper::generateAboutString(bool abbreviated) {
   DynamicJsonDocument buffer(1024);
+  TRACK_ALLOCATION(ABOUT_DOCUMENT, 1024);
 
   generateAboutObject(buffer, abbreviated);
 
@@ -24,5 +26,9 @@ void AboutHelper::generateAboutObject(JsonDocument& obj, bool abbreviated) {
     obj["variant"] = QUOTE(FIRMWARE_VARIANT);
     obj["free_heap"] = ESP.getFreeHeap();
     obj["arduino_version"] = ESP.getCoreVersion();
+
+#ifdef MILIGHT_ALLOCATION_TRACKING
+    AllocationTracker::serialize(obj.createNestedObject("heap"));
+#endif
   }
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <IntParsing.h>
 #include <algorithm>
 #include <JsonHelpers.h>
+#include <AllocationTracker.h>
+#include <SettingsBlob.h>
+#include <LoopProfiler.h>
 
 #define PORT_POSITION(s) ( s.indexOf(':') )
 
@@ -73,6 +76,9 @@ void Settings::patch(JsonObject parsedSettings) {
   this->setIfPresent(parsedSettings, "csn_pin", csnPin);
   this->setIfPresent(parsedSettings, "reset_pin", resetPin);
   this->setIfPresent(parsedSettings, "led_pin", ledPin);
+  this->setIfPresent(parsedSettings, "secondary_csn_pin", secondaryCsnPin);
+  this->setIfPresent(parsedSettings, "secondary_ce_pin", secondaryCePin);
+  this->setIfPresent(parsedSettings, "secondary_reset_pin", secondaryResetPin);
   this->setIfPresent(parsedSettings, "packet_repeats", packetRepeats);
   this->setIfPresent(parsedSettings, "http_repeat_factor", httpRepeatFactor);
   this->setIfPresent(parsedSettings, "auto_restart_period", _autoRestartPeriod);
@@ -91,6 +97,8 @@ void Settings::patch(JsonObject parsedSettings) {
   this->setIfPresent(parsedSettings, "packet_repeat_throttle_threshold", packetRepeatThrottleThreshold);
   this->setIfPresent(parsedSettings, "packet_repeat_throttle_sensitivity", packetRepeatThrottleSensitivity);
   this->setIfPresent(parsedSettings, "packet_repeat_minimum", packetRepeatMinimum);
+  this->setIfPresent(parsedSettings, "adaptive_packet_repeats", adaptivePacketRepeats);
+  this->setIfPresent(parsedSettings, "interleave_packet_repeats", interleavePacketRepeats);
   this->setIfPresent(parsedSettings, "enable_automatic_mode_switching", enableAutomaticModeSwitching);
   this->setIfPresent(parsedSettings, "led_mode_packet_count", ledModePacketCount);
   this->setIfPresent(parsedSettings, "hostname", hostname);
@@ -100,6 +108,7 @@ void Settings::patch(JsonObject parsedSettings) {
   this->setIfPresent(parsedSettings, "packet_repeats_per_loop", packetRepeatsPerLoop);
   this->setIfPresent(parsedSettings, "home_assistant_discovery_prefix", homeAssistantDiscoveryPrefix);
   this->setIfPresent(parsedSettings, "default_transition_period", defaultTransitionPeriod);
+  this->setIfPresent(parsedSettings, "packet_log_size", packetLogSize);
 
   if (parsedSettings.containsKey("wifi_mode")) {
     this->wifiMode = wifiModeFromString(parsedSettings["wifi_mode"]);
@@ -136,6 +145,15 @@ void Settings::patch(JsonObject parsedSettings) {
 
   if (parsedSettings.containsKey("radio_interface_type")) {
     this->radioInterfaceType = Settings::typeFromString(parsedSettings["radio_interface_type"]);
+
+    // There's always a primary radio
+    if (this->radioInterfaceType == NoRadio) {
+      this->radioInterfaceType = nRF24;
+    }
+  }
+
+  if (parsedSettings.containsKey("secondary_radio_interface_type")) {
+    this->secondaryRadioInterfaceType = Settings::typeFromString(parsedSettings["secondary_radio_interface_type"]);
   }
 
   if (parsedSettings.containsKey("device_ids")) {
@@ -154,6 +172,110 @@ void Settings::patch(JsonObject parsedSettings) {
   if (parsedSettings.containsKey("group_id_aliases")) {
     parseGroupIdAliases(parsedSettings);
   }
+
+  if (parsedSettings.containsKey("loop_stage_budgets")) {
+    parseLoopStageBudgets(parsedSettings["loop_stage_budgets"]);
+  }
+}
+
+static bool gatewayConfigsEqual(
+  const std::vector<std::shared_ptr<GatewayConfig>>& a,
+  const std::vector<std::shared_ptr<GatewayConfig>>& b
+) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i]->deviceId != b[i]->deviceId || a[i]->port != b[i]->port || a[i]->protocolVersion != b[i]->protocolVersion) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool aliasesEqual(const std::map<String, BulbId>& a, const std::map<String, BulbId>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+
+  for (auto itA = a.begin(), itB = b.begin(); itA != a.end(); ++itA, ++itB) {
+    if (itA->first != itB->first
+      || itA->second.deviceId != itB->second.deviceId
+      || itA->second.groupId != itB->second.groupId
+      || itA->second.deviceType != itB->second.deviceType) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Anything not listed here is read straight from Settings when it's used, so
+// changing it doesn't need anything rebuilt.
+uint16_t Settings::changedSubsystems(const Settings& previous) const {
+  uint16_t changed = SUBSYSTEM_NONE;
+
+  if (cePin != previous.cePin
+    || csnPin != previous.csnPin
+    || resetPin != previous.resetPin
+    || radioInterfaceType != previous.radioInterfaceType
+    || secondaryRadioInterfaceType != previous.secondaryRadioInterfaceType
+    || secondaryCsnPin != previous.secondaryCsnPin
+    || secondaryCePin != previous.secondaryCePin
+    || secondaryResetPin != previous.secondaryResetPin
+    || rf24PowerLevel != previous.rf24PowerLevel
+    || rf24Channels != previous.rf24Channels
+    || rf24ListenChannel != previous.rf24ListenChannel
+    // Decides whether a second radio gets a dedicated listener
+    || (listenRepeats > 0) != (previous.listenRepeats > 0)) {
+    changed |= SUBSYSTEM_RADIOS;
+  }
+
+  if (packetRepeats != previous.packetRepeats
+    || packetRepeatThrottleSensitivity != previous.packetRepeatThrottleSensitivity) {
+    changed |= SUBSYSTEM_PACKET_SENDER;
+  }
+
+  if (stateFlushInterval != previous.stateFlushInterval) {
+    changed |= SUBSYSTEM_STATE_STORE;
+  }
+
+  if (_mqttServer != previous._mqttServer
+    || mqttUsername != previous.mqttUsername
+    || mqttPassword != previous.mqttPassword
+    || mqttTopicPattern != previous.mqttTopicPattern
+    || mqttUpdateTopicPattern != previous.mqttUpdateTopicPattern
+    || mqttStateTopicPattern != previous.mqttStateTopicPattern
+    || mqttClientStatusTopic != previous.mqttClientStatusTopic
+    || simpleMqttClientStatus != previous.simpleMqttClientStatus) {
+    changed |= SUBSYSTEM_MQTT;
+  }
+
+  // Aliases are looked up on use, so they only need discovery republished
+  if (homeAssistantDiscoveryPrefix != previous.homeAssistantDiscoveryPrefix
+    || ! aliasesEqual(groupIdAliases, previous.groupIdAliases)) {
+    changed |= SUBSYSTEM_HOME_ASSISTANT;
+  }
+
+  if (! gatewayConfigsEqual(gatewayConfigs, previous.gatewayConfigs)) {
+    changed |= SUBSYSTEM_UDP;
+  }
+
+  if (discoveryPort != previous.discoveryPort) {
+    changed |= SUBSYSTEM_DISCOVERY;
+  }
+
+  if (ledPin != previous.ledPin || ledModeOperating != previous.ledModeOperating) {
+    changed |= SUBSYSTEM_LED;
+  }
+
+  if (hostname != previous.hostname || wifiMode != previous.wifiMode) {
+    changed |= SUBSYSTEM_WIFI;
+  }
+
+  return changed;
 }
 
 std::map<String, BulbId>::const_iterator Settings::findAlias(MiLightRemoteType deviceType, uint16_t deviceId, uint8_t groupId) {
@@ -205,27 +327,167 @@ void Settings::dumpGroupIdAliases(JsonObject json) {
   }
 }
 
-void Settings::load(Settings& settings) {
-  if (SPIFFS.exists(SETTINGS_FILE)) {
-    // Clear in-memory settings
-    settings = Settings();
+void Settings::parseLoopStageBudgets(JsonObject json) {
+  loopStageBudgets.assign(LoopProfiler::NUM_STAGES, 0);
 
-    File f = SPIFFS.open(SETTINGS_FILE, "r");
-
-    DynamicJsonDocument json(MILIGHT_HUB_SETTINGS_BUFFER_SIZE);
-    auto error = deserializeJson(json, f);
-    f.close();
+  for (JsonPair kv : json) {
+    int8_t stage = LoopProfiler::stageFromName(kv.key().c_str());
 
-    if (! error) {
-      JsonObject parsedSettings = json.as<JsonObject>();
-      settings.patch(parsedSettings);
+    if (stage == -1) {
+      Serial.print(F("WARNING: unknown loop stage in loop_stage_budgets: "));
+      Serial.println(kv.key().c_str());
     } else {
-      Serial.print(F("Error parsing saved settings file: "));
-      Serial.println(error.c_str());
+      loopStageBudgets[stage] = kv.value().as<uint32_t>();
     }
+  }
+}
+
+void Settings::dumpLoopStageBudgets(JsonObject json) {
+  JsonObject budgets = json.createNestedObject("loop_stage_budgets");
+
+  for (size_t i = 0; i < loopStageBudgets.size() && i < LoopProfiler::NUM_STAGES; i++) {
+    if (loopStageBudgets[i] > 0) {
+      budgets[LoopProfiler::stageName(static_cast<LoopStage>(i))] = loopStageBudgets[i];
+    }
+  }
+}
+
+static const uint8_t BLOB_MAGIC[] = { 'M', 'S' };
+// Magic, version, and payload length
+static const size_t BLOB_HEADER_SIZE = 5;
+
+void Settings::load(Settings& settings, const char* blobFile) {
+  if (loadBlob(settings, blobFile)) {
+    return;
+  }
+
+  if (SPIFFS.exists(SETTINGS_FILE)) {
+    importJson(settings, SETTINGS_FILE, blobFile);
   } else {
-    settings.save();
+    settings.save(blobFile);
+  }
+}
+
+bool Settings::importJson(Settings& settings, const char* filename, const char* blobFile) {
+  File f = SPIFFS.open(filename, "r");
+
+  if (!f) {
+    Serial.println(F("ERROR: could not open settings file for import"));
+    return false;
+  }
+
+  DynamicJsonDocument json(MILIGHT_HUB_SETTINGS_BUFFER_SIZE);
+  TRACK_ALLOCATION(SETTINGS_DOCUMENT, MILIGHT_HUB_SETTINGS_BUFFER_SIZE);
+  auto error = deserializeJson(json, f);
+  f.close();
+
+  if (error) {
+    Serial.print(F("Error parsing saved settings file: "));
+    Serial.println(error.c_str());
+    return false;
   }
+
+  // Clear in-memory settings
+  settings = Settings();
+  settings.patch(json.as<JsonObject>());
+  settings.save(blobFile);
+
+  return true;
+}
+
+bool Settings::loadBlob(Settings& settings, const char* blobFile) {
+  if (! SPIFFS.exists(blobFile)) {
+    return false;
+  }
+
+  File f = SPIFFS.open(blobFile, "r");
+  const size_t fileSize = f.size();
+
+  if (fileSize < BLOB_HEADER_SIZE) {
+    f.close();
+    return false;
+  }
+
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[fileSize]);
+  const size_t bytesRead = f.read(buffer.get(), fileSize);
+  f.close();
+
+  const size_t payloadSize = buffer[3] | (buffer[4] << 8);
+
+  if (bytesRead != fileSize
+    || buffer[0] != BLOB_MAGIC[0]
+    || buffer[1] != BLOB_MAGIC[1]
+    || buffer[2] != BLOB_VERSION
+    || fileSize != BLOB_HEADER_SIZE + payloadSize) {
+    Serial.println(F("WARNING: ignoring unreadable settings file"));
+    return false;
+  }
+
+  // Clear in-memory settings
+  settings = Settings();
+
+  SettingsBlobReader reader(buffer.get() + BLOB_HEADER_SIZE, payloadSize);
+  settings.visitFields(reader);
+
+  return true;
+}
+
+template <typename Archive>
+void Settings::visitFields(Archive& archive) {
+  archive.field(adminUsername);
+  archive.field(adminPassword);
+  archive.field(cePin);
+  archive.field(csnPin);
+  archive.field(resetPin);
+  archive.field(ledPin);
+  archive.field(radioInterfaceType);
+  archive.field(secondaryRadioInterfaceType);
+  archive.field(secondaryCsnPin);
+  archive.field(secondaryCePin);
+  archive.field(secondaryResetPin);
+  archive.field(packetRepeats);
+  archive.field(httpRepeatFactor);
+  archive.field(_autoRestartPeriod);
+  archive.field(_mqttServer);
+  archive.field(mqttUsername);
+  archive.field(mqttPassword);
+  archive.field(mqttTopicPattern);
+  archive.field(mqttUpdateTopicPattern);
+  archive.field(mqttStateTopicPattern);
+  archive.field(mqttClientStatusTopic);
+  archive.field(simpleMqttClientStatus);
+  archive.field(discoveryPort);
+  archive.field(listenRepeats);
+  archive.field(stateFlushInterval);
+  archive.field(mqttStateRateLimit);
+  archive.field(packetRepeatThrottleSensitivity);
+  archive.field(packetRepeatThrottleThreshold);
+  archive.field(packetRepeatMinimum);
+  archive.field(adaptivePacketRepeats);
+  archive.field(interleavePacketRepeats);
+  archive.field(enableAutomaticModeSwitching);
+  archive.field(ledModeWifiConfig);
+  archive.field(ledModeWifiFailed);
+  archive.field(ledModeOperating);
+  archive.field(ledModePacket);
+  archive.field(ledModePacketCount);
+  archive.field(hostname);
+  archive.field(rf24PowerLevel);
+  archive.field(rf24ListenChannel);
+  archive.field(wifiStaticIP);
+  archive.field(wifiStaticIPGateway);
+  archive.field(wifiStaticIPNetmask);
+  archive.field(packetRepeatsPerLoop);
+  archive.field(homeAssistantDiscoveryPrefix);
+  archive.field(wifiMode);
+  archive.field(defaultTransitionPeriod);
+  archive.field(rf24Channels);
+  archive.field(deviceIds);
+  archive.field(gatewayConfigs);
+  archive.field(groupStateFields);
+  archive.field(groupIdAliases);
+  archive.field(loopStageBudgets);
+  archive.field(packetLogSize);
 }
 
 String Settings::toJson(const bool prettyPrint) {
@@ -235,19 +497,31 @@ String Settings::toJson(const bool prettyPrint) {
   return buffer;
 }
 
-void Settings::save() {
-  File f = SPIFFS.open(SETTINGS_FILE, "w");
+void Settings::save(const char* blobFile) {
+  std::vector<uint8_t> buffer(BLOB_HEADER_SIZE);
+  SettingsBlobWriter writer(buffer);
+  visitFields(writer);
+
+  const size_t payloadSize = buffer.size() - BLOB_HEADER_SIZE;
+  buffer[0] = BLOB_MAGIC[0];
+  buffer[1] = BLOB_MAGIC[1];
+  buffer[2] = BLOB_VERSION;
+  buffer[3] = payloadSize & 0xFF;
+  buffer[4] = payloadSize >> 8;
+
+  File f = SPIFFS.open(blobFile, "w");
 
   if (!f) {
     Serial.println(F("Opening settings file failed"));
   } else {
-    serialize(f);
+    f.write(buffer.data(), buffer.size());
     f.close();
   }
 }
 
 void Settings::serialize(Print& stream, const bool prettyPrint) {
   DynamicJsonDocument root(MILIGHT_HUB_SETTINGS_BUFFER_SIZE);
+  TRACK_ALLOCATION(SETTINGS_DOCUMENT, MILIGHT_HUB_SETTINGS_BUFFER_SIZE);
 
   root["admin_username"] = this->adminUsername;
   root["admin_password"] = this->adminPassword;
@@ -256,6 +530,10 @@ void Settings::serialize(Print& stream, const bool prettyPrint) {
   root["reset_pin"] = this->resetPin;
   root["led_pin"] = this->ledPin;
   root["radio_interface_type"] = typeToString(this->radioInterfaceType);
+  root["secondary_radio_interface_type"] = typeToString(this->secondaryRadioInterfaceType);
+  root["secondary_csn_pin"] = this->secondaryCsnPin;
+  root["secondary_ce_pin"] = this->secondaryCePin;
+  root["secondary_reset_pin"] = this->secondaryResetPin;
   root["packet_repeats"] = this->packetRepeats;
   root["http_repeat_factor"] = this->httpRepeatFactor;
   root["auto_restart_period"] = this->_autoRestartPeriod;
@@ -274,6 +552,8 @@ void Settings::serialize(Print& stream, const bool prettyPrint) {
   root["packet_repeat_throttle_sensitivity"] = this->packetRepeatThrottleSensitivity;
   root["packet_repeat_throttle_threshold"] = this->packetRepeatThrottleThreshold;
   root["packet_repeat_minimum"] = this->packetRepeatMinimum;
+  root["adaptive_packet_repeats"] = this->adaptivePacketRepeats;
+  root["interleave_packet_repeats"] = this->interleavePacketRepeats;
   root["enable_automatic_mode_switching"] = this->enableAutomaticModeSwitching;
   root["led_mode_wifi_config"] = LEDStatus::LEDModeToString(this->ledModeWifiConfig);
   root["led_mode_wifi_failed"] = LEDStatus::LEDModeToString(this->ledModeWifiFailed);
@@ -290,6 +570,7 @@ void Settings::serialize(Print& stream, const bool prettyPrint) {
   root["home_assistant_discovery_prefix"] = this->homeAssistantDiscoveryPrefix;
   root["wifi_mode"] = wifiModeToString(this->wifiMode);
   root["default_transition_period"] = this->defaultTransitionPeriod;
+  root["packet_log_size"] = this->packetLogSize;
 
   JsonArray channelArr = root.createNestedArray("rf24_channels");
   JsonHelpers::vectorToJsonArr<RF24Channel, String>(channelArr, rf24Channels, RF24ChannelHelpers::nameFromValue);
@@ -309,6 +590,7 @@ void Settings::serialize(Print& stream, const bool prettyPrint) {
   JsonHelpers::vectorToJsonArr<GroupStateField, const char*>(groupStateFieldArr, groupStateFields, GroupStateFieldHelpers::getFieldName);
 
   dumpGroupIdAliases(root.as<JsonObject>());
+  dumpLoopStageBudgets(root.as<JsonObject>());
 
   if (prettyPrint) {
     serializeJsonPretty(root, stream);
@@ -340,6 +622,8 @@ uint16_t Settings::mqttPort() {
 RadioInterfaceType Settings::typeFromString(const String& s) {
   if (s.equalsIgnoreCase("lt8900")) {
     return LT8900;
+  } else if (s.equalsIgnoreCase("none")) {
+    return NoRadio;
   } else {
     return nRF24;
   }
@@ -350,6 +634,9 @@ String Settings::typeToString(RadioInterfaceType type) {
     case LT8900:
       return "LT8900";
 
+    case NoRadio:
+      return "none";
+
     case nRF24:
     default:
       return "nRF24";
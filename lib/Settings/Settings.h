@@ -45,7 +45,10 @@
 #define MILIGHT_MAX_STALE_MQTT_GROUPS 10
 #endif
 
+// JSON is only used to import and export settings.  They're stored in a
+// compact binary file, see Settings::visitFields.
 #define SETTINGS_FILE  "/config.json"
+#define SETTINGS_BLOB_FILE "/config.bin"
 #define SETTINGS_TERMINATOR '\0'
 
 #define WEB_INDEX_FILENAME "/web/index.html"
@@ -61,12 +64,30 @@
 enum RadioInterfaceType {
   nRF24 = 0,
   LT8900 = 1,
+  // Only valid for the secondary radio
+  NoRadio = 2
 };
 
 enum class WifiMode {
   B, G, N
 };
 
+// Parts of the hub that are (re)built from settings.  See
+// Settings::changedSubsystems.
+enum SettingsSubsystem : uint16_t {
+  SUBSYSTEM_NONE = 0,
+  SUBSYSTEM_RADIOS = 1 << 0,
+  SUBSYSTEM_PACKET_SENDER = 1 << 1,
+  SUBSYSTEM_STATE_STORE = 1 << 2,
+  SUBSYSTEM_MQTT = 1 << 3,
+  SUBSYSTEM_UDP = 1 << 4,
+  SUBSYSTEM_DISCOVERY = 1 << 5,
+  SUBSYSTEM_LED = 1 << 6,
+  SUBSYSTEM_WIFI = 1 << 7,
+  SUBSYSTEM_HOME_ASSISTANT = 1 << 8,
+  SUBSYSTEM_ALL = 0xFFFF
+};
+
 static const std::vector<GroupStateField> DEFAULT_GROUP_STATE_FIELDS({
   GroupStateField::STATE,
   GroupStateField::BRIGHTNESS,
@@ -95,6 +116,10 @@ public:
     resetPin(0),
     ledPin(-2),
     radioInterfaceType(nRF24),
+    secondaryRadioInterfaceType(NoRadio),
+    secondaryCsnPin(16),
+    secondaryCePin(5),
+    secondaryResetPin(0),
     packetRepeats(50),
     httpRepeatFactor(1),
     listenRepeats(3),
@@ -105,6 +130,8 @@ public:
     packetRepeatThrottleThreshold(200),
     packetRepeatThrottleSensitivity(0),
     packetRepeatMinimum(3),
+    adaptivePacketRepeats(false),
+    interleavePacketRepeats(false),
     enableAutomaticModeSwitching(false),
     ledModeWifiConfig(LEDStatus::LEDMode::FastToggle),
     ledModeWifiFailed(LEDStatus::LEDMode::On),
@@ -119,6 +146,7 @@ public:
     packetRepeatsPerLoop(10),
     wifiMode(WifiMode::N),
     defaultTransitionPeriod(500),
+    packetLogSize(0),
     _autoRestartPeriod(0)
   { }
 
@@ -131,18 +159,35 @@ public:
   bool isAutoRestartEnabled();
   size_t getAutoRestartPeriod();
 
-  static void load(Settings& settings);
+  // Incompatible layout changes bump this.  Appending fields doesn't.
+  static const uint8_t BLOB_VERSION = 1;
+
+  // Loads the binary settings file.  Falls back to importing SETTINGS_FILE
+  // if there isn't a usable one.
+  static void load(Settings& settings, const char* blobFile = SETTINGS_BLOB_FILE);
+
+  // Replaces settings with the contents of a JSON file, then saves them in
+  // the binary format.  The JSON file is left alone so that firmware which
+  // predates the binary format can still find it.
+  static bool importJson(
+    Settings& settings,
+    const char* filename = SETTINGS_FILE,
+    const char* blobFile = SETTINGS_BLOB_FILE
+  );
 
   static RadioInterfaceType typeFromString(const String& s);
   static String typeToString(RadioInterfaceType type);
   static std::vector<RF24Channel> defaultListenChannels();
 
-  void save();
+  void save(const char* blobFile = SETTINGS_BLOB_FILE);
   String toJson(const bool prettyPrint = true);
   void serialize(Print& stream, const bool prettyPrint = false);
   void updateDeviceIds(JsonArray arr);
   void updateGatewayConfigs(JsonArray arr);
   void patch(JsonObject obj);
+
+  // Bitmask of SettingsSubsystems affected by differences from previous
+  uint16_t changedSubsystems(const Settings& previous) const;
   String mqttServer();
   uint16_t mqttPort();
   std::map<String, BulbId>::const_iterator findAlias(MiLightRemoteType deviceType, uint16_t deviceId, uint8_t groupId);
@@ -154,6 +199,12 @@ public:
   uint8_t resetPin;
   int8_t ledPin;
   RadioInterfaceType radioInterfaceType;
+  // An optional second transceiver on its own chip select.  Listens while the
+  // first one sends.
+  RadioInterfaceType secondaryRadioInterfaceType;
+  uint8_t secondaryCsnPin;
+  uint8_t secondaryCePin;
+  uint8_t secondaryResetPin;
   size_t packetRepeats;
   size_t httpRepeatFactor;
   uint8_t listenRepeats;
@@ -171,6 +222,8 @@ public:
   size_t packetRepeatThrottleThreshold;
   size_t packetRepeatThrottleSensitivity;
   size_t packetRepeatMinimum;
+  bool adaptivePacketRepeats;
+  bool interleavePacketRepeats;
   bool enableAutomaticModeSwitching;
   LEDStatus::LEDMode ledModeWifiConfig;
   LEDStatus::LEDMode ledModeWifiFailed;
@@ -193,12 +246,26 @@ public:
   String homeAssistantDiscoveryPrefix;
   WifiMode wifiMode;
   uint16_t defaultTransitionPeriod;
+  // Microseconds each main loop stage may take before a warning is logged,
+  // indexed by LoopStage.  0 means no budget.
+  std::vector<uint32_t> loopStageBudgets;
+  // Number of packets kept in the packet log on SPIFFS.  0 turns it off.
+  uint16_t packetLogSize;
 
 protected:
   size_t _autoRestartPeriod;
 
+  static bool loadBlob(Settings& settings, const char* blobFile);
+
+  // Passes every persisted field through archive.field(), in file order.  New
+  // fields go at the end.
+  template <typename Archive>
+  void visitFields(Archive& archive);
+
   void parseGroupIdAliases(JsonObject json);
   void dumpGroupIdAliases(JsonObject json);
+  void parseLoopStageBudgets(JsonObject json);
+  void dumpLoopStageBudgets(JsonObject json);
 
   static WifiMode wifiModeFromString(const String& mode);
   static String wifiModeToString(WifiMode mode);
@@ -0,0 +1,159 @@
+#include <SettingsBlob.h>
+#include <Settings.h>
+
+//================================================================================
+// Writer
+//================================================================================
+
+SettingsBlobWriter::SettingsBlobWriter(std::vector<uint8_t>& buffer)
+  : buffer(buffer)
+{ }
+
+void SettingsBlobWriter::write(const uint8_t* data, size_t length) {
+  buffer.insert(buffer.end(), data, data + length);
+}
+
+void SettingsBlobWriter::field(String& value) {
+  uint16_t length = value.length();
+  field(length);
+  write(reinterpret_cast<const uint8_t*>(value.c_str()), length);
+}
+
+void SettingsBlobWriter::field(std::vector<std::shared_ptr<GatewayConfig>>& configs) {
+  uint16_t count = configs.size();
+  field(count);
+
+  for (size_t i = 0; i < count; i++) {
+    uint16_t deviceId = configs[i]->deviceId;
+    uint16_t port = configs[i]->port;
+    uint8_t protocolVersion = configs[i]->protocolVersion;
+
+    field(deviceId);
+    field(port);
+    field(protocolVersion);
+  }
+}
+
+void SettingsBlobWriter::field(std::map<String, BulbId>& aliases) {
+  uint16_t count = aliases.size();
+  field(count);
+
+  for (auto it = aliases.begin(); it != aliases.end(); ++it) {
+    String alias = it->first;
+
+    field(alias);
+    field(it->second.deviceId);
+    field(it->second.groupId);
+    field(it->second.deviceType);
+  }
+}
+
+//================================================================================
+// Reader
+//================================================================================
+
+SettingsBlobReader::SettingsBlobReader(const uint8_t* data, size_t length)
+  : data(data)
+  , length(length)
+  , position(0)
+  , exhausted(false)
+{ }
+
+bool SettingsBlobReader::isExhausted() const {
+  return exhausted;
+}
+
+bool SettingsBlobReader::read(uint8_t* dest, size_t size) {
+  if (exhausted || position + size > length) {
+    exhausted = true;
+    return false;
+  }
+
+  memcpy(dest, data + position, size);
+  position += size;
+
+  return true;
+}
+
+bool SettingsBlobReader::readString(String& value) {
+  uint16_t stringLength;
+
+  if (! read(reinterpret_cast<uint8_t*>(&stringLength), sizeof(stringLength))) {
+    return false;
+  }
+
+  if (position + stringLength > length) {
+    exhausted = true;
+    return false;
+  }
+
+  value = "";
+  value.reserve(stringLength);
+
+  for (size_t i = 0; i < stringLength; i++) {
+    value += static_cast<char>(data[position + i]);
+  }
+  position += stringLength;
+
+  return true;
+}
+
+void SettingsBlobReader::field(String& value) {
+  String parsed;
+
+  if (readString(parsed)) {
+    value = parsed;
+  }
+}
+
+void SettingsBlobReader::field(std::vector<std::shared_ptr<GatewayConfig>>& configs) {
+  uint16_t count;
+
+  if (! read(reinterpret_cast<uint8_t*>(&count), sizeof(count))) {
+    return;
+  }
+
+  std::vector<std::shared_ptr<GatewayConfig>> parsed;
+
+  for (size_t i = 0; i < count && ! exhausted; i++) {
+    uint16_t deviceId = 0;
+    uint16_t port = 0;
+    uint8_t protocolVersion = 0;
+
+    field(deviceId);
+    field(port);
+    field(protocolVersion);
+
+    parsed.push_back(std::make_shared<GatewayConfig>(deviceId, port, protocolVersion));
+  }
+
+  if (! exhausted) {
+    configs = std::move(parsed);
+  }
+}
+
+void SettingsBlobReader::field(std::map<String, BulbId>& aliases) {
+  uint16_t count;
+
+  if (! read(reinterpret_cast<uint8_t*>(&count), sizeof(count))) {
+    return;
+  }
+
+  std::map<String, BulbId> parsed;
+
+  for (size_t i = 0; i < count && ! exhausted; i++) {
+    String alias;
+    BulbId bulbId;
+
+    readString(alias);
+    field(bulbId.deviceId);
+    field(bulbId.groupId);
+    field(bulbId.deviceType);
+
+    parsed[alias] = bulbId;
+  }
+
+  if (! exhausted) {
+    aliases = std::move(parsed);
+  }
+}
@@ -0,0 +1,124 @@
+#include <Arduino.h>
+#include <BulbId.h>
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <type_traits>
+
+#ifndef _SETTINGS_BLOB_H
+#define _SETTINGS_BLOB_H
+
+struct GatewayConfig;
+
+/*
+ * Archives for the binary settings file.  Settings::visitFields passes every
+ * persisted field through field(), in order, so the same list drives both
+ * directions.
+ *
+ * Integers are stored in host (little endian) order and enums as a single
+ * byte.  Strings and arrays are prefixed with a 16-bit length.
+ */
+class SettingsBlobWriter {
+public:
+  SettingsBlobWriter(std::vector<uint8_t>& buffer);
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value>::type field(T& value) {
+    write(reinterpret_cast<const uint8_t*>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_enum<T>::value>::type field(T& value) {
+    uint8_t raw = static_cast<uint8_t>(value);
+    field(raw);
+  }
+
+  template <typename T>
+  void field(std::vector<T>& values) {
+    uint16_t count = values.size();
+    field(count);
+
+    for (size_t i = 0; i < count; i++) {
+      field(values[i]);
+    }
+  }
+
+  void field(String& value);
+  void field(std::vector<std::shared_ptr<GatewayConfig>>& configs);
+  void field(std::map<String, BulbId>& aliases);
+
+private:
+  std::vector<uint8_t>& buffer;
+
+  void write(const uint8_t* data, size_t length);
+};
+
+/*
+ * Reads fields back in the order they were written.  A blob written by an
+ * older firmware simply runs out early, and everything after that point
+ * keeps its default.
+ */
+class SettingsBlobReader {
+public:
+  SettingsBlobReader(const uint8_t* data, size_t length);
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value>::type field(T& value) {
+    read(reinterpret_cast<uint8_t*>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_enum<T>::value>::type field(T& value) {
+    uint8_t raw;
+
+    if (read(&raw, 1)) {
+      value = static_cast<T>(raw);
+    }
+  }
+
+  template <typename T>
+  void field(std::vector<T>& values) {
+    uint16_t count;
+
+    if (! read(reinterpret_cast<uint8_t*>(&count), sizeof(count))) {
+      return;
+    }
+
+    // Every element takes at least a byte, so a count that can't fit in what's
+    // left is corrupt.  Don't allocate for it.
+    if (count > length - position) {
+      exhausted = true;
+      return;
+    }
+
+    std::vector<T> parsed(count);
+
+    for (size_t i = 0; i < count; i++) {
+      field(parsed[i]);
+    }
+
+    if (! exhausted) {
+      values = std::move(parsed);
+    }
+  }
+
+  void field(String& value);
+  void field(std::vector<std::shared_ptr<GatewayConfig>>& configs);
+  void field(std::map<String, BulbId>& aliases);
+
+  // True once a field couldn't be read in full
+  bool isExhausted() const;
+
+private:
+  const uint8_t* data;
+  const size_t length;
+  size_t position;
+  bool exhausted;
+
+  // Leaves the destination untouched if there aren't enough bytes left
+  bool read(uint8_t* dest, size_t size);
+  bool readString(String& value);
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include <HsvColorTransition.h>
+#include <Arduino.h>
+
+HsvColorTransition::Builder::Builder(size_t id, uint16_t defaultPeriod, const BulbId& bulbId, TransitionFn callback, const ParsedColor& start, const ParsedColor& end)
+  : Transition::Builder(id, defaultPeriod, bulbId, callback, calculateMaxDistance(start, end))
+  , start(start)
+  , end(end)
+{ }
+
+std::shared_ptr<Transition> HsvColorTransition::Builder::_build() const {
+  return std::make_shared<HsvColorTransition>(
+    id,
+    bulbId,
+    planSteps(start, end, getOrComputeNumPeriods()),
+    getOrComputePeriod(),
+    callback
+  );
+}
+
+HsvColorTransition::HsvColorTransition(
+  size_t id,
+  const BulbId& bulbId,
+  std::vector<Step>&& steps,
+  size_t period,
+  TransitionFn callback
+) : Transition(id, bulbId, period, callback)
+  , steps(std::move(steps))
+  , nextStep(0)
+  , currentTick(0)
+  , lastHue(400)         // use impossible values to force a packet send
+  , lastSaturation(200)
+{ }
+
+// Radio commands carry hue as a single byte.  See RgbCctPacketFormatter::updateHue.
+uint8_t HsvColorTransition::radioHue(uint16_t hue) {
+  return (hue * 255 + 180) / 360;
+}
+
+// Rounds distance * step / numSteps half away from zero
+int16_t HsvColorTransition::interpolate(int16_t distance, size_t step, size_t numSteps) {
+  int32_t scaled = 2 * static_cast<int32_t>(distance) * step;
+  int32_t divisor = 2 * numSteps;
+
+  return distance < 0
+    ? (scaled - static_cast<int32_t>(numSteps)) / divisor
+    : (scaled + static_cast<int32_t>(numSteps)) / divisor;
+}
+
+// Hue is meaningless for an unsaturated color, so don't sweep through the
+// color wheel when fading from white.
+uint16_t HsvColorTransition::startHue(const ParsedColor& start, const ParsedColor& end) {
+  return start.saturation == 0 ? end.hue : start.hue;
+}
+
+int16_t HsvColorTransition::hueDistance(const ParsedColor& start, const ParsedColor& end) {
+  if (end.saturation == 0) {
+    return 0;
+  }
+
+  int16_t distance = static_cast<int16_t>(end.hue % 360) - startHue(start, end) % 360;
+
+  if (distance > 180) {
+    distance -= 360;
+  } else if (distance < -180) {
+    distance += 360;
+  }
+
+  return distance;
+}
+
+size_t HsvColorTransition::calculateMaxDistance(const ParsedColor& start, const ParsedColor& end) {
+  size_t hueSteps = std::abs(static_cast<int16_t>(radioHue(std::abs(hueDistance(start, end)))));
+  size_t saturationSteps = std::abs(static_cast<int16_t>(end.saturation) - start.saturation);
+
+  return max(static_cast<size_t>(1), max(hueSteps, saturationSteps));
+}
+
+std::vector<HsvColorTransition::Step> HsvColorTransition::planSteps(const ParsedColor& start, const ParsedColor& end, size_t numPeriods) {
+  std::vector<Step> steps;
+  const uint16_t fromHue = startHue(start, end) % 360;
+  const int16_t dHue = hueDistance(start, end);
+  const int16_t dSaturation = static_cast<int16_t>(end.saturation) - start.saturation;
+
+  // Ticks are tracked in 16 bits
+  numPeriods = constrain(numPeriods, static_cast<size_t>(1), static_cast<size_t>(UINT16_MAX));
+
+  for (size_t i = 0; i <= numPeriods; i++) {
+    const uint16_t hue = (fromHue + interpolate(dHue, i, numPeriods) + 360) % 360;
+    const uint8_t saturation = start.saturation + interpolate(dSaturation, i, numPeriods);
+
+    if (!steps.empty()
+      && radioHue(steps.back().hue) == radioHue(hue)
+      && steps.back().saturation == saturation) {
+      // Same command as the last planned step.  Make sure the fade still
+      // lands exactly on the end color.
+      if (i == numPeriods) {
+        steps.back().hue = hue;
+      }
+      continue;
+    }
+
+    Step planned;
+    planned.tick = i;
+    planned.hue = hue;
+    planned.saturation = saturation;
+
+    steps.push_back(planned);
+  }
+
+  steps.shrink_to_fit();
+  return steps;
+}
+
+void HsvColorTransition::step() {
+  if (nextStep < steps.size() && steps[nextStep].tick == currentTick) {
+    const Step& next = steps[nextStep++];
+
+    if (next.hue != lastHue) {
+      callback(bulbId, GroupStateField::HUE, next.hue);
+      lastHue = next.hue;
+    }
+    if (next.saturation != lastSaturation) {
+      callback(bulbId, GroupStateField::SATURATION, next.saturation);
+      lastSaturation = next.saturation;
+    }
+  }
+
+  ++currentTick;
+}
+
+bool HsvColorTransition::isFinished() {
+  return nextStep >= steps.size();
+}
+
+void HsvColorTransition::childSerialize(JsonObject& json) {
+  json[F("type")] = F("color");
+  json[F("color_space")] = F("hsv");
+  json[F("current_hue")] = lastHue;
+  json[F("current_saturation")] = lastSaturation;
+  json[F("end_hue")] = steps.back().hue;
+  json[F("end_saturation")] = steps.back().saturation;
+  json[F("num_steps")] = steps.size();
+  json[F("next_step")] = nextStep;
+}
@@ -0,0 +1,59 @@
+#include <Transition.h>
+#include <ParsedColor.h>
+#include <vector>
+
+#pragma once
+
+// Fades between two colors in hue/saturation space, taking the short way
+// around the color wheel.  The whole fade is planned when the transition is
+// built.  Steps which would produce the same radio command as the one before
+// them are dropped, so ticks are just table lookups.
+class HsvColorTransition : public Transition {
+public:
+  // Packed to 4 bytes.  Hue is in degrees, saturation a percentage.
+  struct Step {
+    uint16_t tick;
+    uint16_t hue : 9;
+    uint16_t saturation : 7;
+  };
+
+  class Builder : public Transition::Builder {
+  public:
+    Builder(size_t id, uint16_t defaultPeriod, const BulbId& bulbId, TransitionFn callback, const ParsedColor& start, const ParsedColor& end);
+
+    virtual std::shared_ptr<Transition> _build() const override;
+
+  private:
+    const ParsedColor start;
+    const ParsedColor end;
+  };
+
+  HsvColorTransition(
+    size_t id,
+    const BulbId& bulbId,
+    std::vector<Step>&& steps,
+    size_t period,
+    TransitionFn callback
+  );
+
+  static std::vector<Step> planSteps(const ParsedColor& start, const ParsedColor& end, size_t numPeriods);
+  static size_t calculateMaxDistance(const ParsedColor& start, const ParsedColor& end);
+  virtual bool isFinished() override;
+
+protected:
+  const std::vector<Step> steps;
+  size_t nextStep;
+  uint16_t currentTick;
+
+  // Store these to avoid wasted packets
+  uint16_t lastHue;
+  uint16_t lastSaturation;
+
+  virtual void step() override;
+  virtual void childSerialize(JsonObject& json) override;
+
+  static int16_t hueDistance(const ParsedColor& start, const ParsedColor& end);
+  static uint16_t startHue(const ParsedColor& start, const ParsedColor& end);
+  static uint8_t radioHue(uint16_t hue);
+  static int16_t interpolate(int16_t distance, size_t step, size_t numSteps);
+};
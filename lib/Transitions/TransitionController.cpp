@@ -1,12 +1,14 @@
 #include <Transition.h>
 #include <FieldTransition.h>
 #include <ColorTransition.h>
+#include <HsvColorTransition.h>
 #include <ChangeFieldOnFinishTransition.h>
 #include <GroupStateField.h>
 #include <MiLightStatus.h>
 
 #include <TransitionController.h>
 #include <LinkedList.h>
+#include <AllocationTracker.h>
 #include <functional>
 
 using namespace std::placeholders;
@@ -29,7 +31,22 @@ void TransitionController::addListener(Transition::TransitionFn fn) {
   observers.push_back(fn);
 }
 
-std::shared_ptr<Transition::Builder> TransitionController::buildColorTransition(const BulbId& bulbId, const ParsedColor& start, const ParsedColor& end) {
+std::shared_ptr<Transition::Builder> TransitionController::buildColorTransition(const BulbId& bulbId, const ParsedColor& start, const ParsedColor& end, ColorSpace colorSpace) {
+  if (colorSpace == ColorSpace::HSV) {
+    TRACK_ALLOCATION(TRANSITION_BUILDER, sizeof(HsvColorTransition::Builder));
+
+    return std::make_shared<HsvColorTransition::Builder>(
+      currentId++,
+      defaultPeriod,
+      bulbId,
+      callback,
+      start,
+      end
+    );
+  }
+
+  TRACK_ALLOCATION(TRANSITION_BUILDER, sizeof(ColorTransition::Builder));
+
   return std::make_shared<ColorTransition::Builder>(
     currentId++,
     defaultPeriod,
@@ -41,6 +58,8 @@ std::shared_ptr<Transition::Builder> TransitionController::buildColorTransition(
 }
 
 std::shared_ptr<Transition::Builder> TransitionController::buildFieldTransition(const BulbId& bulbId, GroupStateField field, uint16_t start, uint16_t end) {
+  TRACK_ALLOCATION(TRANSITION_BUILDER, sizeof(FieldTransition::Builder));
+
   return std::make_shared<FieldTransition::Builder>(
     currentId++,
     defaultPeriod,
@@ -61,6 +80,8 @@ std::shared_ptr<Transition::Builder> TransitionController::buildStatusTransition
 
     transition = buildFieldTransition(bulbId, GroupStateField::LEVEL, startLevel, 100);
   } else {
+    TRACK_ALLOCATION(TRANSITION_BUILDER, sizeof(ChangeFieldOnFinishTransition::Builder));
+
     transition = std::make_shared<ChangeFieldOnFinishTransition::Builder>(
       currentId++,
       GroupStateField::STATUS,
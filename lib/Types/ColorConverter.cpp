@@ -0,0 +1,78 @@
+#include <ColorConverter.h>
+
+// Hue offset (in degrees) for each sector, indexed by which channel is largest.
+// Red gets two entries because hue wraps around when blue > green.
+enum HueSector {
+  HUE_SECTOR_RED = 0,
+  HUE_SECTOR_RED_WRAPPED,
+  HUE_SECTOR_GREEN,
+  HUE_SECTOR_BLUE
+};
+
+static const uint16_t HUE_SECTOR_OFFSETS[] = { 0, 360, 120, 240 };
+
+// Indices into { v, p, q, t } for each of r, g, b in the six 60 degree hue
+// sectors.
+enum HsvComponent : uint8_t { V = 0, P, Q, T };
+
+static const uint8_t HSV_SECTOR_CHANNELS[6][3] = {
+  { V, T, P },
+  { Q, V, P },
+  { P, V, T },
+  { P, Q, V },
+  { T, P, V },
+  { V, P, Q }
+};
+
+void ColorConverter::rgbToHsv(uint8_t r, uint8_t g, uint8_t b, uint16_t& hue, uint8_t& saturation) {
+  uint8_t max, min;
+  int16_t numerator;
+  HueSector sector;
+
+  // Ties go to red, then green, as in RGBConverter
+  if (r >= g && r >= b) {
+    max = r;
+    min = g < b ? g : b;
+    numerator = g - b;
+    sector = g < b ? HUE_SECTOR_RED_WRAPPED : HUE_SECTOR_RED;
+  } else if (g >= b) {
+    max = g;
+    min = r < b ? r : b;
+    numerator = b - r;
+    sector = HUE_SECTOR_GREEN;
+  } else {
+    max = b;
+    min = r < g ? r : g;
+    numerator = r - g;
+    sector = HUE_SECTOR_BLUE;
+  }
+
+  const uint32_t delta = max - min;
+
+  // Everything below rounds half up, which is what round() does for positive values
+  saturation = max == 0 ? 0 : (200 * delta + max) / (2 * max);
+
+  if (delta == 0) {
+    hue = 0;
+  } else {
+    // Always positive: the wrapped red sector more than makes up for a negative numerator
+    const uint32_t scaledHue = 60 * numerator + HUE_SECTOR_OFFSETS[sector] * delta;
+    hue = (2 * scaledHue + delta) / (2 * delta);
+  }
+}
+
+void ColorConverter::hsvToRgb(uint16_t hue, uint8_t saturation, uint8_t rgb[3]) {
+  const uint8_t sector = (hue / 60) % 6;
+  const uint32_t remainder = hue % 60;
+
+  const uint8_t components[] = {
+    255,
+    static_cast<uint8_t>((255 * (100 - saturation)) / 100),
+    static_cast<uint8_t>((255 * (6000 - remainder * saturation)) / 6000),
+    static_cast<uint8_t>((255 * (6000 - (60 - remainder) * saturation)) / 6000)
+  };
+
+  for (uint8_t i = 0; i < 3; i++) {
+    rgb[i] = components[HSV_SECTOR_CHANNELS[sector][i]];
+  }
+}
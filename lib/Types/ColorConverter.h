@@ -0,0 +1,15 @@
+#include <stdint.h>
+
+#pragma once
+
+// Integer RGB <-> HSV conversions.  Results match RGBConverter (after the
+// rounding ParsedColor and GroupState apply) without touching the soft-float
+// library.
+//
+// Hue is in degrees [0, 360] and saturation is a percentage [0, 100].  Value is
+// always full brightness, which is the only case bulbs care about.
+class ColorConverter {
+public:
+  static void rgbToHsv(uint8_t r, uint8_t g, uint8_t b, uint16_t& hue, uint8_t& saturation);
+  static void hsvToRgb(uint16_t hue, uint8_t saturation, uint8_t rgb[3]);
+};
@@ -1,29 +1,33 @@
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
 #ifndef _GROUP_STATE_FIELDS_H
 #define _GROUP_STATE_FIELDS_H
 
 namespace GroupStateFieldNames {
-  static const char UNKNOWN[] = "unknown";
-  static const char STATE[] = "state";
-  static const char STATUS[] = "status";
-  static const char BRIGHTNESS[] = "brightness";
-  static const char LEVEL[] = "level";
-  static const char HUE[] = "hue";
-  static const char SATURATION[] = "saturation";
-  static const char COLOR[] = "color";
-  static const char MODE[] = "mode";
-  static const char KELVIN[] = "kelvin";
-  static const char TEMPERATURE[] = "temperature"; //alias for kelvin
-  static const char COLOR_TEMP[] = "color_temp";
-  static const char BULB_MODE[] = "bulb_mode";
-  static const char COMPUTED_COLOR[] = "computed_color";
-  static const char EFFECT[] = "effect";
-  static const char DEVICE_ID[] = "device_id";
-  static const char GROUP_ID[] = "group_id";
-  static const char DEVICE_TYPE[] = "device_type";
-  static const char OH_COLOR[] = "oh_color";
-  static const char HEX_COLOR[] = "hex_color";
-  static const char COMMAND[] = "command";
-  static const char COMMANDS[] = "commands";
+  static constexpr char UNKNOWN[] = "unknown";
+  static constexpr char STATE[] = "state";
+  static constexpr char STATUS[] = "status";
+  static constexpr char BRIGHTNESS[] = "brightness";
+  static constexpr char LEVEL[] = "level";
+  static constexpr char HUE[] = "hue";
+  static constexpr char SATURATION[] = "saturation";
+  static constexpr char COLOR[] = "color";
+  static constexpr char MODE[] = "mode";
+  static constexpr char KELVIN[] = "kelvin";
+  static constexpr char TEMPERATURE[] = "temperature"; //alias for kelvin
+  static constexpr char COLOR_TEMP[] = "color_temp";
+  static constexpr char BULB_MODE[] = "bulb_mode";
+  static constexpr char COMPUTED_COLOR[] = "computed_color";
+  static constexpr char EFFECT[] = "effect";
+  static constexpr char DEVICE_ID[] = "device_id";
+  static constexpr char GROUP_ID[] = "group_id";
+  static constexpr char DEVICE_TYPE[] = "device_type";
+  static constexpr char OH_COLOR[] = "oh_color";
+  static constexpr char HEX_COLOR[] = "hex_color";
+  static constexpr char COMMAND[] = "command";
+  static constexpr char COMMANDS[] = "commands";
 };
 
 enum class GroupStateField {
@@ -53,6 +57,82 @@ public:
   static const char* getFieldName(GroupStateField field);
   static GroupStateField getFieldByName(const char* name);
   static bool isBrightnessField(GroupStateField field);
+
+  // FNV-1a.  Usable at compile time, so lookup tables keyed on the names above
+  // can be generated and checked for collisions by the compiler.
+  static constexpr uint32_t hashFieldName(const char* name, uint32_t hash = 2166136261u) {
+    return *name == 0
+      ? hash
+      : hashFieldName(name + 1, (hash ^ static_cast<uint8_t>(*name)) * 16777619u);
+  }
+};
+
+/*
+ * Perfect hash lookup tables keyed on field names.  A table is a constexpr
+ * array whose entries are named by hashedFieldName(entry).  Plain strings
+ * work as is; other entry types need an overload next to their declaration.
+ *
+ *   static_assert(! GroupStateFieldHash::slotsCollide(TABLE), "...");
+ *   static constexpr GroupStateFieldHash::SlotTable SLOTS = GroupStateFieldHash::slotTable(TABLE);
+ *   int8_t ix = GroupStateFieldHash::find(TABLE, SLOTS, name);
+ */
+namespace GroupStateFieldHash {
+  // Picked so that the tables in MiLightClient and GroupState are collision
+  // free.  If a change to either collides, its static_assert fails.
+  static const uint32_t SEED = 3;
+  static const uint8_t NUM_SLOTS = 16;
+
+  // Index into the table for each slot, or -1 if the slot is empty
+  struct SlotTable {
+    int8_t entries[NUM_SLOTS];
+  };
+
+  constexpr const char* hashedFieldName(const char* name) {
+    return name;
+  }
+
+  constexpr uint8_t slot(const char* name) {
+    return GroupStateFieldHelpers::hashFieldName(name, SEED) % NUM_SLOTS;
+  }
+
+  template <typename T, size_t N>
+  constexpr bool slotsCollide(const T (&table)[N], size_t i = 0, size_t j = 1) {
+    return i >= N ? false
+      : j >= N ? slotsCollide(table, i + 1, i + 2)
+      : slot(hashedFieldName(table[i])) == slot(hashedFieldName(table[j])) || slotsCollide(table, i, j + 1);
+  }
+
+  template <typename T, size_t N>
+  constexpr int8_t entryInSlot(const T (&table)[N], uint8_t s, size_t i = 0) {
+    return i >= N ? static_cast<int8_t>(-1)
+      : slot(hashedFieldName(table[i])) == s ? static_cast<int8_t>(i)
+      : entryInSlot(table, s, i + 1);
+  }
+
+  template <typename T, size_t N>
+  constexpr SlotTable slotTable(const T (&table)[N]) {
+    static_assert(N < 128, "Table indexes have to fit in an int8_t");
+    static_assert(NUM_SLOTS == 16, "One entryInSlot per slot below");
+
+    return {{
+      entryInSlot(table, 0),  entryInSlot(table, 1),  entryInSlot(table, 2),  entryInSlot(table, 3),
+      entryInSlot(table, 4),  entryInSlot(table, 5),  entryInSlot(table, 6),  entryInSlot(table, 7),
+      entryInSlot(table, 8),  entryInSlot(table, 9),  entryInSlot(table, 10), entryInSlot(table, 11),
+      entryInSlot(table, 12), entryInSlot(table, 13), entryInSlot(table, 14), entryInSlot(table, 15)
+    }};
+  }
+
+  // Returns the index of the entry with this name, or -1 if there isn't one
+  template <typename T, size_t N>
+  int8_t find(const T (&table)[N], const SlotTable& slots, const char* name) {
+    const int8_t ix = slots.entries[slot(name)];
+
+    if (ix < 0 || strcmp(name, hashedFieldName(table[ix])) != 0) {
+      return -1;
+    }
+
+    return ix;
+  }
 };
 
 #endif
@@ -7,6 +7,8 @@ namespace MiLightCommandNames {
   static const char NIGHT_MODE[] = "night_mode";
   static const char LEVEL_UP[] = "level_up";
   static const char LEVEL_DOWN[] = "level_down";
+  static const char BRIGHTNESS_UP[] = "brightness_up";
+  static const char BRIGHTNESS_DOWN[] = "brightness_down";
   static const char TEMPERATURE_UP[] = "temperature_up";
   static const char TEMPERATURE_DOWN[] = "temperature_down";
   static const char NEXT_MODE[] = "next_mode";
@@ -14,5 +16,6 @@ namespace MiLightCommandNames {
   static const char MODE_SPEED_DOWN[] = "mode_speed_down";
   static const char MODE_SPEED_UP[] = "mode_speed_up";
   static const char TOGGLE[] = "toggle";
+  static const char COLOR_WHITE_TOGGLE[] = "color_white_toggle";
   static const char TRANSITION[] = "transition";
 };
\ No newline at end of file
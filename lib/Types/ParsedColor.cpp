@@ -1,16 +1,13 @@
 #include <ParsedColor.h>
-#include <RGBConverter.h>
+#include <ColorConverter.h>
 #include <TokenIterator.h>
 #include <GroupStateField.h>
 #include <IntParsing.h>
 
 ParsedColor ParsedColor::fromRgb(uint16_t r, uint16_t g, uint16_t b) {
-  double hsv[3];
-  RGBConverter converter;
-  converter.rgbToHsv(r, g, b, hsv);
-
-  uint16_t hue = round(hsv[0]*360);
-  uint8_t saturation = round(hsv[1]*100);
+  uint16_t hue;
+  uint8_t saturation;
+  ColorConverter::rgbToHsv(r, g, b, hue, saturation);
 
   return ParsedColor{
     .success = true,
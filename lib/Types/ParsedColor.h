@@ -3,6 +3,12 @@
 
 #pragma once
 
+// Space colors are interpolated in during transitions
+enum class ColorSpace : uint8_t {
+  RGB,
+  HSV
+};
+
 struct ParsedColor {
   bool success;
   uint16_t hue, r, g, b;
@@ -0,0 +1,102 @@
+#include <ParsedPacket.h>
+#include <GroupStateField.h>
+
+ParsedPacket::ParsedPacket()
+  : fields(0),
+    state(OFF),
+    brightness(0),
+    hue(0),
+    saturation(0),
+    mode(0),
+    colorTemp(0),
+    command(NULL),
+    buttonId(0),
+    argument(0)
+{ }
+
+bool ParsedPacket::has(ParsedPacketField field) const {
+  return (fields & (1 << static_cast<uint8_t>(field))) != 0;
+}
+
+bool ParsedPacket::isEmpty() const {
+  return fields == 0;
+}
+
+void ParsedPacket::set(ParsedPacketField field) {
+  fields |= (1 << static_cast<uint8_t>(field));
+}
+
+void ParsedPacket::setState(MiLightStatus state) {
+  this->state = state;
+  set(ParsedPacketField::STATE);
+}
+
+void ParsedPacket::setBrightness(uint8_t brightness) {
+  this->brightness = brightness;
+  set(ParsedPacketField::BRIGHTNESS);
+}
+
+void ParsedPacket::setHue(uint16_t hue) {
+  this->hue = hue;
+  set(ParsedPacketField::HUE);
+}
+
+void ParsedPacket::setSaturation(uint8_t saturation) {
+  this->saturation = saturation;
+  set(ParsedPacketField::SATURATION);
+}
+
+void ParsedPacket::setMode(uint8_t mode) {
+  this->mode = mode;
+  set(ParsedPacketField::MODE);
+}
+
+void ParsedPacket::setColorTemp(uint16_t colorTemp) {
+  this->colorTemp = colorTemp;
+  set(ParsedPacketField::COLOR_TEMP);
+}
+
+void ParsedPacket::setCommand(const char* command) {
+  this->command = command;
+  set(ParsedPacketField::COMMAND);
+}
+
+void ParsedPacket::setButtonId(uint8_t buttonId) {
+  this->buttonId = buttonId;
+  set(ParsedPacketField::BUTTON_ID);
+}
+
+void ParsedPacket::setArgument(uint8_t argument) {
+  this->argument = argument;
+  set(ParsedPacketField::ARGUMENT);
+}
+
+void ParsedPacket::serialize(JsonObject json) const {
+  if (has(ParsedPacketField::STATE)) {
+    json[GroupStateFieldNames::STATE] = state == ON ? "ON" : "OFF";
+  }
+  if (has(ParsedPacketField::BRIGHTNESS)) {
+    json[GroupStateFieldNames::BRIGHTNESS] = brightness;
+  }
+  if (has(ParsedPacketField::HUE)) {
+    json[GroupStateFieldNames::HUE] = hue;
+  }
+  if (has(ParsedPacketField::SATURATION)) {
+    json[GroupStateFieldNames::SATURATION] = saturation;
+  }
+  if (has(ParsedPacketField::MODE)) {
+    json[GroupStateFieldNames::MODE] = mode;
+  }
+  if (has(ParsedPacketField::COLOR_TEMP)) {
+    json[GroupStateFieldNames::COLOR_TEMP] = colorTemp;
+  }
+  if (has(ParsedPacketField::COMMAND)) {
+    json[GroupStateFieldNames::COMMAND] = command;
+  }
+  if (has(ParsedPacketField::BUTTON_ID)) {
+    json["button_id"] = buttonId;
+  }
+  if (has(ParsedPacketField::ARGUMENT)) {
+    json["argument"] = argument;
+  }
+}
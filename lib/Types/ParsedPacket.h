@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <ArduinoJson.h>
+#include <MiLightStatus.h>
+
+#pragma once
+
+// Fields a decoded packet can carry.  Bit positions in ParsedPacket::fields.
+enum class ParsedPacketField : uint8_t {
+  STATE,
+  BRIGHTNESS,
+  HUE,
+  SATURATION,
+  MODE,
+  COLOR_TEMP,
+  COMMAND,
+  BUTTON_ID,
+  ARGUMENT
+};
+
+// What a single packet says about a group, decoded straight from its bytes.
+// Values are in the same units as the JSON PacketFormatter::parsePacket
+// writes, and serialize() produces that JSON.
+struct ParsedPacket {
+  ParsedPacket();
+
+  uint16_t fields;
+  MiLightStatus state;
+  // 0-255
+  uint8_t brightness;
+  uint16_t hue;
+  uint8_t saturation;
+  uint8_t mode;
+  // Mireds
+  uint16_t colorTemp;
+  // Not copied.  Should point to a string that outlives the packet, like one
+  // of MiLightCommandNames.
+  const char* command;
+  // Unrecognized commands
+  uint8_t buttonId;
+  uint8_t argument;
+
+  bool has(ParsedPacketField field) const;
+  bool isEmpty() const;
+
+  void setState(MiLightStatus state);
+  void setBrightness(uint8_t brightness);
+  void setHue(uint16_t hue);
+  void setSaturation(uint8_t saturation);
+  void setMode(uint8_t mode);
+  void setColorTemp(uint16_t colorTemp);
+  void setCommand(const char* command);
+  void setButtonId(uint8_t buttonId);
+  void setArgument(uint8_t argument);
+
+  void serialize(JsonObject json) const;
+
+private:
+  void set(ParsedPacketField field);
+};
@@ -3,11 +3,12 @@
 #include <V6MiLightUdpServer.h>
 #include <ESP8266WiFi.h>
 
-MiLightUdpServer::MiLightUdpServer(MiLightClient*& client, uint16_t port, uint16_t deviceId)
+MiLightUdpServer::MiLightUdpServer(MiLightClient*& client, uint16_t port, uint16_t deviceId, CommandSource commandSource)
   : client(client),
     port(port),
     deviceId(deviceId),
-    lastGroup(0)
+    lastGroup(0),
+    commandSource(commandSource)
 { }
 
 MiLightUdpServer::~MiLightUdpServer() {
@@ -23,23 +24,57 @@ void MiLightUdpServer::stop() {
 }
 
 void MiLightUdpServer::handleClient() {
-  const size_t packetSize = socket.parsePacket();
+  const unsigned long start = micros();
+
+  // Drain as many queued datagrams as fit in the budget.  Apps send bursts of
+  // commands for scenes, and handling one per loop lets lwIP's buffers fill up.
+  for (size_t i = 0; i < MILIGHT_UDP_MAX_PACKETS_PER_LOOP; i++) {
+    if (i > 0 && (micros() - start) >= MILIGHT_UDP_LOOP_BUDGET_US) {
+      break;
+    }
+
+    const size_t packetSize = socket.parsePacket();
+
+    if (packetSize == 0) {
+      break;
+    }
+
+    stats.received++;
+
+    // The unread datagram is discarded by the next call to parsePacket
+    if (packetSize > MILIGHT_PACKET_BUFFER_SIZE) {
+      stats.dropped++;
+      continue;
+    }
 
-  if (packetSize) {
     socket.read(packetBuffer, packetSize);
+    client->stampCommand(commandSource);
 
 #ifdef MILIGHT_UDP_DEBUG
     printf("[MiLightUdpServer port %d] - Handling packet: ", port);
-    for (size_t i = 0; i < packetSize; i++) {
-      printf("%02X ", packetBuffer[i]);
+    for (size_t j = 0; j < packetSize; j++) {
+      printf("%02X ", packetBuffer[j]);
     }
     printf("\n");
 #endif
 
     handlePacket(packetBuffer, packetSize);
+    stats.processed++;
   }
 }
 
+uint16_t MiLightUdpServer::getPort() const {
+  return port;
+}
+
+uint16_t MiLightUdpServer::getDeviceId() const {
+  return deviceId;
+}
+
+const UdpServerStats& MiLightUdpServer::getStats() const {
+  return stats;
+}
+
 std::shared_ptr<MiLightUdpServer> MiLightUdpServer::fromVersion(uint8_t version, MiLightClient*& client, uint16_t port, uint16_t deviceId) {
   if (version == 0 || version == 5) {
     return std::make_shared<V5MiLightUdpServer>(client, port, deviceId);
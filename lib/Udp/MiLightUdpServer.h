@@ -9,21 +9,48 @@
 
 #define MILIGHT_PACKET_BUFFER_SIZE 30
 
+// Bounds on how much work handleClient does in a single call.  Datagrams that
+// don't fit in the budget stay buffered in lwIP until the next call.
+#ifndef MILIGHT_UDP_MAX_PACKETS_PER_LOOP
+#define MILIGHT_UDP_MAX_PACKETS_PER_LOOP 8
+#endif
+
+#ifndef MILIGHT_UDP_LOOP_BUDGET_US
+#define MILIGHT_UDP_LOOP_BUDGET_US 5000
+#endif
+
 // Uncomment to enable Serial printing of packets
 // #define MILIGHT_UDP_DEBUG
 
 #ifndef _MILIGHT_UDP_SERVER
 #define _MILIGHT_UDP_SERVER
 
+struct UdpServerStats {
+  UdpServerStats()
+    : received(0),
+      processed(0),
+      dropped(0)
+  { }
+
+  uint32_t received;
+  uint32_t processed;
+  // Datagrams too large to be a valid command
+  uint32_t dropped;
+};
+
 class MiLightUdpServer {
 public:
-  MiLightUdpServer(MiLightClient*& client, uint16_t port, uint16_t deviceId);
+  MiLightUdpServer(MiLightClient*& client, uint16_t port, uint16_t deviceId, CommandSource commandSource);
   virtual ~MiLightUdpServer();
 
   void stop();
   void begin();
   void handleClient();
 
+  uint16_t getPort() const;
+  uint16_t getDeviceId() const;
+  const UdpServerStats& getStats() const;
+
   static std::shared_ptr<MiLightUdpServer> fromVersion(uint8_t version, MiLightClient*&, uint16_t port, uint16_t deviceId);
 
 protected:
@@ -32,8 +59,11 @@ protected:
   uint16_t port;
   uint16_t deviceId;
   uint8_t lastGroup;
+  // Which protocol version commands are traced as
+  const CommandSource commandSource;
   uint8_t packetBuffer[MILIGHT_PACKET_BUFFER_SIZE];
   uint8_t responseBuffer[MILIGHT_PACKET_BUFFER_SIZE];
+  UdpServerStats stats;
 
   // Should return size of the response packet
   virtual void handlePacket(uint8_t* packet, size_t packetSize) = 0;
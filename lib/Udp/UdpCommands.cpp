@@ -0,0 +1,264 @@
+#include <UdpCommands.h>
+
+//================================================================================
+// V5 command table
+//================================================================================
+
+static constexpr uint8_t cctButtonGroup(uint8_t button) {
+  return (button == CCT_ALL_ON || button == CCT_ALL_OFF) ? 0
+    : (button == CCT_GROUP_1_ON || button == CCT_GROUP_1_OFF) ? 1
+    : (button == CCT_GROUP_2_ON || button == CCT_GROUP_2_OFF) ? 2
+    : (button == CCT_GROUP_3_ON || button == CCT_GROUP_3_OFF) ? 3
+    : (button == CCT_GROUP_4_ON || button == CCT_GROUP_4_OFF) ? 4
+    : 255;
+}
+
+static constexpr bool cctButtonIsOn(uint8_t button) {
+  return button == CCT_ALL_ON
+    || button == CCT_GROUP_1_ON
+    || button == CCT_GROUP_2_ON
+    || button == CCT_GROUP_3_ON
+    || button == CCT_GROUP_4_ON;
+}
+
+static constexpr bool isRgbwWhite(uint8_t c) {
+  return c == UDP_RGBW_GROUP_ALL_WHITE
+    || c == UDP_RGBW_GROUP_1_WHITE
+    || c == UDP_RGBW_GROUP_2_WHITE
+    || c == UDP_RGBW_GROUP_3_WHITE
+    || c == UDP_RGBW_GROUP_4_WHITE;
+}
+
+static constexpr bool isRgbwNight(uint8_t c) {
+  return c == UDP_RGBW_GROUP_ALL_NIGHT
+    || c == UDP_RGBW_GROUP_1_NIGHT
+    || c == UDP_RGBW_GROUP_2_NIGHT
+    || c == UDP_RGBW_GROUP_3_NIGHT
+    || c == UDP_RGBW_GROUP_4_NIGHT;
+}
+
+// RGBW commands which apply to the last selected group
+static constexpr UdpAction rgbwLastGroupAction(uint8_t c) {
+  return c == UDP_RGBW_ALL_ON ? UdpAction::ALL_ON
+    : c == UDP_RGBW_ALL_OFF ? UdpAction::ALL_OFF
+    : c == UDP_RGBW_COLOR ? UdpAction::COLOR_RAW
+    : c == UDP_RGBW_DISCO_MODE ? UdpAction::NEXT_MODE
+    : c == UDP_RGBW_SPEED_DOWN ? UdpAction::SPEED_DOWN
+    : c == UDP_RGBW_SPEED_UP ? UdpAction::SPEED_UP
+    : c == UDP_RGBW_BRIGHTNESS ? UdpAction::BRIGHTNESS
+    : UdpAction::NONE;
+}
+
+// CCT commands which apply to the last selected group
+static constexpr UdpAction cctLastGroupAction(uint8_t c) {
+  return c == UDP_CCT_BRIGHTNESS_DOWN ? UdpAction::BRIGHTNESS_DOWN
+    : c == UDP_CCT_BRIGHTNESS_UP ? UdpAction::BRIGHTNESS_UP
+    : c == UDP_CCT_TEMPERATURE_DOWN ? UdpAction::TEMPERATURE_DOWN
+    : c == UDP_CCT_TEMPERATURE_UP ? UdpAction::TEMPERATURE_UP
+    : c == UDP_CCT_NIGHT_MODE ? UdpAction::NIGHT_MODE
+    : UdpAction::NONE;
+}
+
+// Rules are checked in priority order.  CCT on/off (and night mode, which
+// is off with the MSB set) are identified by the low nibble, and don't change
+// the group used by subsequent commands.
+static constexpr UdpCommand v5Command(uint8_t c) {
+  return (c >= UDP_RGBW_GROUP_1_ON && c <= UDP_RGBW_GROUP_4_OFF)
+      ? UdpCommand(
+          REMOTE_TYPE_RGBW,
+          (c % 2) == 1 ? UdpAction::STATUS_ON : UdpAction::STATUS_OFF,
+          (c - UDP_RGBW_GROUP_1_ON + 2) / 2,
+          true
+        )
+    : isRgbwWhite(c)
+      ? UdpCommand(REMOTE_TYPE_RGBW, UdpAction::SET_WHITE, (c - UDP_RGBW_GROUP_ALL_WHITE) / 2, true)
+    : isRgbwNight(c)
+      ? UdpCommand(
+          REMOTE_TYPE_RGBW,
+          UdpAction::NIGHT_MODE,
+          c == UDP_RGBW_GROUP_ALL_NIGHT ? 0 : (c - UDP_RGBW_GROUP_1_NIGHT + 2) / 2,
+          true
+        )
+    : rgbwLastGroupAction(c) != UdpAction::NONE
+      ? UdpCommand(REMOTE_TYPE_RGBW, rgbwLastGroupAction(c), UDP_LAST_GROUP)
+    : cctButtonGroup(c & 0xF) != 255
+      ? UdpCommand(
+          REMOTE_TYPE_CCT,
+          (c & 0x80) == 0x80 ? UdpAction::NIGHT_MODE
+            : cctButtonIsOn(c & 0xF) ? UdpAction::STATUS_ON
+            : UdpAction::STATUS_OFF,
+          cctButtonGroup(c & 0xF)
+        )
+    : cctLastGroupAction(c) != UdpAction::NONE
+      ? UdpCommand(REMOTE_TYPE_CCT, cctLastGroupAction(c), UDP_LAST_GROUP)
+    : UdpCommand();
+}
+
+#define V5_COMMAND_ROW(n) \
+  v5Command(n + 0x0), v5Command(n + 0x1), v5Command(n + 0x2), v5Command(n + 0x3), \
+  v5Command(n + 0x4), v5Command(n + 0x5), v5Command(n + 0x6), v5Command(n + 0x7), \
+  v5Command(n + 0x8), v5Command(n + 0x9), v5Command(n + 0xA), v5Command(n + 0xB), \
+  v5Command(n + 0xC), v5Command(n + 0xD), v5Command(n + 0xE), v5Command(n + 0xF)
+
+static const UdpCommand V5_COMMANDS[256] PROGMEM = {
+  V5_COMMAND_ROW(0x00), V5_COMMAND_ROW(0x10), V5_COMMAND_ROW(0x20), V5_COMMAND_ROW(0x30),
+  V5_COMMAND_ROW(0x40), V5_COMMAND_ROW(0x50), V5_COMMAND_ROW(0x60), V5_COMMAND_ROW(0x70),
+  V5_COMMAND_ROW(0x80), V5_COMMAND_ROW(0x90), V5_COMMAND_ROW(0xA0), V5_COMMAND_ROW(0xB0),
+  V5_COMMAND_ROW(0xC0), V5_COMMAND_ROW(0xD0), V5_COMMAND_ROW(0xE0), V5_COMMAND_ROW(0xF0)
+};
+
+UdpCommand UdpCommands::fromV5Command(uint8_t command) {
+  UdpCommand result;
+  memcpy_P(&result, &V5_COMMANDS[command], sizeof(UdpCommand));
+  return result;
+}
+
+uint8_t UdpCommands::fromV5Argument(UdpAction action, uint8_t commandArg) {
+  if (action == UdpAction::COLOR_RAW) {
+    // UDP color is shifted by 0xC8 from 2.4 GHz color, and the spectrum is
+    // flipped (R->B->G instead of R->G->B)
+    return 0xFF-(commandArg + 0x35);
+  } else if (action == UdpAction::BRIGHTNESS) {
+    // map [2, 27] --> [0, 100]
+    return round(((commandArg - 2) / 25.0)*100);
+  }
+
+  return commandArg;
+}
+
+//================================================================================
+// V6 button tables, indexed by the command argument
+//================================================================================
+
+// See RgbwCommandIds
+static const UdpAction V6_RGBW_BUTTONS[] = {
+  UdpAction::NONE,
+  UdpAction::STATUS_ON,         // V2_RGBW_ON
+  UdpAction::STATUS_OFF,        // V2_RGBW_OFF
+  UdpAction::SPEED_DOWN,        // V2_RGBW_SPEED_DOWN
+  UdpAction::SPEED_UP,          // V2_RGBW_SPEED_UP
+  UdpAction::SET_WHITE,         // V2_RGBW_WHITE_ON
+  UdpAction::NIGHT_MODE         // V2_RGBW_NIGHT_LIGHT
+};
+
+// See CctCommandIds
+static const UdpAction V6_CCT_BUTTONS[] = {
+  UdpAction::NONE,
+  UdpAction::BRIGHTNESS_UP,     // V2_CCT_BRIGHTNESS_UP
+  UdpAction::BRIGHTNESS_DOWN,   // V2_CCT_BRIGHTNESS_DOWN
+  UdpAction::TEMPERATURE_UP,    // V2_CCT_TEMPERATURE_UP
+  UdpAction::TEMPERATURE_DOWN,  // V2_CCT_TEMPERATURE_DOWN
+  UdpAction::NONE,
+  UdpAction::NIGHT_MODE,        // V2_CCT_NIGHT_LIGHT
+  UdpAction::STATUS_ON,         // V2_CCT_ON
+  UdpAction::STATUS_OFF         // V2_CCT_OFF
+};
+
+// See RgbCommandIds
+static const UdpAction V6_RGB_BUTTONS[] = {
+  UdpAction::NONE,
+  UdpAction::BRIGHTNESS_DOWN,   // V2_RGB_BRIGHTNESS_DOWN
+  UdpAction::BRIGHTNESS_UP,     // V2_RGB_BRIGHTNESS_UP
+  UdpAction::SPEED_DOWN,        // V2_RGB_SPEED_DOWN
+  UdpAction::SPEED_UP,          // V2_RGB_SPEED_UP
+  UdpAction::PREVIOUS_MODE,     // V2_RGB_MODE_DOWN
+  UdpAction::NEXT_MODE,         // V2_RGB_MODE_UP
+  UdpAction::NONE,
+  UdpAction::NONE,
+  UdpAction::STATUS_ON,         // V2_RGB_ON
+  UdpAction::STATUS_OFF         // V2_RGB_OFF
+};
+
+// See V2CommandArgIds
+static const UdpAction V6_RGB_CCT_BUTTONS[] = {
+  UdpAction::NONE,
+  UdpAction::STATUS_ON,         // V2_RGB_CCT_ON
+  UdpAction::STATUS_OFF,        // V2_RGB_CCT_OFF
+  UdpAction::SPEED_UP,          // V2_RGB_CCT_SPEED_UP
+  UdpAction::SPEED_DOWN,        // V2_RGB_CCT_SPEED_DOWN
+  UdpAction::NIGHT_MODE         // V2_RGB_NIGHT_MODE
+};
+
+template <size_t N>
+static UdpAction lookupButton(const UdpAction (&buttons)[N], uint8_t button) {
+  return button < N ? buttons[button] : UdpAction::NONE;
+}
+
+UdpAction UdpCommands::fromV6Button(MiLightRemoteType remoteType, uint8_t button) {
+  switch (remoteType) {
+    case REMOTE_TYPE_RGBW:
+      return lookupButton(V6_RGBW_BUTTONS, button);
+    case REMOTE_TYPE_CCT:
+      return lookupButton(V6_CCT_BUTTONS, button);
+    case REMOTE_TYPE_RGB:
+      return lookupButton(V6_RGB_BUTTONS, button);
+    case REMOTE_TYPE_RGB_CCT:
+      return lookupButton(V6_RGB_CCT_BUTTONS, button);
+    default:
+      return UdpAction::NONE;
+  }
+}
+
+//================================================================================
+// Execution
+//================================================================================
+
+bool UdpCommands::execute(MiLightClient* client, UdpAction action, uint8_t arg) {
+  switch (action) {
+    case UdpAction::STATUS_ON:
+      client->updateStatus(ON);
+      break;
+    case UdpAction::STATUS_OFF:
+      client->updateStatus(OFF);
+      break;
+    case UdpAction::ALL_ON:
+      client->updateStatus(ON, 0);
+      break;
+    case UdpAction::ALL_OFF:
+      client->updateStatus(OFF, 0);
+      break;
+    case UdpAction::SET_WHITE:
+      client->updateColorWhite();
+      break;
+    case UdpAction::NIGHT_MODE:
+      client->enableNightMode();
+      break;
+    case UdpAction::COLOR_RAW:
+      client->updateColorRaw(arg);
+      break;
+    case UdpAction::BRIGHTNESS:
+      client->updateBrightness(arg);
+      break;
+    case UdpAction::MODE:
+      client->updateMode(arg);
+      break;
+    case UdpAction::NEXT_MODE:
+      client->nextMode();
+      break;
+    case UdpAction::PREVIOUS_MODE:
+      client->previousMode();
+      break;
+    case UdpAction::SPEED_UP:
+      client->modeSpeedUp();
+      break;
+    case UdpAction::SPEED_DOWN:
+      client->modeSpeedDown();
+      break;
+    case UdpAction::BRIGHTNESS_UP:
+      client->increaseBrightness();
+      break;
+    case UdpAction::BRIGHTNESS_DOWN:
+      client->decreaseBrightness();
+      break;
+    case UdpAction::TEMPERATURE_UP:
+      client->increaseTemperature();
+      break;
+    case UdpAction::TEMPERATURE_DOWN:
+      client->decreaseTemperature();
+      break;
+    default:
+      return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,121 @@
+// Decoding tables shared by the V5 and V6 UDP servers.  Both protocols boil
+// down to (remote type, action, group) tuples, which are executed against a
+// MiLightClient in one place.
+
+#include <Arduino.h>
+#include <MiLightClient.h>
+#include <MiLightRemoteType.h>
+#include <CctPacketFormatter.h>
+
+#ifndef _UDP_COMMANDS_H
+#define _UDP_COMMANDS_H
+
+enum MiLightUdpCommands {
+  UDP_CCT_ALL_ON             = 0x35,
+  UDP_CCT_ALL_OFF            = 0x39,
+  UDP_CCT_GROUP_1_ON         = 0x38,
+  UDP_CCT_GROUP_1_OFF        = 0x3B,
+  UDP_CCT_GROUP_2_ON         = 0x3D,
+  UDP_CCT_GROUP_2_OFF        = 0x33,
+  UDP_CCT_GROUP_3_ON         = 0x37,
+  UDP_CCT_GROUP_3_OFF        = 0x3A,
+  UDP_CCT_GROUP_4_ON         = 0x32,
+  UDP_CCT_GROUP_4_OFF        = 0x36,
+  UDP_CCT_TEMPERATURE_DOWN   = 0x3F,
+  UDP_CCT_TEMPERATURE_UP     = 0x3E,
+  UDP_CCT_BRIGHTNESS_DOWN    = 0x34,
+  UDP_CCT_BRIGHTNESS_UP      = 0x3C,
+  UDP_CCT_NIGHT_MODE         = 0xB9,
+
+  UDP_RGBW_ALL_OFF           = 0x41,
+  UDP_RGBW_ALL_ON            = 0x42,
+  UDP_RGBW_SPEED_UP          = 0x43,
+  UDP_RGBW_SPEED_DOWN        = 0x44,
+  UDP_RGBW_GROUP_1_ON        = 0x45,
+  UDP_RGBW_GROUP_1_OFF       = 0x46,
+  UDP_RGBW_GROUP_2_ON        = 0x47,
+  UDP_RGBW_GROUP_2_OFF       = 0x48,
+  UDP_RGBW_GROUP_3_ON        = 0x49,
+  UDP_RGBW_GROUP_3_OFF       = 0x4A,
+  UDP_RGBW_GROUP_4_ON        = 0x4B,
+  UDP_RGBW_GROUP_4_OFF       = 0x4C,
+  UDP_RGBW_DISCO_MODE        = 0x4D,
+  UDP_RGBW_GROUP_ALL_WHITE   = 0xC2,
+  UDP_RGBW_GROUP_1_WHITE     = 0xC5,
+  UDP_RGBW_GROUP_2_WHITE     = 0xC7,
+  UDP_RGBW_GROUP_3_WHITE     = 0xC9,
+  UDP_RGBW_GROUP_4_WHITE     = 0xCB,
+  UDP_RGBW_GROUP_ALL_NIGHT   = 0xC1,
+  UDP_RGBW_GROUP_1_NIGHT     = 0xC6,
+  UDP_RGBW_GROUP_2_NIGHT     = 0xC8,
+  UDP_RGBW_GROUP_3_NIGHT     = 0xCA,
+  UDP_RGBW_GROUP_4_NIGHT     = 0xCC,
+  UDP_RGBW_BRIGHTNESS        = 0x4E,
+  UDP_RGBW_COLOR             = 0x40
+};
+
+enum class UdpAction : uint8_t {
+  NONE = 0,
+  STATUS_ON,
+  STATUS_OFF,
+  // Status change for group 0, sent with the last group's remote prepared
+  ALL_ON,
+  ALL_OFF,
+  SET_WHITE,
+  NIGHT_MODE,
+  COLOR_RAW,
+  BRIGHTNESS,
+  MODE,
+  NEXT_MODE,
+  PREVIOUS_MODE,
+  SPEED_UP,
+  SPEED_DOWN,
+  BRIGHTNESS_UP,
+  BRIGHTNESS_DOWN,
+  TEMPERATURE_UP,
+  TEMPERATURE_DOWN
+};
+
+// Group value meaning "whichever group the last group-selecting command used"
+#define UDP_LAST_GROUP 0xFF
+
+struct UdpCommand {
+  constexpr UdpCommand()
+    : remoteType(REMOTE_TYPE_UNKNOWN),
+      action(UdpAction::NONE),
+      group(UDP_LAST_GROUP),
+      selectsGroup(false)
+  { }
+
+  constexpr UdpCommand(MiLightRemoteType remoteType, UdpAction action, uint8_t group, bool selectsGroup = false)
+    : remoteType(remoteType),
+      action(action),
+      group(group),
+      selectsGroup(selectsGroup)
+  { }
+
+  uint8_t remoteType;
+  UdpAction action;
+  uint8_t group;
+  // If true, group becomes the target of subsequent UDP_LAST_GROUP commands
+  bool selectsGroup;
+};
+
+namespace UdpCommands {
+  // Decodes a V5 command byte.  Backed by a 256-entry table in flash that's
+  // generated at compile time from the rules in UdpCommands.cpp.
+  UdpCommand fromV5Command(uint8_t command);
+
+  // Converts a V5 command's argument to what execute() expects for its action
+  uint8_t fromV5Argument(UdpAction action, uint8_t commandArg);
+
+  // Decodes the argument of a V6 "command" packet for a given remote type
+  // (i.e., the button pressed).  Returns UdpAction::NONE if unrecognized.
+  UdpAction fromV6Button(MiLightRemoteType remoteType, uint8_t button);
+
+  // Executes an action against the prepared remote.  Returns false if the
+  // action is NONE.
+  bool execute(MiLightClient* client, UdpAction action, uint8_t arg = 0);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <MiLightClient.h>
 #include <MiLightRadioConfig.h>
+#include <UdpCommands.h>
 
 #ifndef _V6_COMMAND_HANDLER_H
 #define _V6_COMMAND_HANDLER_H
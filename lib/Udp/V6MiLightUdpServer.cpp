@@ -73,16 +73,6 @@ uint8_t V6MiLightUdpServer::OPEN_COMMAND_RESPONSE[] = {
   0x00, 0x00, 0x34
 };
 
-V6MiLightUdpServer::~V6MiLightUdpServer() {
-  V6Session* cur = firstSession;
-
-  while (cur != NULL) {
-    V6Session* next = cur->next;
-    delete cur;
-    cur = next;
-  }
-}
-
 template <typename T>
 T V6MiLightUdpServer::readInt(uint8_t* packet) {
   size_t numBytes = sizeof(T);
@@ -107,26 +97,52 @@ uint8_t* V6MiLightUdpServer::writeInt(const T& value, uint8_t* packet) {
 }
 
 uint16_t V6MiLightUdpServer::beginSession() {
-  const uint16_t id = sessionId++;
+  const unsigned long now = millis();
+  size_t slot = 0;
+
+  // Find a free slot, or the one that's gone the longest without traffic
+  for (size_t i = 0; i < V6_MAX_SESSIONS && sessions[slot].active; i++) {
+    if (! sessions[i].active || (now - sessions[i].lastSeen) > (now - sessions[slot].lastSeen)) {
+      slot = i;
+    }
+  }
 
-  V6Session* session = new V6Session(socket.remoteIP(), socket.remotePort(), id);
-  session->next = firstSession;
-  firstSession = session;
+  // Once IDs wrap around at 2^16, skip any still held by a live session
+  uint16_t id = sessionId++;
+  while (findSessionSlot(id) != -1) {
+    id = sessionId++;
+  }
 
-  if (numSessions >= V6_MAX_SESSIONS) {
-    V6Session* cur = firstSession;
+  V6Session& session = sessions[slot];
+  session.ipAddr = socket.remoteIP();
+  session.port = socket.remotePort();
+  session.sessionId = id;
+  session.lastSeen = now;
+  session.active = true;
+
+  return id;
+}
 
-    for (size_t i = 1; i < V6_MAX_SESSIONS; i++) {
-      cur = cur->next;
+int V6MiLightUdpServer::findSessionSlot(uint16_t sessionId) {
+  for (size_t i = 0; i < V6_MAX_SESSIONS; i++) {
+    if (sessions[i].active && sessions[i].sessionId == sessionId) {
+      return i;
     }
+  }
 
-    delete cur->next;
-    cur->next = NULL;
-  } else {
-    numSessions++;
+  return -1;
+}
+
+V6Session* V6MiLightUdpServer::findSession(uint16_t sessionId) {
+  const int slot = findSessionSlot(sessionId);
+
+  if (slot == -1) {
+    return NULL;
   }
 
-  return id;
+  V6Session& session = sessions[slot];
+  session.lastSeen = millis();
+  return &session;
 }
 
 void V6MiLightUdpServer::handleSearch() {
@@ -155,16 +171,9 @@ void V6MiLightUdpServer::handleStartSession() {
 }
 
 bool V6MiLightUdpServer::sendResponse(uint16_t sessionId, uint8_t* responseBuffer, size_t responseSize) {
-  V6Session* session = firstSession;
-
-  while (session != NULL) {
-    if (session->sessionId == sessionId) {
-      break;
-    }
-    session = session->next;
-  }
+  V6Session* session = findSession(sessionId);
 
-  if (session == NULL || session->sessionId != sessionId) {
+  if (session == NULL) {
     Serial.print("Received request with untracked session ID: ");
     Serial.println(sessionId);
     return false;
@@ -13,31 +13,31 @@
 #ifndef _V6_MILIGHT_UDP_SERVER
 #define _V6_MILIGHT_UDP_SERVER
 
+// Sessions live in a fixed slot table.  A new session takes a free slot, or
+// the least recently used one.  The table is small enough that lookups just
+// scan it.
 struct V6Session {
-  V6Session(IPAddress ipAddr, uint16_t port, uint16_t sessionId)
-    : ipAddr(ipAddr),
-      port(port),
-      sessionId(sessionId),
-      next(NULL)
+  V6Session()
+    : port(0),
+      sessionId(0),
+      lastSeen(0),
+      active(false)
   { }
 
   IPAddress ipAddr;
   uint16_t port;
   uint16_t sessionId;
-  V6Session* next;
+  unsigned long lastSeen;
+  bool active;
 };
 
 class V6MiLightUdpServer : public MiLightUdpServer {
 public:
   V6MiLightUdpServer(MiLightClient*& client, uint16_t port, uint16_t deviceId)
-    : MiLightUdpServer(client, port, deviceId),
-      sessionId(0),
-      numSessions(0),
-      firstSession(NULL)
+    : MiLightUdpServer(client, port, deviceId, CommandSource::UDP_V6),
+      sessionId(0)
   { }
 
-  ~V6MiLightUdpServer();
-
   // Should return size of the response packet
   virtual void handlePacket(uint8_t* packet, size_t packetSize);
 
@@ -64,10 +64,11 @@ protected:
   static uint8_t OPEN_COMMAND_RESPONSE[];
 
   uint16_t sessionId;
-  size_t numSessions;
-  V6Session* firstSession;
+  V6Session sessions[V6_MAX_SESSIONS];
 
   uint16_t beginSession();
+  V6Session* findSession(uint16_t sessionId);
+  int findSessionSlot(uint16_t sessionId);
   bool sendResponse(uint16_t sessionId, uint8_t* responseBuffer, size_t responseSize);
   bool matchesPacket(uint8_t* packet1, size_t packet1Len, uint8_t* packet2, size_t packet2Len);
   void writeMacAddr(uint8_t* packet);
@@ -37,29 +37,7 @@ bool V6RgbCctCommandHandler::handleCommand(
   client->setHeld((command & 0x80) == 0x80);
 
   if (cmd == V2_STATUS) {
-    switch (arg) {
-      case V2_RGB_CCT_ON:
-      case V2_RGB_CCT_OFF:
-        client->updateStatus(arg == V2_RGB_CCT_ON ? ON : OFF);
-        break;
-
-      case V2_RGB_NIGHT_MODE:
-        client->enableNightMode();
-        break;
-
-      case V2_RGB_CCT_SPEED_DOWN:
-        client->modeSpeedDown();
-        break;
-
-      case V2_RGB_CCT_SPEED_UP:
-        client->modeSpeedUp();
-        break;
-
-      default:
-        return false;
-    }
-
-    return true;
+    return UdpCommands::execute(client, UdpCommands::fromV6Button(remoteConfig.type, arg));
   }
 
   switch (cmd) {
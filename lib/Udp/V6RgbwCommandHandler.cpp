@@ -29,36 +29,7 @@ bool V6RgbwCommandHandler::handleCommand(
   client->setHeld((command & 0x80) == 0x80);
 
   if (cmd == V2_RGBW_COMMAND_PREFIX) {
-    switch (arg) {
-      case V2_RGBW_ON:
-        client->updateStatus(ON);
-        break;
-
-      case V2_RGBW_OFF:
-        client->updateStatus(OFF);
-        break;
-
-      case V2_RGBW_WHITE_ON:
-        client->updateColorWhite();
-        break;
-
-      case V2_RGBW_NIGHT_LIGHT:
-        client->enableNightMode();
-        break;
-
-      case V2_RGBW_SPEED_DOWN:
-        client->modeSpeedDown();
-        break;
-
-      case V2_RGBW_SPEED_UP:
-        client->modeSpeedUp();
-        break;
-
-      default:
-        return false;
-    }
-
-    return true;
+    return UdpCommands::execute(client, UdpCommands::fromV6Button(remoteConfig.type, arg));
   } else if (cmd == V2_RGBW_COLOR_PREFIX) {
     client->updateColorRaw(arg);
     return true;
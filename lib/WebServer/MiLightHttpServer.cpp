@@ -7,6 +7,9 @@
 #include <string.h>
 #include <TokenIterator.h>
 #include <AboutHelper.h>
+#include <AllocationTracker.h>
+#include <LoopProfiler.h>
+#include <CommandLatency.h>
 #include <index.html.gz.h>
 
 using namespace std::placeholders;
@@ -71,6 +74,33 @@ void MiLightHttpServer::begin() {
     .buildHandler("/about")
     .on(HTTP_GET, std::bind(&MiLightHttpServer::handleAbout, this, _1));
 
+  server
+    .buildHandler("/heap")
+    .on(HTTP_GET, std::bind(&MiLightHttpServer::handleGetHeapStats, this, _1));
+
+  server
+    .buildHandler("/loop_stats")
+    .on(HTTP_GET, std::bind(&MiLightHttpServer::handleGetLoopStats, this, _1));
+
+  server
+    .buildHandler("/command_latency")
+    .on(HTTP_GET, std::bind(&MiLightHttpServer::handleGetCommandLatency, this, _1))
+    .on(HTTP_DELETE, std::bind(&MiLightHttpServer::handleResetCommandLatency, this, _1));
+
+  server
+    .buildHandler("/packet_log")
+    .on(HTTP_GET, std::bind(&MiLightHttpServer::handleDownloadPacketLog, this))
+    .on(HTTP_DELETE, std::bind(&MiLightHttpServer::handleClearPacketLog, this, _1));
+
+  server
+    .buildHandler("/packet_log/stats")
+    .on(HTTP_GET, std::bind(&MiLightHttpServer::handleGetPacketLogStats, this, _1));
+
+  server
+    .buildHandler("/packet_log/replay")
+    .on(HTTP_POST, std::bind(&MiLightHttpServer::handleStartPacketLogReplay, this, _1))
+    .on(HTTP_DELETE, std::bind(&MiLightHttpServer::handleStopPacketLogReplay, this, _1));
+
   server
     .buildHandler("/system")
     .on(HTTP_POST, std::bind(&MiLightHttpServer::handleSystemPost, this, _1));
@@ -115,6 +145,8 @@ void MiLightHttpServer::handleSystemPost(RequestContext& request) {
       Serial.println(F("Restarting..."));
       server.send_P(200, TEXT_PLAIN, PSTR("true"));
 
+      stateStore->saveSnapshot();
+      packetLog.flush();
       delay(100);
 
       ESP.restart();
@@ -143,9 +175,7 @@ void MiLightHttpServer::handleSystemPost(RequestContext& request) {
 }
 
 void MiLightHttpServer::serveSettings() {
-  // Save first to set defaults
-  settings.save();
-  serveFile(SETTINGS_FILE, APPLICATION_JSON);
+  server.send(200, APPLICATION_JSON, settings.toJson(false));
 }
 
 void MiLightHttpServer::onSettingsSaved(SettingsSavedHandler handler) {
@@ -156,12 +186,136 @@ void MiLightHttpServer::onGroupDeleted(GroupDeletedHandler handler) {
   this->groupDeletedHandler = handler;
 }
 
+void MiLightHttpServer::onPacketReplayed(PacketReplayedHandler handler) {
+  this->packetReplayedHandler = handler;
+}
+
 void MiLightHttpServer::handleAbout(RequestContext& request) {
   AboutHelper::generateAboutObject(request.response.json);
 
   JsonObject queueStats = request.response.json.createNestedObject("queue_stats");
   queueStats[F("length")] = packetSender->queueLength();
   queueStats[F("dropped_packets")] = packetSender->droppedPackets();
+
+  packetSender->getAdaptiveRepeats().serialize(request.response.json.createNestedObject("adaptive_repeats"));
+
+  JsonArray udpStats = request.response.json.createNestedArray("udp_stats");
+  for (size_t i = 0; i < udpServers.size(); i++) {
+    const UdpServerStats& stats = udpServers[i]->getStats();
+    JsonObject serverStats = udpStats.createNestedObject();
+
+    serverStats[F("port")] = udpServers[i]->getPort();
+    serverStats[F("device_id")] = udpServers[i]->getDeviceId();
+    serverStats[F("received")] = stats.received;
+    serverStats[F("processed")] = stats.processed;
+    serverStats[F("dropped")] = stats.dropped;
+  }
+}
+
+void MiLightHttpServer::handleGetHeapStats(RequestContext& request) {
+  AllocationTracker::serialize(request.response.json.to<JsonObject>());
+}
+
+void MiLightHttpServer::handleGetLoopStats(RequestContext& request) {
+  LoopProfiler::serialize(request.response.json.to<JsonObject>());
+}
+
+void MiLightHttpServer::handleGetCommandLatency(RequestContext& request) {
+  CommandLatency::serialize(request.response.json.to<JsonObject>());
+}
+
+void MiLightHttpServer::handleResetCommandLatency(RequestContext& request) {
+  CommandLatency::reset();
+  request.response.json[F("success")] = true;
+}
+
+void MiLightHttpServer::handleDownloadPacketLog() {
+  packetLog.flush();
+
+  if (!serveFile(packetLog.getPath(), "application/octet-stream")) {
+    server.send_P(404, TEXT_PLAIN, PSTR("Packet log is empty"));
+  }
+}
+
+void MiLightHttpServer::handleGetPacketLogStats(RequestContext& request) {
+  packetLog.serialize(request.response.json.to<JsonObject>());
+}
+
+void MiLightHttpServer::handleClearPacketLog(RequestContext& request) {
+  packetLog.clear();
+  request.response.json[F("success")] = true;
+}
+
+void MiLightHttpServer::handleStartPacketLogReplay(RequestContext& request) {
+  JsonObject requestBody = request.getJsonBody().as<JsonObject>();
+  const char* target = requestBody["target"] | "handler";
+  const float speed = requestBody["speed"] | 1.0f;
+  bool toSender;
+
+  if (strcmp(target, "sender") == 0) {
+    toSender = true;
+  } else if (strcmp(target, "handler") == 0) {
+    toSender = false;
+  } else {
+    request.response.setCode(400);
+    request.response.json["error"] = "target must be \"sender\" or \"handler\"";
+    return;
+  }
+
+  if (speed < 0) {
+    request.response.setCode(400);
+    request.response.json["error"] = "speed must not be negative";
+    return;
+  }
+
+  const bool started = packetLog.startReplay(
+    speed,
+    [this, toSender](const PacketLogEntry& entry) {
+      return replayPacket(entry, toSender);
+    }
+  );
+
+  if (!started) {
+    request.response.setCode(400);
+    request.response.json["error"] = "Packet log is empty";
+    return;
+  }
+
+  request.response.json[F("success")] = true;
+}
+
+void MiLightHttpServer::handleStopPacketLogReplay(RequestContext& request) {
+  packetLog.stopReplay();
+  request.response.json[F("success")] = true;
+}
+
+bool MiLightHttpServer::replayPacket(const PacketLogEntry& entry, bool toSender) {
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH];
+  memcpy(packet, entry.packet, MILIGHT_MAX_PACKET_LENGTH);
+
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromReceivedPacket(
+    MiLightRadioConfig::ALL_CONFIGS[entry.radioConfig],
+    packet,
+    entry.length
+  );
+
+  // Noise the radio picked up.  Nothing to replay.
+  if (remoteConfig == NULL) {
+    return true;
+  }
+
+  if (toSender) {
+    // Wait for room rather than have the queue drop packets
+    if (packetSender->queueLength() >= MILIGHT_MAX_QUEUED_PACKETS) {
+      return false;
+    }
+
+    packetSender->enqueue(packet, remoteConfig);
+  } else if (packetReplayedHandler) {
+    packetReplayedHandler(packet, *remoteConfig);
+  }
+
+  return true;
 }
 
 void MiLightHttpServer::handleGetRadioConfigs(RequestContext& request) {
@@ -215,7 +369,13 @@ void MiLightHttpServer::handleUpdateSettings(RequestContext& request) {
 }
 
 void MiLightHttpServer::handleUpdateSettingsPost(RequestContext& request) {
-  Settings::load(settings);
+  // The upload handler leaves the posted file in SETTINGS_FILE
+  if (! Settings::importJson(settings)) {
+    request.response.json["success"] = false;
+    request.response.json["error"] = "Could not parse settings file";
+    request.response.setCode(400);
+    return;
+  }
 
   if (this->settingsSavedHandler) {
     this->settingsSavedHandler();
@@ -242,6 +402,7 @@ void MiLightHttpServer::handleFirmwarePost() {
     );
   }
 
+  stateStore->saveSnapshot();
   delay(1000);
 
   ESP.restart();
@@ -291,7 +452,7 @@ void MiLightHttpServer::handleListenGateway(RequestContext& request) {
   }
 
   if (tmpRemoteConfig != NULL) {
-    radio = radios->switchRadio(tmpRemoteConfig);
+    radio = radios->switchListenRadio(tmpRemoteConfig);
   }
 
   while (remoteConfig == NULL) {
@@ -300,7 +461,7 @@ void MiLightHttpServer::handleListenGateway(RequestContext& request) {
     }
 
     if (listenAll) {
-      radio = radios->switchRadio(configIx++ % radios->getNumRadios());
+      radio = radios->switchListenRadio(configIx++ % radios->getNumRadios());
     } else {
       radio->configure();
     }
@@ -432,6 +593,8 @@ void MiLightHttpServer::_handleDeleteGroup(BulbId bulbId, RequestContext& reques
 }
 
 void MiLightHttpServer::handleUpdateGroupAlias(RequestContext& request) {
+  milightClient->stampCommand(CommandSource::HTTP);
+
   const String alias = request.pathVariables.get("device_alias");
 
   std::map<String, BulbId>::iterator it = settings.groupIdAliases.find(alias);
@@ -459,6 +622,9 @@ void MiLightHttpServer::handleUpdateGroupAlias(RequestContext& request) {
 }
 
 void MiLightHttpServer::handleUpdateGroup(RequestContext& request) {
+  // Each group's update uses up the stamp
+  const CommandStamp stamp(CommandSource::HTTP);
+
   JsonObject reqObj = request.getJsonBody().as<JsonObject>();
 
   String _deviceIds = request.pathVariables.get(GroupStateFieldNames::DEVICE_ID);
@@ -498,6 +664,7 @@ void MiLightHttpServer::handleUpdateGroup(RequestContext& request) {
       while (groupIdItr.hasNext()) {
         const uint8_t groupId = atoi(groupIdItr.nextToken());
 
+        milightClient->stampCommand(stamp);
         milightClient->prepare(config, deviceId, groupId);
         handleRequest(reqObj);
         foundBulbId = BulbId(deviceId, groupId, config->type);
@@ -514,14 +681,18 @@ void MiLightHttpServer::handleUpdateGroup(RequestContext& request) {
 }
 
 void MiLightHttpServer::handleRequest(const JsonObject& request) {
-  milightClient->setRepeatsOverride(
-    settings.httpRepeatFactor * settings.packetRepeats
-  );
+  // With adaptive repeats, only force a count when the factor asks for extra
+  if (! settings.adaptivePacketRepeats || settings.httpRepeatFactor != 1) {
+    milightClient->setRepeatsOverride(
+      settings.httpRepeatFactor * settings.packetRepeats
+    );
+  }
   milightClient->update(request);
   milightClient->clearRepeatsOverride();
 }
 
 void MiLightHttpServer::handleSendRaw(RequestContext& request) {
+  const CommandStamp stamp(CommandSource::HTTP);
   JsonObject requestBody = request.getJsonBody().as<JsonObject>();
   const MiLightRemoteConfig* config = MiLightRemoteConfig::fromType(request.pathVariables.get("type"));
 
@@ -542,7 +713,7 @@ void MiLightHttpServer::handleSendRaw(RequestContext& request) {
     numRepeats = requestBody["num_repeats"];
   }
 
-  packetSender->enqueue(packet, config, numRepeats);
+  packetSender->enqueue(packet, config, numRepeats, QueuedPacket::UNKNOWN_DEVICE, stamp);
 
   // To make this response synchronous, wait for packet to be flushed
   while (packetSender->isSending()) {
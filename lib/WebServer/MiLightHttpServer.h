@@ -6,6 +6,11 @@
 #include <RadioSwitchboard.h>
 #include <PacketSender.h>
 #include <TransitionController.h>
+#include <MiLightUdpServer.h>
+#include <PacketLog.h>
+
+#include <vector>
+#include <memory>
 
 #ifndef _MILIGHT_HTTP_SERVER
 #define _MILIGHT_HTTP_SERVER
@@ -14,6 +19,7 @@
 
 typedef std::function<void(void)> SettingsSavedHandler;
 typedef std::function<void(const BulbId& id)> GroupDeletedHandler;
+typedef std::function<void(uint8_t* packet, const MiLightRemoteConfig& config)> PacketReplayedHandler;
 
 using RichHttpConfig = RichHttp::Generics::Configs::EspressifBuiltin;
 using RequestContext = RichHttpConfig::RequestContextType;
@@ -29,7 +35,9 @@ public:
     GroupStateStore*& stateStore,
     PacketSender*& packetSender,
     RadioSwitchboard*& radios,
-    TransitionController& transitions
+    TransitionController& transitions,
+    std::vector<std::shared_ptr<MiLightUdpServer>>& udpServers,
+    PacketLog& packetLog
   )
     : authProvider(settings)
     , server(80, authProvider)
@@ -41,12 +49,16 @@ public:
     , packetSender(packetSender)
     , radios(radios)
     , transitions(transitions)
+    , udpServers(udpServers)
+    , packetLog(packetLog)
   { }
 
   void begin();
   void handleClient();
   void onSettingsSaved(SettingsSavedHandler handler);
   void onGroupDeleted(GroupDeletedHandler handler);
+  // Packets replayed from the packet log with "target": "handler" go here
+  void onPacketReplayed(PacketReplayedHandler handler);
   void on(const char* path, HTTPMethod method, ESP8266WebServer::THandlerFunction handler);
   void handlePacketSent(uint8_t* packet, const MiLightRemoteConfig& config);
   WiFiClient client();
@@ -65,6 +77,16 @@ protected:
   void handleGetRadioConfigs(RequestContext& request);
 
   void handleAbout(RequestContext& request);
+  void handleGetHeapStats(RequestContext& request);
+  void handleGetLoopStats(RequestContext& request);
+  void handleGetCommandLatency(RequestContext& request);
+  void handleResetCommandLatency(RequestContext& request);
+  void handleDownloadPacketLog();
+  void handleGetPacketLogStats(RequestContext& request);
+  void handleClearPacketLog(RequestContext& request);
+  void handleStartPacketLogReplay(RequestContext& request);
+  void handleStopPacketLogReplay(RequestContext& request);
+  bool replayPacket(const PacketLogEntry& entry, bool toSender);
   void handleSystemPost(RequestContext& request);
   void handleFirmwareUpload();
   void handleFirmwarePost();
@@ -101,10 +123,13 @@ protected:
   GroupStateStore*& stateStore;
   SettingsSavedHandler settingsSavedHandler;
   GroupDeletedHandler groupDeletedHandler;
+  PacketReplayedHandler packetReplayedHandler;
   ESP8266WebServer::THandlerFunction _handleRootPage;
   PacketSender*& packetSender;
   RadioSwitchboard*& radios;
   TransitionController& transitions;
+  std::vector<std::shared_ptr<MiLightUdpServer>>& udpServers;
+  PacketLog& packetLog;
 
 };
 
@@ -19,7 +19,6 @@
 #include <ESP8266mDNS.h>
 #include <ESP8266SSDP.h>
 #include <MqttClient.h>
-#include <RGBConverter.h>
 #include <MiLightDiscoveryServer.h>
 #include <MiLightClient.h>
 #include <BulbStateUpdater.h>
@@ -27,6 +26,10 @@
 #include <PacketSender.h>
 #include <HomeAssistantDiscoveryClient.h>
 #include <TransitionController.h>
+#include <AllocationTracker.h>
+#include <LoopProfiler.h>
+#include <LoopScheduler.h>
+#include <PacketLog.h>
 
 #include <vector>
 #include <memory>
@@ -40,14 +43,17 @@ WiFiManagerParameter* wifiStaticIPGateway = NULL;
 static LEDStatus *ledStatus;
 
 Settings settings;
+// What applySettings last acted on, to work out what changed
+Settings* appliedSettings = NULL;
 
 MiLightClient* milightClient = NULL;
 RadioSwitchboard* radios = nullptr;
 PacketSender* packetSender = nullptr;
-std::shared_ptr<MiLightRadioFactory> radioFactory;
+std::vector<std::shared_ptr<MiLightRadioFactory>> radioFactories;
 MiLightHttpServer *httpServer = NULL;
 MqttClient* mqttClient = NULL;
 MiLightDiscoveryServer* discoveryServer = NULL;
+HomeAssistantDiscoveryClient* homeAssistantDiscovery = NULL;
 uint8_t currentRadioType = 0;
 
 // For tracking and managing group state
@@ -55,6 +61,9 @@ GroupStateStore* stateStore = NULL;
 BulbStateUpdater* bulbStateUpdater = NULL;
 TransitionController transitions;
 
+LoopScheduler scheduler;
+PacketLog packetLog;
+
 int numUdpServers = 0;
 std::vector<std::shared_ptr<MiLightUdpServer>> udpServers;
 WiFiUDP udpSeder;
@@ -92,9 +101,7 @@ void initMilightUdpServers() {
  * is read.
  */
 void onPacketSentHandler(uint8_t* packet, const MiLightRemoteConfig& config) {
-  StaticJsonDocument<200> buffer;
-  JsonObject result = buffer.to<JsonObject>();
-
+  ParsedPacket result;
   BulbId bulbId = config.packetFormatter->parsePacket(packet, result);
 
   // set LED mode for a packet movement
@@ -122,9 +129,14 @@ void onPacketSentHandler(uint8_t* packet, const MiLightRemoteConfig& config) {
   }
 
   if (mqttClient) {
-    // Sends the state delta derived from the raw packet
+    // Sends the state delta derived from the raw packet.  Only MQTT needs it
+    // as JSON, so it's built here rather than up front.
+    StaticJsonDocument<200> buffer;
+    JsonObject json = buffer.to<JsonObject>();
+    result.serialize(json);
+
     char output[200];
-    serializeJson(result, output);
+    serializeJson(json, output);
     mqttClient->sendUpdate(remoteConfig, bulbId.deviceId, bulbId.groupId, output);
 
     // Sends the entire state
@@ -136,6 +148,20 @@ void onPacketSentHandler(uint8_t* packet, const MiLightRemoteConfig& config) {
   httpServer->handlePacketSent(packet, remoteConfig);
 }
 
+/**
+ * Called by PacketSender once a packet has been sent.  Logs it before
+ * handling it like any other.
+ */
+void onPacketSent(uint8_t* packet, const MiLightRemoteConfig& config) {
+  packetLog.record(
+    PacketDirection::SENT,
+    config.radioConfig,
+    packet,
+    config.packetFormatter->getPacketLength()
+  );
+  onPacketSentHandler(packet, config);
+}
+
 /**
  * Listen for packets on one radio config.  Cycles through all configs as its
  * called.
@@ -143,18 +169,30 @@ void onPacketSentHandler(uint8_t* packet, const MiLightRemoteConfig& config) {
 void handleListen() {
   // Do not handle listens while there are packets enqueued to be sent
   // Doing so causes the radio module to need to be reinitialized inbetween
-  // repeats, which slows things down.
-  if (! settings.listenRepeats || packetSender->isSending()) {
+  // repeats, which slows things down.  Not a concern if there's a second
+  // radio module to listen with.
+  if (! settings.listenRepeats || (packetSender->isSending() && ! radios->canListenWhileSending())) {
     return;
   }
 
-  std::shared_ptr<MiLightRadio> radio = radios->switchRadio(currentRadioType++ % radios->getNumRadios());
+  // Usually the radio left tuned in last time, so whatever it caught while we
+  // were away (including our own packets) is still waiting to be read
+  std::shared_ptr<MiLightRadio> radio = radios->switchListenRadio(currentRadioType++ % radios->getNumRadios());
 
   for (size_t i = 0; i < settings.listenRepeats; i++) {
     if (radios->available()) {
       uint8_t readPacket[MILIGHT_MAX_PACKET_LENGTH];
       size_t packetLen = radios->read(readPacket);
 
+      // A second module hears everything the first one sends.  Those were
+      // already handled when they were sent.
+      if (packetSender->isEcho(radio->config(), readPacket, packetLen)) {
+        continue;
+      }
+
+      // Logged before it's recognized so replays see exactly what was heard
+      packetLog.record(PacketDirection::RECEIVED, radio->config(), readPacket, packetLen);
+
       const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromReceivedPacket(
         radio->config(),
         readPacket,
@@ -166,13 +204,16 @@ void handleListen() {
 #ifdef DEBUG_PRINTF
         Serial.println(F("WARNING: Couldn't find remote for received packet"));
 #endif
-        return;
+        break;
       }
 
       // update state to reflect this packet
       onPacketSentHandler(readPacket, *remoteConfig);
     }
   }
+
+  // Stay tuned to the next config until we're back
+  radios->switchListenRadio(currentRadioType % radios->getNumRadios());
 }
 
 /**
@@ -196,101 +237,162 @@ void onUpdateEnd() {
 }
 
 /**
- * Apply what's in the Settings object.
+ * Apply what's in the Settings object.  Only rebuilds the parts of the hub
+ * whose settings changed since the last time this was called.
  */
 void applySettings() {
-  if (milightClient) {
+  const uint16_t changed = appliedSettings
+    ? settings.changedSubsystems(*appliedSettings)
+    : SUBSYSTEM_ALL;
+
+  // Sender and client hold on to the switchboard, so they go with it.  Queued
+  // packets are handed over to the new sender.
+  PacketSender* previousSender = NULL;
+
+  if ((changed & SUBSYSTEM_RADIOS) && radios) {
     delete milightClient;
+    milightClient = NULL;
+
+    previousSender = packetSender;
+    packetSender = NULL;
+
+    delete radios;
+    radios = NULL;
   }
-  if (mqttClient) {
+  if ((changed & SUBSYSTEM_MQTT) && mqttClient) {
     delete mqttClient;
     delete bulbStateUpdater;
 
     mqttClient = NULL;
     bulbStateUpdater = NULL;
   }
-  if (stateStore) {
-    delete stateStore;
-  }
-  if (packetSender) {
-    delete packetSender;
-  }
-  if (radios) {
-    delete radios;
-  }
 
   transitions.setDefaultPeriod(settings.defaultTransitionPeriod);
+  LoopProfiler::setBudgets(settings.loopStageBudgets);
+  packetLog.setCapacity(settings.packetLogSize);
+
+  if (stateStore == NULL) {
+    stateStore = new GroupStateStore(MILIGHT_MAX_STATE_ITEMS, settings.stateFlushInterval);
+
+    unsigned long snapshotStart = millis();
+    size_t warmStates = stateStore->loadSnapshot();
+    Serial.printf_P(
+      PSTR("Loaded %u group states from snapshot in %lums\n"),
+      warmStates,
+      millis() - snapshotStart
+    );
+  } else if (changed & SUBSYSTEM_STATE_STORE) {
+    stateStore->setFlushRate(settings.stateFlushInterval);
+  }
+
+  if (radios == NULL) {
+    radioFactories = MiLightRadioFactory::allFromSettings(settings);
 
-  radioFactory = MiLightRadioFactory::fromSettings(settings);
+    if (radioFactories.empty()) {
+      Serial.println(F("ERROR: unable to construct radio factory"));
+    }
 
-  if (radioFactory == NULL) {
-    Serial.println(F("ERROR: unable to construct radio factory"));
+    radios = new RadioSwitchboard(radioFactories, stateStore, settings);
   }
 
-  stateStore = new GroupStateStore(MILIGHT_MAX_STATE_ITEMS, settings.stateFlushInterval);
+  if (packetSender == NULL) {
+    packetSender = new PacketSender(*radios, settings, onPacketSent);
 
-  radios = new RadioSwitchboard(radioFactory, stateStore, settings);
-  packetSender = new PacketSender(*radios, settings, onPacketSentHandler);
+    if (previousSender) {
+      packetSender->adoptPackets(*previousSender);
+      delete previousSender;
+    }
+  } else if (changed & SUBSYSTEM_PACKET_SENDER) {
+    packetSender->reloadSettings();
+  }
 
-  milightClient = new MiLightClient(
-    *radios,
-    *packetSender,
-    stateStore,
-    settings,
-    transitions
-  );
-  milightClient->onUpdateBegin(onUpdateBegin);
-  milightClient->onUpdateEnd(onUpdateEnd);
+  if (milightClient == NULL) {
+    milightClient = new MiLightClient(
+      *radios,
+      *packetSender,
+      stateStore,
+      settings,
+      transitions
+    );
+    milightClient->onUpdateBegin(onUpdateBegin);
+    milightClient->onUpdateEnd(onUpdateEnd);
+  }
+
+  // Outlives the MQTT client so it remembers what's been published across
+  // reconnects
+  if (homeAssistantDiscovery == NULL) {
+    homeAssistantDiscovery = new HomeAssistantDiscoveryClient(settings, mqttClient);
+  }
+
+  // What was published to another broker or under another prefix isn't there
+  if (appliedSettings
+    && (settings._mqttServer != appliedSettings->_mqttServer
+      || settings.homeAssistantDiscoveryPrefix != appliedSettings->homeAssistantDiscoveryPrefix)) {
+    homeAssistantDiscovery->forgetPublished();
+  }
 
-  if (settings.mqttServer().length() > 0) {
+  if (mqttClient == NULL && settings.mqttServer().length() > 0) {
     mqttClient = new MqttClient(settings, milightClient);
     mqttClient->begin();
     mqttClient->onConnect([]() {
+      // Published a few at a time from loop()
       if (settings.homeAssistantDiscoveryPrefix.length() > 0) {
-        HomeAssistantDiscoveryClient discoveryClient(settings, mqttClient);
-        discoveryClient.sendDiscoverableDevices(settings.groupIdAliases);
-        discoveryClient.removeOldDevices(settings.deletedGroupIdAliases);
-
-        settings.deletedGroupIdAliases.clear();
+        homeAssistantDiscovery->start();
       }
     });
 
     bulbStateUpdater = new BulbStateUpdater(settings, *mqttClient, *stateStore);
+  } else if (mqttClient && (changed & SUBSYSTEM_HOME_ASSISTANT)
+    && settings.homeAssistantDiscoveryPrefix.length() > 0) {
+    // Still connected, so the connect handler won't pick up the new aliases
+    homeAssistantDiscovery->start();
   }
 
-  initMilightUdpServers();
-
-  if (discoveryServer) {
-    delete discoveryServer;
-    discoveryServer = NULL;
+  if (changed & SUBSYSTEM_UDP) {
+    initMilightUdpServers();
   }
-  if (settings.discoveryPort != 0) {
-    discoveryServer = new MiLightDiscoveryServer(settings);
-    discoveryServer->begin();
+
+  if (changed & SUBSYSTEM_DISCOVERY) {
+    if (discoveryServer) {
+      delete discoveryServer;
+      discoveryServer = NULL;
+    }
+    if (settings.discoveryPort != 0) {
+      discoveryServer = new MiLightDiscoveryServer(settings);
+      discoveryServer->begin();
+    }
   }
 
   // update LED pin and operating mode
-  if (ledStatus) {
+  if (ledStatus && (changed & SUBSYSTEM_LED)) {
     ledStatus->changePin(settings.ledPin);
     ledStatus->continuous(settings.ledModeOperating);
   }
 
-  WiFi.hostname(settings.hostname);
-
-  WiFiPhyMode_t wifiMode;
-  switch (settings.wifiMode) {
-    case WifiMode::B:
-      wifiMode = WIFI_PHY_MODE_11B;
-      break;
-    case WifiMode::G:
-      wifiMode = WIFI_PHY_MODE_11G;
-      break;
-    default:
-    case WifiMode::N:
-      wifiMode = WIFI_PHY_MODE_11N;
-      break;
+  if (changed & SUBSYSTEM_WIFI) {
+    WiFi.hostname(settings.hostname);
+
+    WiFiPhyMode_t wifiMode;
+    switch (settings.wifiMode) {
+      case WifiMode::B:
+        wifiMode = WIFI_PHY_MODE_11B;
+        break;
+      case WifiMode::G:
+        wifiMode = WIFI_PHY_MODE_11G;
+        break;
+      default:
+      case WifiMode::N:
+        wifiMode = WIFI_PHY_MODE_11N;
+        break;
+    }
+    WiFi.setPhyMode(wifiMode);
+  }
+
+  if (appliedSettings) {
+    *appliedSettings = settings;
+  } else {
+    appliedSettings = new Settings(settings);
   }
-  WiFi.setPhyMode(wifiMode);
 }
 
 /**
@@ -421,9 +523,10 @@ void setup() {
   SSDP.setDeviceType("upnp:rootdevice");
   SSDP.begin();
 
-  httpServer = new MiLightHttpServer(settings, milightClient, stateStore, packetSender, radios, transitions);
+  httpServer = new MiLightHttpServer(settings, milightClient, stateStore, packetSender, radios, transitions, udpServers, packetLog);
   httpServer->onSettingsSaved(applySettings);
   httpServer->onGroupDeleted(onGroupDeleted);
+  httpServer->onPacketReplayed(onPacketSentHandler);
   httpServer->on("/description.xml", HTTP_GET, []() { SSDP.schema(httpServer->client()); });
   httpServer->begin();
 
@@ -434,42 +537,69 @@ void setup() {
       const char* fieldName = GroupStateFieldHelpers::getFieldName(field);
       buffer[fieldName] = value;
 
+      milightClient->stampCommand(CommandSource::TRANSITION);
       milightClient->prepare(bulbId.deviceType, bulbId.deviceId, bulbId.groupId);
       milightClient->update(buffer.as<JsonObject>());
     }
   );
 
+  // Tasks look up the globals each time they run, so they keep working when
+  // applySettings rebuilds things
+  scheduler.addTask(LoopStage::PACKET_SENDER, LoopTaskPriority::CRITICAL, 0, []() {
+    packetSender->loop();
+  });
+  scheduler.addTask(LoopStage::LISTEN, LoopTaskPriority::CRITICAL, 0, handleListen);
+  scheduler.addTask(LoopStage::MQTT, LoopTaskPriority::URGENT, 0, []() {
+    if (mqttClient) {
+      mqttClient->handleClient();
+      bulbStateUpdater->loop();
+    }
+  });
+  scheduler.addTask(LoopStage::TRANSITIONS, LoopTaskPriority::URGENT, 0, []() {
+    transitions.loop();
+  });
+  scheduler.addTask(LoopStage::HTTP, LoopTaskPriority::NORMAL, 0, []() {
+    httpServer->handleClient();
+  });
+  scheduler.addTask(LoopStage::UDP, LoopTaskPriority::NORMAL, 0, []() {
+    for (size_t i = 0; i < udpServers.size(); i++) {
+      udpServers[i]->handleClient();
+    }
+  });
+  scheduler.addTask(LoopStage::HA_DISCOVERY, LoopTaskPriority::BACKGROUND, 0, []() {
+    if (mqttClient) {
+      homeAssistantDiscovery->loop();
+    }
+  });
+  // Nobody is waiting on a discovery reply to the millisecond
+  scheduler.addTask(LoopStage::DISCOVERY, LoopTaskPriority::BACKGROUND, 50, []() {
+    if (discoveryServer) {
+      discoveryServer->handleClient();
+    }
+  });
+  scheduler.addTask(LoopStage::STATE_FLUSH, LoopTaskPriority::BACKGROUND, 0, []() {
+    stateStore->limitedFlush();
+  });
+  scheduler.addTask(LoopStage::LED, LoopTaskPriority::BACKGROUND, 0, []() {
+    ledStatus->handle();
+  });
+  scheduler.addTask(LoopStage::PACKET_LOG, LoopTaskPriority::BACKGROUND, 0, []() {
+    packetLog.loop();
+  });
+
   Serial.printf_P(PSTR("Setup complete (version %s)\n"), QUOTE(MILIGHT_HUB_VERSION));
 }
 
 void loop() {
-  httpServer->handleClient();
-
-  if (mqttClient) {
-    mqttClient->handleClient();
-    bulbStateUpdater->loop();
-  }
-
-  for (size_t i = 0; i < udpServers.size(); i++) {
-    udpServers[i]->handleClient();
-  }
-
-  if (discoveryServer) {
-    discoveryServer->handleClient();
-  }
-
-  handleListen();
-
-  stateStore->limitedFlush();
-  packetSender->loop();
-
-  // update LED with status
-  ledStatus->handle();
+  LoopProfiler::beginLoop();
+  scheduler.loop();
 
-  transitions.loop();
+  TRACK_HEAP();
 
   if (shouldRestart()) {
     Serial.println(F("Auto-restart triggered. Restarting..."));
+    stateStore->saveSnapshot();
+    packetLog.flush();
     ESP.restart();
   }
 }
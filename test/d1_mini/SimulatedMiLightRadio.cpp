@@ -0,0 +1,130 @@
+#include "SimulatedMiLightRadio.h"
+
+const SimulatedRadioTiming SimulatedRadioTiming::NRF24 = {
+  .spiOverheadMicros = 10,
+  .spiMicrosPerByte = 1,
+  .settleMicros = 130,
+  .airMicrosPerByte = 8,
+  // Preamble (1), address (5), length (1), CRC (2)
+  .frameOverheadBytes = 9,
+  // Syncword and payload width
+  .configureMicros = 60,
+  .channelSwitchMicros = 40
+};
+
+const SimulatedRadioTiming SimulatedRadioTiming::LT8900 = {
+  .spiOverheadMicros = 10,
+  .spiMicrosPerByte = 2,
+  .settleMicros = DEFAULT_TIME_BETWEEN_RETRANSMISSIONS_uS,
+  .airMicrosPerByte = 8,
+  // Preamble (1), syncword (4), trailer, length (1), CRC (2)
+  .frameOverheadBytes = 9,
+  .configureMicros = 100,
+  .channelSwitchMicros = 20
+};
+
+SimulatedMiLightRadio::SimulatedMiLightRadio(
+  const MiLightRadioConfig& config,
+  const SimulatedRadioTiming& timing,
+  uint8_t numChannels,
+  WriteHandler writeHandler
+) : _config(config)
+  , timing(timing)
+  , numChannels(numChannels)
+  , writeHandler(writeHandler)
+  , lastFrameLength(0)
+  , framesSent(0)
+  , airMicros(0)
+{ }
+
+int SimulatedMiLightRadio::begin() {
+  return configure();
+}
+
+int SimulatedMiLightRadio::configure() {
+  delayMicroseconds(timing.configureMicros);
+  return 0;
+}
+
+bool SimulatedMiLightRadio::available() {
+  return !heardFrames.empty();
+}
+
+int SimulatedMiLightRadio::read(uint8_t frame[], size_t &frame_length) {
+  if (heardFrames.empty()) {
+    frame_length = 0;
+    return -1;
+  }
+
+  const std::vector<uint8_t>& heard = heardFrames.front();
+  frame_length = heard.size();
+  memcpy(frame, heard.data(), frame_length);
+  heardFrames.pop_front();
+
+  return 0;
+}
+
+void SimulatedMiLightRadio::hear(const uint8_t* frame, size_t length) {
+  heardFrames.push_back(std::vector<uint8_t>(frame, frame + length));
+}
+
+uint32_t SimulatedMiLightRadio::frameCostMicros(size_t frameLength) const {
+  const uint32_t spi = timing.spiOverheadMicros + (frameLength + 1) * timing.spiMicrosPerByte;
+  const uint32_t air = timing.settleMicros + (frameLength + timing.frameOverheadBytes) * timing.airMicrosPerByte;
+
+  return numChannels * (timing.channelSwitchMicros + spi + air);
+}
+
+int SimulatedMiLightRadio::write(uint8_t frame[], size_t frame_length) {
+  if (frame_length > MILIGHT_MAX_PACKET_LENGTH) {
+    return -1;
+  }
+
+  lastFrameLength = frame_length;
+
+  if (writeHandler) {
+    writeHandler(frame, frame_length);
+  }
+
+  int retval = resend();
+  if (retval < 0) {
+    return retval;
+  }
+  return frame_length;
+}
+
+int SimulatedMiLightRadio::resend() {
+  const uint32_t cost = frameCostMicros(lastFrameLength);
+
+  delayMicroseconds(cost);
+
+  ++framesSent;
+  airMicros += numChannels * (timing.settleMicros + (lastFrameLength + timing.frameOverheadBytes) * timing.airMicrosPerByte);
+
+  return 0;
+}
+
+const MiLightRadioConfig& SimulatedMiLightRadio::config() {
+  return _config;
+}
+
+size_t SimulatedMiLightRadio::getFramesSent() const {
+  return framesSent;
+}
+
+uint32_t SimulatedMiLightRadio::getAirMicros() const {
+  return airMicros;
+}
+
+SimulatedRadioFactory::SimulatedRadioFactory(const SimulatedRadioTiming& timing, uint8_t numChannels)
+  : timing(timing)
+  , numChannels(numChannels)
+{ }
+
+std::shared_ptr<MiLightRadio> SimulatedRadioFactory::create(const MiLightRadioConfig& config) {
+  return std::make_shared<SimulatedMiLightRadio>(config, timing, numChannels, writeHandler);
+}
+
+void SimulatedRadioFactory::onWrite(SimulatedMiLightRadio::WriteHandler handler) {
+  this->writeHandler = handler;
+}
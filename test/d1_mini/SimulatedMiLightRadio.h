@@ -0,0 +1,88 @@
+#include <Arduino.h>
+#include <MiLightRadio.h>
+#include <MiLightRadioConfig.h>
+#include <MiLightRadioFactory.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#ifndef _SIMULATED_MILIGHT_RADIO_H
+#define _SIMULATED_MILIGHT_RADIO_H
+
+// Cost model for a radio.  Writes block for as long as the real hardware would,
+// so anything driving a simulated radio sees realistic throughput.
+struct SimulatedRadioTiming {
+  // Fixed cost per SPI transaction and per byte clocked over SPI
+  uint16_t spiOverheadMicros;
+  uint16_t spiMicrosPerByte;
+  // Time from "go" to the first bit on air
+  uint16_t settleMicros;
+  uint16_t airMicrosPerByte;
+  // Bytes sent on air in addition to the packet (preamble, syncword, length, CRC)
+  uint8_t frameOverheadBytes;
+  // Reprogramming for a different syncword / channel
+  uint16_t configureMicros;
+  uint16_t channelSwitchMicros;
+
+  // nRF24 at 1Mbps with 130us TX settling.  Syncword is the 5 byte address.
+  static const SimulatedRadioTiming NRF24;
+  // LT8900 at 1Mbps, including the gap this repo leaves between retransmissions
+  static const SimulatedRadioTiming LT8900;
+};
+
+class SimulatedMiLightRadio : public MiLightRadio {
+public:
+  // Called with each frame as it's written
+  typedef std::function<void(const uint8_t* frame, size_t length)> WriteHandler;
+
+  SimulatedMiLightRadio(
+    const MiLightRadioConfig& config,
+    const SimulatedRadioTiming& timing,
+    uint8_t numChannels,
+    WriteHandler writeHandler = nullptr
+  );
+
+  virtual int begin();
+  virtual bool available();
+  virtual int read(uint8_t frame[], size_t &frame_length);
+  virtual int write(uint8_t frame[], size_t frame_length);
+  virtual int resend();
+  virtual int configure();
+  virtual const MiLightRadioConfig& config();
+
+  // Cost of one write() across all channels
+  uint32_t frameCostMicros(size_t frameLength) const;
+
+  size_t getFramesSent() const;
+  uint32_t getAirMicros() const;
+
+  // Queues a frame for read(), as if it had been heard on air
+  void hear(const uint8_t* frame, size_t length);
+
+private:
+  const MiLightRadioConfig& _config;
+  const SimulatedRadioTiming& timing;
+  const uint8_t numChannels;
+  WriteHandler writeHandler;
+  size_t lastFrameLength;
+  size_t framesSent;
+  uint32_t airMicros;
+  std::deque<std::vector<uint8_t>> heardFrames;
+};
+
+class SimulatedRadioFactory : public MiLightRadioFactory {
+public:
+  SimulatedRadioFactory(const SimulatedRadioTiming& timing, uint8_t numChannels = MiLightRadioConfig::NUM_CHANNELS);
+
+  virtual std::shared_ptr<MiLightRadio> create(const MiLightRadioConfig& config);
+
+  // Applies to radios created afterwards
+  void onWrite(SimulatedMiLightRadio::WriteHandler handler);
+
+protected:
+  const SimulatedRadioTiming& timing;
+  const uint8_t numChannels;
+  SimulatedMiLightRadio::WriteHandler writeHandler;
+};
+
+#endif
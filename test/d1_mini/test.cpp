@@ -10,7 +10,30 @@
 
 #include <RgbCctPacketFormatter.h>
 #include <FUT091PacketFormatter.h>
+#include <CctPacketFormatter.h>
+#include <MiLightRemoteConfig.h>
 #include <Units.h>
+#include <Size.h>
+#include <UdpCommands.h>
+#include <ColorConverter.h>
+#include <RGBConverter.h>
+#include <HsvColorTransition.h>
+#include <PacketSender.h>
+#include <MiLightClient.h>
+#include <MiLightCommands.h>
+#include <TransitionController.h>
+#include <RadioSwitchboard.h>
+#include "SimulatedMiLightRadio.h"
+#include <AdaptiveRepeats.h>
+#include <LoopProfiler.h>
+#include <LoopScheduler.h>
+#include <PacketLog.h>
+#include <SettingsBlob.h>
+#include <algorithm>
+#include <V6RgbwCommandHandler.h>
+#include <V6CctCommandHandler.h>
+#include <V6RgbCommandHandler.h>
+#include <V6RgbCctCommandHandler.h>
 
 #include "unity.h"
 
@@ -99,6 +122,178 @@ void test_fut091_packet_formatter() {
   );
 }
 
+// The linear scan fromReceivedPacket used to do
+const MiLightRemoteConfig* classify_by_scan(const MiLightRadioConfig& radioConfig, const uint8_t* packet, size_t len) {
+  for (size_t i = 0; i < MiLightRemoteConfig::NUM_REMOTES; i++) {
+    const MiLightRemoteConfig* config = MiLightRemoteConfig::ALL_REMOTES[i];
+
+    if (&config->radioConfig == &radioConfig && config->packetFormatter->canHandle(packet, len)) {
+      return config;
+    }
+  }
+
+  return NULL;
+}
+
+struct ReceivedPacket {
+  const MiLightRadioConfig* radioConfig;
+  const MiLightRemoteConfig* expected;
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH];
+  size_t length;
+};
+
+void test_received_packet_classifier() {
+  RgbwPacketFormatter rgbw;
+  CctPacketFormatter cct;
+  RgbCctPacketFormatter rgbCct;
+  RgbPacketFormatter rgb;
+  FUT089PacketFormatter fut089;
+  FUT091PacketFormatter fut091;
+  FUT020PacketFormatter fut020;
+
+  // Same order as MiLightRemoteConfig::ALL_REMOTES
+  PacketFormatter* formatters[] = { &rgbw, &cct, &rgbCct, &rgb, &fut089, &fut091, &fut020 };
+  std::vector<ReceivedPacket> traffic;
+
+  for (size_t i = 0; i < size(formatters); i++) {
+    const MiLightRemoteConfig* remote = MiLightRemoteConfig::ALL_REMOTES[i];
+
+    for (uint8_t groupId = 1; groupId <= 4; groupId++) {
+      formatters[i]->prepare(0x1000 + i, groupId);
+      formatters[i]->updateStatus(groupId % 2 == 0 ? OFF : ON, groupId);
+
+      PacketStream& packets = formatters[i]->buildPackets();
+      while (packets.hasNext()) {
+        ReceivedPacket received = { &remote->radioConfig, remote, { }, packets.packetLength };
+        memcpy(received.packet, packets.next(), packets.packetLength);
+        traffic.push_back(received);
+      }
+    }
+  }
+
+  // Noise on every radio config.  Whatever it classifies as should match the scan.
+  uint32_t seed = 0x2BAD5EED;
+  for (size_t i = 0; i < 64; i++) {
+    const MiLightRadioConfig& radioConfig = MiLightRadioConfig::ALL_CONFIGS[i % MiLightRadioConfig::NUM_CONFIGS];
+    ReceivedPacket received = { &radioConfig, NULL, { }, radioConfig.packetLength };
+
+    for (size_t j = 0; j < received.length; j++) {
+      seed = seed * 1103515245 + 12345;
+      received.packet[j] = seed >> 16;
+    }
+
+    received.expected = classify_by_scan(radioConfig, received.packet, received.length);
+    traffic.push_back(received);
+  }
+
+  uint32_t scanCycles = 0, classifierCycles = 0;
+
+  for (size_t i = 0; i < traffic.size(); i++) {
+    const ReceivedPacket& received = traffic[i];
+
+    uint32_t start = ESP.getCycleCount();
+    const MiLightRemoteConfig* scanned = classify_by_scan(*received.radioConfig, received.packet, received.length);
+    scanCycles += ESP.getCycleCount() - start;
+
+    start = ESP.getCycleCount();
+    const MiLightRemoteConfig* classified = MiLightRemoteConfig::fromReceivedPacket(*received.radioConfig, received.packet, received.length);
+    classifierCycles += ESP.getCycleCount() - start;
+
+    TEST_ASSERT_TRUE_MESSAGE(scanned == received.expected, "Scan should find the remote that built the packet");
+    TEST_ASSERT_TRUE_MESSAGE(classified == received.expected, "Classifier should agree with the scan");
+  }
+
+  Serial.printf("Classified %u packets, cycles per packet: scan=%u, classifier=%u\n", traffic.size(), scanCycles / traffic.size(), classifierCycles / traffic.size());
+
+  TEST_ASSERT_TRUE_MESSAGE(classifierCycles < scanCycles, "Classifier should be faster than scanning every remote");
+}
+
+size_t count_cct_brightness_packets(CctPacketFormatter& formatter, uint8_t groupId, uint8_t brightness) {
+  formatter.prepare(0x1234, groupId);
+  formatter.updateBrightness(brightness);
+  return formatter.buildPackets().numPackets;
+}
+
+void test_cct_step_planner() {
+  GroupStateStore store(10, 0);
+  GroupStatePersistence persistence;
+  Settings settings;
+  CctPacketFormatter formatter;
+  formatter.initialize(&store, &settings);
+
+  for (uint8_t i = 0; i <= 4; i++) {
+    persistence.clear(BulbId(0x1234, i, REMOTE_TYPE_CCT));
+  }
+
+  TEST_ASSERT_EQUAL_INT_MESSAGE(11, count_cct_brightness_packets(formatter, 1, 10), "Unknown state: should saturate low for low targets");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(11, count_cct_brightness_packets(formatter, 1, 90), "Unknown state: should saturate high for high targets");
+
+  store.get(0x1234, 2, REMOTE_TYPE_CCT)->applyIncrementCommand(GroupStateField::BRIGHTNESS, IncrementDirection::DECREASE);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(9, count_cct_brightness_packets(formatter, 2, 0), "Scratch state: should only step down as far as the bound");
+
+  const uint8_t knownBrightness[] = { 50, 60, 50, 50 };
+  for (uint8_t i = 0; i < 4; i++) {
+    GroupState state;
+    state.setBrightness(knownBrightness[i]);
+    store.set(BulbId(0x1234, i + 1, REMOTE_TYPE_CCT), state);
+  }
+
+  TEST_ASSERT_EQUAL_INT_MESSAGE(3, count_cct_brightness_packets(formatter, 1, 80), "Known state: should step directly");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(7, count_cct_brightness_packets(formatter, 0, 80), "Group 0: should saturate from the range of all groups");
+}
+
+// Applies a packet to the store the way the sent/received packet handler does
+void apply_cct_command(GroupStateStore& store, uint8_t groupId, const char* command) {
+  const BulbId bulbId(0x1234, groupId, REMOTE_TYPE_CCT);
+  ParsedPacket packet;
+  packet.setCommand(command);
+
+  GroupState* groupState = store.get(bulbId);
+  const GroupState stateUpdates(groupState, packet);
+  groupState->patch(stateUpdates);
+  store.set(bulbId, stateUpdates);
+}
+
+void test_cct_step_planner_group_0() {
+  GroupStatePersistence persistence;
+  Settings settings;
+  CctPacketFormatter formatter;
+
+  for (uint8_t i = 0; i <= 4; i++) {
+    persistence.clear(BulbId(0x1234, i, REMOTE_TYPE_CCT));
+  }
+
+  {
+    GroupStateStore store(10, 0);
+    formatter.initialize(&store, &settings);
+
+    // Every bulb is now at most 9.  Then group 2 alone saturates at 10.
+    apply_cct_command(store, 0, MiLightCommandNames::BRIGHTNESS_DOWN);
+    apply_cct_command(store, 2, MiLightCommandNames::BRIGHTNESS_UP);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(
+      10,
+      count_cct_brightness_packets(formatter, 0, 0),
+      "Group 0 shouldn't trust its own bound after a group moved alone"
+    );
+  }
+
+  {
+    GroupStateStore store(10, 0);
+    formatter.initialize(&store, &settings);
+
+    // Group 1 is at most 9, then group 0 moves everything up one: at least 1
+    apply_cct_command(store, 1, MiLightCommandNames::BRIGHTNESS_DOWN);
+    apply_cct_command(store, 0, MiLightCommandNames::BRIGHTNESS_UP);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(
+      10,
+      count_cct_brightness_packets(formatter, 1, 0),
+      "Group 0 steps should replace the group's bound, including its direction"
+    );
+  }
+}
+
 //================================================================================
 // Group State
 //================================================================================
@@ -340,6 +535,1334 @@ void test_group_0() {
   TEST_ASSERT_TRUE_MESSAGE(storedState.isEqualIgnoreDirty(rgbState), "Should persist group 0 for device type with no groups");
 }
 
+void test_state_snapshot() {
+  const uint8_t numStates = 8;
+  GroupStatePersistence persistence;
+  GroupState states[numStates];
+
+  {
+    // Room for each group and the group 0 state it touches
+    GroupStateStore store(numStates * 2, 0);
+
+    for (uint8_t i = 0; i < numStates; i++) {
+      BulbId id(0x100 + i, 1, REMOTE_TYPE_FUT089);
+      persistence.clear(id);
+
+      states[i] = color();
+      states[i].setHue(i * 10);
+      store.set(id, states[i]);
+    }
+
+    TEST_ASSERT_EQUAL_MESSAGE(numStates * 2, store.saveSnapshot(), "Should snapshot every cached state");
+  }
+
+  GroupStateStore warmStore(numStates * 2, 0);
+  GroupStateStore coldStore(numStates * 2, 0);
+
+  TEST_ASSERT_EQUAL_MESSAGE(numStates * 2, warmStore.loadSnapshot(), "Should load every snapshotted state");
+
+  uint32_t start = micros();
+  for (uint8_t i = 0; i < numStates; i++) {
+    GroupState* storedState = warmStore.get(BulbId(0x100 + i, 1, REMOTE_TYPE_FUT089));
+
+    TEST_ASSERT_TRUE_MESSAGE(storedState->isEqualIgnoreDirty(states[i]), "Should restore state from snapshot");
+    TEST_ASSERT_FALSE_MESSAGE(storedState->isDirty(), "Restored state should not be dirty");
+  }
+  uint32_t warmMicros = micros() - start;
+
+  start = micros();
+  for (uint8_t i = 0; i < numStates; i++) {
+    coldStore.get(BulbId(0x100 + i, 1, REMOTE_TYPE_FUT089));
+  }
+  uint32_t coldMicros = micros() - start;
+
+  Serial.printf("First lookup of %u states: warm=%uus, cold=%uus\n", numStates, warmMicros, coldMicros);
+
+  TEST_ASSERT_TRUE_MESSAGE(warmMicros <= coldMicros, "Warm cache should answer faster than flash");
+
+  // Changing persisted state invalidates the snapshot
+  BulbId changedId(0x200, 0, REMOTE_TYPE_RGB);
+  GroupState changedState = GroupState::defaultState(REMOTE_TYPE_RGB);
+  changedState.setHue(100);
+  changedState.setBrightness(10);
+  persistence.clear(changedId);
+  warmStore.set(changedId, changedState);
+  warmStore.flush();
+
+  GroupStateStore staleStore(numStates * 2, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(0, staleStore.loadSnapshot(), "Should not load a snapshot older than persisted state");
+  TEST_ASSERT_TRUE_MESSAGE(staleStore.get(changedId)->isEqualIgnoreDirty(changedState), "Should fall back to persisted state");
+}
+
+void test_json_patch() {
+  StaticJsonDocument<200> doc;
+  GroupState s;
+  s.setState(MiLightStatus::OFF);
+
+  // Brightness in JSON is 0-255, GroupState keeps a percentage
+  deserializeJson(doc, "{\"brightness\":255,\"unknown_field\":1,\"state\":\"ON\"}");
+  TEST_ASSERT_TRUE_MESSAGE(s.patch(doc.as<JsonObject>()), "Patch should report a change");
+  TEST_ASSERT_TRUE_MESSAGE(s.isOn(), "State should be applied");
+  TEST_ASSERT_EQUAL_MESSAGE(100, s.getBrightness(), "State is applied first, so brightness should stick wherever it appears");
+
+  deserializeJson(doc, "{\"command\":\"set_white\",\"hue\":120}");
+  s.patch(doc.as<JsonObject>());
+  TEST_ASSERT_EQUAL_MESSAGE(120, s.getHue(), "Hue should be applied");
+  TEST_ASSERT_EQUAL_MESSAGE(BulbMode::BULB_MODE_WHITE, s.getBulbMode(), "Commands are applied after fields");
+
+  deserializeJson(doc, "{\"hue\":10,\"state\":\"OFF\"}");
+  s.patch(doc.as<JsonObject>());
+  TEST_ASSERT_FALSE_MESSAGE(s.isOn(), "State should be applied");
+  TEST_ASSERT_EQUAL_MESSAGE(120, s.getHue(), "Fields shouldn't change while off");
+}
+
+// Replays a packet corpus through the same steps as onPacketSentHandler:
+// parse, build a GroupState delta, and patch it on.  Either goes through JSON
+// or decodes straight to a ParsedPacket.  Returns cycles spent.
+uint32_t replay_packet_corpus(PacketFormatter& formatter, const std::vector<uint8_t>& corpus, size_t packetLength, bool typed, GroupState& state) {
+  const size_t numPackets = corpus.size() / packetLength;
+  uint32_t cycles = 0;
+
+  for (size_t i = 0; i < numPackets; i++) {
+    const uint8_t* packet = &corpus[i * packetLength];
+    uint32_t start = ESP.getCycleCount();
+
+    if (typed) {
+      ParsedPacket result;
+      formatter.parsePacket(packet, result);
+
+      const GroupState stateUpdates(&state, result);
+      state.patch(stateUpdates);
+    } else {
+      StaticJsonDocument<200> buffer;
+      JsonObject result = buffer.to<JsonObject>();
+      formatter.parsePacket(packet, result);
+
+      const GroupState stateUpdates(&state, result);
+      state.patch(stateUpdates);
+    }
+
+    cycles += ESP.getCycleCount() - start;
+    yield();
+  }
+
+  return cycles;
+}
+
+void test_packet_replay_patch_benchmark() {
+  const size_t numCommands = 64;
+  const uint16_t deviceId = 0x4321;
+  const uint8_t groupId = 2;
+  const BulbId bulbId(deviceId, groupId, REMOTE_TYPE_RGB_CCT);
+
+  GroupStateStore stateStore(10, 0);
+  Settings settings;
+  RgbCctPacketFormatter formatter;
+  formatter.initialize(&stateStore, &settings);
+
+  std::vector<uint8_t> corpus;
+  size_t packetLength = 0;
+
+  for (size_t i = 0; i < numCommands; i++) {
+    formatter.prepare(deviceId, groupId);
+
+    switch (i % 8) {
+      case 0: formatter.updateStatus(ON, groupId); break;
+      case 1: formatter.updateBrightness(i % 100); break;
+      case 2: formatter.updateHue((i * 37) % 360); break;
+      case 3: formatter.updateSaturation(i % 100); break;
+      case 4: formatter.updateTemperature(i % 100); break;
+      case 5: formatter.updateColorWhite(); break;
+      case 6: formatter.updateMode(i % 9); break;
+      case 7: formatter.updateStatus(i % 16 == 7 ? OFF : ON, groupId); break;
+    }
+
+    PacketStream& packets = formatter.buildPackets();
+    packetLength = packets.packetLength;
+
+    while (packets.hasNext()) {
+      const uint8_t* packet = packets.next();
+      corpus.insert(corpus.end(), packet, packet + packets.packetLength);
+    }
+  }
+
+  const size_t numPackets = corpus.size() / packetLength;
+
+  for (size_t i = 0; i < numPackets; i++) {
+    ParsedPacket result;
+    BulbId parsedId = formatter.parsePacket(&corpus[i * packetLength], result);
+
+    TEST_ASSERT_TRUE_MESSAGE(parsedId == bulbId, "Every replayed packet should decode");
+    TEST_ASSERT_FALSE_MESSAGE(result.isEmpty(), "Every replayed packet should set something");
+  }
+
+  GroupState jsonState = GroupState::defaultState(REMOTE_TYPE_RGB_CCT);
+  GroupState typedState = GroupState::defaultState(REMOTE_TYPE_RGB_CCT);
+  uint32_t jsonCycles = replay_packet_corpus(formatter, corpus, packetLength, false, jsonState);
+  uint32_t typedCycles = replay_packet_corpus(formatter, corpus, packetLength, true, typedState);
+
+  Serial.printf("Replayed %u packets, cycles per packet: json=%u, typed=%u\n", numPackets, jsonCycles / numPackets, typedCycles / numPackets);
+
+  TEST_ASSERT_TRUE_MESSAGE(jsonState == typedState, "Both paths should end in the same state");
+
+  // The corpus ends with a scene, then turning the group back on.  Scene
+  // brightness was last set to 57%, give or take rescaling.
+  TEST_ASSERT_TRUE_MESSAGE(typedState.isOn(), "Replay ends with the group on");
+  TEST_ASSERT_EQUAL_MESSAGE(BulbMode::BULB_MODE_SCENE, typedState.getBulbMode(), "Replay ends in scene mode");
+  TEST_ASSERT_INT_WITHIN_MESSAGE(1, 57, typedState.getBrightness(), "Replay should restore scene brightness");
+
+  TEST_ASSERT_TRUE_MESSAGE(typedCycles < jsonCycles, "Decoding straight to state should be faster than going through JSON");
+}
+
+//================================================================================
+// UDP command tables
+//================================================================================
+
+void assert_udp_command(const UdpCommand& command, MiLightRemoteType remoteType, UdpAction action, uint8_t group) {
+  TEST_ASSERT_EQUAL_INT_MESSAGE(remoteType, command.remoteType, "Should decode to the expected remote type");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(static_cast<uint8_t>(action), static_cast<uint8_t>(command.action), "Should decode to the expected action");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(group, command.group, "Should decode to the expected group");
+}
+
+void test_v5_udp_command_table() {
+  assert_udp_command(UdpCommands::fromV5Command(UDP_RGBW_GROUP_3_ON), REMOTE_TYPE_RGBW, UdpAction::STATUS_ON, 3);
+  assert_udp_command(UdpCommands::fromV5Command(UDP_RGBW_GROUP_4_OFF), REMOTE_TYPE_RGBW, UdpAction::STATUS_OFF, 4);
+  assert_udp_command(UdpCommands::fromV5Command(UDP_RGBW_GROUP_ALL_WHITE), REMOTE_TYPE_RGBW, UdpAction::SET_WHITE, 0);
+  assert_udp_command(UdpCommands::fromV5Command(UDP_RGBW_GROUP_2_NIGHT), REMOTE_TYPE_RGBW, UdpAction::NIGHT_MODE, 2);
+  assert_udp_command(UdpCommands::fromV5Command(UDP_RGBW_BRIGHTNESS), REMOTE_TYPE_RGBW, UdpAction::BRIGHTNESS, UDP_LAST_GROUP);
+  assert_udp_command(UdpCommands::fromV5Command(UDP_CCT_GROUP_2_ON), REMOTE_TYPE_CCT, UdpAction::STATUS_ON, 2);
+  assert_udp_command(UdpCommands::fromV5Command(UDP_CCT_NIGHT_MODE), REMOTE_TYPE_CCT, UdpAction::NIGHT_MODE, 0);
+  assert_udp_command(UdpCommands::fromV5Command(UDP_CCT_TEMPERATURE_UP), REMOTE_TYPE_CCT, UdpAction::TEMPERATURE_UP, UDP_LAST_GROUP);
+
+  TEST_ASSERT_TRUE_MESSAGE(UdpCommands::fromV5Command(UDP_RGBW_GROUP_1_ON).selectsGroup, "RGBW group commands should select the group");
+  TEST_ASSERT_FALSE_MESSAGE(UdpCommands::fromV5Command(UDP_CCT_GROUP_1_ON).selectsGroup, "CCT on/off commands should not select the group");
+  TEST_ASSERT_TRUE_MESSAGE(UdpCommands::fromV5Command(0xFF).action == UdpAction::NONE, "Unknown commands should not be handled");
+}
+
+// The decoding V5MiLightUdpServer::handleCommand did before the table,
+// written out branch for branch.  Sets arg to what the action is executed
+// with.
+UdpCommand reference_v5_command(uint8_t command, uint8_t commandArg, uint8_t& arg) {
+  arg = commandArg;
+
+  if (command >= UDP_RGBW_GROUP_1_ON && command <= UDP_RGBW_GROUP_4_OFF) {
+    return UdpCommand(
+      REMOTE_TYPE_RGBW,
+      (command % 2) == 1 ? UdpAction::STATUS_ON : UdpAction::STATUS_OFF,
+      (command - UDP_RGBW_GROUP_1_ON + 2)/2,
+      true
+    );
+  } else if (command == UDP_RGBW_GROUP_ALL_WHITE || command == UDP_RGBW_GROUP_1_WHITE || command == UDP_RGBW_GROUP_2_WHITE || command == UDP_RGBW_GROUP_3_WHITE || command == UDP_RGBW_GROUP_4_WHITE) {
+    return UdpCommand(REMOTE_TYPE_RGBW, UdpAction::SET_WHITE, (command - UDP_RGBW_GROUP_ALL_WHITE)/2, true);
+  } else if (command == UDP_RGBW_GROUP_ALL_NIGHT || command == UDP_RGBW_GROUP_1_NIGHT || command == UDP_RGBW_GROUP_2_NIGHT || command == UDP_RGBW_GROUP_3_NIGHT || command == UDP_RGBW_GROUP_4_NIGHT) {
+    uint8_t groupId = (command - UDP_RGBW_GROUP_1_NIGHT + 2)/2;
+    if (command == UDP_RGBW_GROUP_ALL_NIGHT) {
+      groupId = 0;
+    }
+    return UdpCommand(REMOTE_TYPE_RGBW, UdpAction::NIGHT_MODE, groupId, true);
+  }
+
+  switch (command) {
+    case UDP_RGBW_ALL_ON:
+      return UdpCommand(REMOTE_TYPE_RGBW, UdpAction::ALL_ON, UDP_LAST_GROUP);
+    case UDP_RGBW_ALL_OFF:
+      return UdpCommand(REMOTE_TYPE_RGBW, UdpAction::ALL_OFF, UDP_LAST_GROUP);
+    case UDP_RGBW_COLOR:
+      arg = 0xFF-(commandArg + 0x35);
+      return UdpCommand(REMOTE_TYPE_RGBW, UdpAction::COLOR_RAW, UDP_LAST_GROUP);
+    case UDP_RGBW_DISCO_MODE:
+      return UdpCommand(REMOTE_TYPE_RGBW, UdpAction::NEXT_MODE, UDP_LAST_GROUP);
+    case UDP_RGBW_SPEED_DOWN:
+      return UdpCommand(REMOTE_TYPE_RGBW, UdpAction::SPEED_DOWN, UDP_LAST_GROUP);
+    case UDP_RGBW_SPEED_UP:
+      return UdpCommand(REMOTE_TYPE_RGBW, UdpAction::SPEED_UP, UDP_LAST_GROUP);
+    case UDP_RGBW_BRIGHTNESS:
+      arg = round(((commandArg - 2) / 25.0)*100);
+      return UdpCommand(REMOTE_TYPE_RGBW, UdpAction::BRIGHTNESS, UDP_LAST_GROUP);
+  }
+
+  const uint8_t onOffGroup = CctPacketFormatter::cctCommandIdToGroup(command);
+
+  if (onOffGroup != 255) {
+    // Night mode commands are same as off commands with MSB set
+    if ((command & 0x80) == 0x80) {
+      return UdpCommand(REMOTE_TYPE_CCT, UdpAction::NIGHT_MODE, onOffGroup);
+    }
+
+    return UdpCommand(
+      REMOTE_TYPE_CCT,
+      CctPacketFormatter::cctCommandToStatus(command) == ON ? UdpAction::STATUS_ON : UdpAction::STATUS_OFF,
+      onOffGroup
+    );
+  }
+
+  switch (command) {
+    case UDP_CCT_BRIGHTNESS_DOWN:
+      return UdpCommand(REMOTE_TYPE_CCT, UdpAction::BRIGHTNESS_DOWN, UDP_LAST_GROUP);
+    case UDP_CCT_BRIGHTNESS_UP:
+      return UdpCommand(REMOTE_TYPE_CCT, UdpAction::BRIGHTNESS_UP, UDP_LAST_GROUP);
+    case UDP_CCT_TEMPERATURE_DOWN:
+      return UdpCommand(REMOTE_TYPE_CCT, UdpAction::TEMPERATURE_DOWN, UDP_LAST_GROUP);
+    case UDP_CCT_TEMPERATURE_UP:
+      return UdpCommand(REMOTE_TYPE_CCT, UdpAction::TEMPERATURE_UP, UDP_LAST_GROUP);
+    case UDP_CCT_NIGHT_MODE:
+      return UdpCommand(REMOTE_TYPE_CCT, UdpAction::NIGHT_MODE, UDP_LAST_GROUP);
+  }
+
+  return UdpCommand();
+}
+
+void test_v5_udp_command_table_matches_reference() {
+  uint8_t expectedArg;
+
+  for (uint16_t command = 0; command < 256; command++) {
+    const UdpCommand actual = UdpCommands::fromV5Command(command);
+
+    for (uint16_t commandArg = 0; commandArg < 256; commandArg++) {
+      const UdpCommand expected = reference_v5_command(command, commandArg, expectedArg);
+
+      assert_udp_command(actual, static_cast<MiLightRemoteType>(expected.remoteType), expected.action, expected.group);
+      TEST_ASSERT_EQUAL_MESSAGE(expected.selectsGroup, actual.selectsGroup, "Should select the group when the old decoding did");
+
+      if (expected.action != UdpAction::NONE) {
+        TEST_ASSERT_EQUAL_MESSAGE(
+          expectedArg,
+          UdpCommands::fromV5Argument(actual.action, commandArg),
+          "Should convert the argument the same way"
+        );
+      }
+    }
+    yield();
+  }
+}
+
+void test_v5_udp_decode_benchmark() {
+  const uint8_t rounds = 20;
+  uint8_t arg;
+  uint32_t checksum = 0;
+
+  uint32_t start = micros();
+  for (uint8_t i = 0; i < rounds; i++) {
+    for (uint16_t command = 0; command < 256; command++) {
+      const UdpCommand decoded = UdpCommands::fromV5Command(command);
+      checksum += static_cast<uint8_t>(decoded.action) + UdpCommands::fromV5Argument(decoded.action, command);
+    }
+  }
+  uint32_t tableMicros = micros() - start;
+
+  start = micros();
+  for (uint8_t i = 0; i < rounds; i++) {
+    for (uint16_t command = 0; command < 256; command++) {
+      const UdpCommand decoded = reference_v5_command(command, command, arg);
+      checksum -= static_cast<uint8_t>(decoded.action) + (decoded.action == UdpAction::NONE ? command : arg);
+    }
+  }
+  uint32_t branchMicros = micros() - start;
+
+  Serial.printf("Decoding %u V5 commands: table=%uus, branches=%uus\n", rounds * 256, tableMicros, branchMicros);
+
+  TEST_ASSERT_EQUAL_MESSAGE(0, checksum, "Both decoders should agree");
+  TEST_ASSERT_TRUE_MESSAGE(tableMicros <= branchMicros, "Table lookup should be faster than the old branches");
+}
+
+void test_v6_udp_button_table() {
+  TEST_ASSERT_TRUE(UdpCommands::fromV6Button(REMOTE_TYPE_RGBW, V2_RGBW_WHITE_ON) == UdpAction::SET_WHITE);
+  TEST_ASSERT_TRUE(UdpCommands::fromV6Button(REMOTE_TYPE_CCT, V2_CCT_OFF) == UdpAction::STATUS_OFF);
+  TEST_ASSERT_TRUE(UdpCommands::fromV6Button(REMOTE_TYPE_RGB, V2_RGB_MODE_UP) == UdpAction::NEXT_MODE);
+  TEST_ASSERT_TRUE(UdpCommands::fromV6Button(REMOTE_TYPE_RGB_CCT, V2_RGB_NIGHT_MODE) == UdpAction::NIGHT_MODE);
+  TEST_ASSERT_TRUE(UdpCommands::fromV6Button(REMOTE_TYPE_CCT, 0x42) == UdpAction::NONE);
+}
+
+//================================================================================
+// Color conversion
+//================================================================================
+
+// RGBConverter's doubles land just shy of exact .5 and integer results, so the
+// fixed-point version can be one higher at those points.
+void test_rgb_to_hsv_accuracy() {
+  RGBConverter converter;
+  double hsv[3];
+  uint16_t hue;
+  uint8_t saturation;
+
+  // Every 5th value per channel (including 255) keeps this inside the watchdog
+  for (uint16_t r = 0; r < 256; r += 5) {
+    for (uint16_t g = 0; g < 256; g += 5) {
+      for (uint16_t b = 0; b < 256; b += 5) {
+        converter.rgbToHsv(r, g, b, hsv);
+        ColorConverter::rgbToHsv(r, g, b, hue, saturation);
+
+        TEST_ASSERT_INT_WITHIN_MESSAGE(1, round(hsv[0]*360), hue, "Hue should match RGBConverter");
+        TEST_ASSERT_INT_WITHIN_MESSAGE(1, round(hsv[1]*100), saturation, "Saturation should match RGBConverter");
+      }
+      yield();
+    }
+  }
+}
+
+void test_hsv_to_rgb_accuracy() {
+  RGBConverter converter;
+  uint8_t expected[3];
+  uint8_t actual[3];
+
+  for (uint16_t hue = 0; hue <= 360; hue++) {
+    for (uint8_t saturation = 0; saturation <= 100; saturation++) {
+      converter.hsvToRgb(hue / 360.0, saturation / 100.0, 1, expected);
+      ColorConverter::hsvToRgb(hue, saturation, actual);
+
+      for (size_t i = 0; i < 3; i++) {
+        TEST_ASSERT_INT_WITHIN_MESSAGE(1, expected[i], actual[i], "RGB should match RGBConverter");
+      }
+    }
+    yield();
+  }
+}
+
+void test_color_conversion_benchmark() {
+  const uint16_t iterations = 1000;
+  RGBConverter converter;
+  double hsv[3];
+  uint8_t rgb[3];
+  uint16_t hue;
+  uint8_t saturation;
+
+  uint32_t start = ESP.getCycleCount();
+  for (uint16_t i = 0; i < iterations; i++) {
+    converter.rgbToHsv(i, i >> 2, i * 7, hsv);
+    converter.hsvToRgb(hsv[0], hsv[1], 1, rgb);
+  }
+  uint32_t doubleCycles = (ESP.getCycleCount() - start) / iterations;
+
+  start = ESP.getCycleCount();
+  for (uint16_t i = 0; i < iterations; i++) {
+    ColorConverter::rgbToHsv(i, i >> 2, i * 7, hue, saturation);
+    ColorConverter::hsvToRgb(hue, saturation, rgb);
+  }
+  uint32_t fixedCycles = (ESP.getCycleCount() - start) / iterations;
+
+  Serial.printf("RGB -> HSV -> RGB cycles per conversion: RGBConverter=%u, ColorConverter=%u\n", doubleCycles, fixedCycles);
+
+  TEST_ASSERT_TRUE_MESSAGE(fixedCycles < doubleCycles, "Fixed-point conversion should be faster than RGBConverter");
+}
+
+void test_hsv_transition_plan() {
+  ParsedColor start = ParsedColor::fromRgb(255, 0, 40);
+  ParsedColor end = ParsedColor::fromRgb(255, 128, 0);
+
+  std::vector<HsvColorTransition::Step> steps = HsvColorTransition::planSteps(start, end, 100);
+
+  TEST_ASSERT_TRUE_MESSAGE(steps.size() < 101, "Should skip steps which send the same command");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(start.hue, steps.front().hue, "Should start at the start hue");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(end.hue, steps.back().hue, "Should finish at the end hue");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(end.saturation, steps.back().saturation, "Should finish at the end saturation");
+
+  for (size_t i = 1; i < steps.size(); i++) {
+    TEST_ASSERT_TRUE_MESSAGE(steps[i].tick > steps[i-1].tick, "Steps should be in tick order");
+    // Shortest way around the color wheel passes through 0
+    TEST_ASSERT_TRUE_MESSAGE(steps[i].hue >= start.hue || steps[i].hue <= end.hue, "Should wrap around through red");
+  }
+}
+
+//================================================================================
+// Radio throughput (simulated radio)
+//================================================================================
+
+struct SenderLoad {
+  const char* name;
+  uint16_t numCommands;
+  uint8_t commandsPerBurst;
+  uint16_t burstIntervalMs;
+  // 0 uses PacketSender's throttled default
+  size_t repeats;
+};
+
+static const SenderLoad SENDER_LOADS[] = {
+  // Scenes: bursts of commands with the HTTP repeat factor applied
+  { "http", 24, 4, 250, 100 },
+  // Automations: a steady trickle of single commands
+  { "mqtt", 24, 1, 100, 0 },
+  // Apps dragging sliders: commands as fast as they can send them
+  { "udp", 40, 1, 20, 0 }
+};
+
+struct SenderResult {
+  uint32_t elapsedMs;
+  uint16_t sent;
+  uint32_t p50, p90, p99, max;
+};
+
+SenderResult run_sender_load(const SenderLoad& load, const MiLightRemoteConfig* remoteConfig, Settings& settings) {
+  GroupStateStore stateStore(10, 0);
+  RadioSwitchboard radios(std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::NRF24), &stateStore, settings);
+  std::vector<uint32_t> enqueuedAt(load.numCommands);
+  std::vector<uint32_t> latencies;
+  latencies.reserve(load.numCommands);
+
+  // First two bytes of each packet identify the command
+  PacketSender sender(radios, settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    latencies.push_back(millis() - enqueuedAt[packet[0] | (packet[1] << 8)]);
+  });
+
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH] = { 0 };
+  uint16_t enqueued = 0;
+  uint32_t start = millis();
+  uint32_t nextBurst = start;
+
+  while (enqueued < load.numCommands || sender.isSending()) {
+    uint32_t now = millis();
+
+    if (enqueued < load.numCommands && now >= nextBurst) {
+      for (uint8_t i = 0; i < load.commandsPerBurst && enqueued < load.numCommands; i++, enqueued++) {
+        packet[0] = enqueued & 0xFF;
+        packet[1] = enqueued >> 8;
+        enqueuedAt[enqueued] = now;
+        sender.enqueue(packet, remoteConfig, load.repeats);
+      }
+      nextBurst += load.burstIntervalMs;
+    }
+
+    sender.loop();
+    yield();
+  }
+
+  SenderResult result = { millis() - start, static_cast<uint16_t>(latencies.size()), 0, 0, 0, 0 };
+
+  if (! latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    result.p50 = latencies[(latencies.size() - 1) * 50 / 100];
+    result.p90 = latencies[(latencies.size() - 1) * 90 / 100];
+    result.p99 = latencies[(latencies.size() - 1) * 99 / 100];
+    result.max = latencies.back();
+  }
+
+  return result;
+}
+
+void print_sender_result(const char* load, const char* remote, const SenderResult& result, uint16_t numCommands) {
+  Serial.printf_P(
+    PSTR("%-5s %-8s cmds/sec=%5u sent=%3u dropped=%3u latency ms p50=%5u p90=%5u p99=%5u max=%5u\n"),
+    load,
+    remote,
+    result.elapsedMs > 0 ? (result.sent * 1000) / result.elapsedMs : 0,
+    result.sent,
+    numCommands - result.sent,
+    result.p50,
+    result.p90,
+    result.p99,
+    result.max
+  );
+}
+
+// Saturates the queue for each remote type.  Throughput can't beat the
+// simulated air time for the configured number of repeats.
+void test_radio_throughput_by_remote() {
+  Settings settings;
+  const SenderLoad saturate = { "max", MILIGHT_MAX_QUEUED_PACKETS, MILIGHT_MAX_QUEUED_PACKETS, 0, 0 };
+
+  for (size_t i = 0; i < MiLightRemoteConfig::NUM_REMOTES; i++) {
+    const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::ALL_REMOTES[i];
+    SimulatedMiLightRadio model(remoteConfig->radioConfig, SimulatedRadioTiming::NRF24, MiLightRadioConfig::NUM_CHANNELS);
+    const uint32_t commandMicros = settings.packetRepeats * model.frameCostMicros(remoteConfig->packetFormatter->getPacketLength());
+
+    SenderResult result = run_sender_load(saturate, remoteConfig, settings);
+    print_sender_result(saturate.name, remoteConfig->name.c_str(), result, saturate.numCommands);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(saturate.numCommands, result.sent, "Should send every queued command");
+    TEST_ASSERT_TRUE_MESSAGE(
+      (result.elapsedMs * 1000) >= (result.sent * commandMicros),
+      "Should not send faster than the simulated air time allows"
+    );
+  }
+}
+
+void test_radio_throughput_by_load() {
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(REMOTE_TYPE_RGB_CCT);
+
+  for (size_t throttled = 0; throttled < 2; throttled++) {
+    Settings settings;
+    settings.packetRepeatThrottleSensitivity = throttled ? 500 : 0;
+
+    Serial.printf_P(PSTR("Throttle sensitivity: %u\n"), settings.packetRepeatThrottleSensitivity);
+
+    for (size_t i = 0; i < size(SENDER_LOADS); i++) {
+      SenderResult result = run_sender_load(SENDER_LOADS[i], remoteConfig, settings);
+      print_sender_result(SENDER_LOADS[i].name, remoteConfig->name.c_str(), result, SENDER_LOADS[i].numCommands);
+
+      TEST_ASSERT_TRUE_MESSAGE(result.sent > 0, "Should send commands");
+    }
+  }
+}
+
+struct InterleaveResult {
+  uint32_t firstWriteMicros[MILIGHT_MAX_INTERLEAVED_PACKETS];
+  uint32_t lastWriteMicros[MILIGHT_MAX_INTERLEAVED_PACKETS];
+  size_t framesSent;
+};
+
+// Sends one burst of packets, recording when each one first and last hit the
+// air.  Packet i goes to deviceIds[i].
+InterleaveResult run_interleave_burst(bool interleave, const int32_t deviceIds[], size_t repeats) {
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(REMOTE_TYPE_RGB_CCT);
+  std::shared_ptr<SimulatedRadioFactory> factory = std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::NRF24);
+  InterleaveResult result = { };
+  uint32_t start = micros();
+
+  for (size_t i = 0; i < MILIGHT_MAX_INTERLEAVED_PACKETS; i++) {
+    result.firstWriteMicros[i] = UINT32_MAX;
+  }
+
+  // First byte of each packet identifies it
+  factory->onWrite([&](const uint8_t* frame, size_t length) {
+    uint32_t elapsed = micros() - start;
+
+    if (result.firstWriteMicros[frame[0]] == UINT32_MAX) {
+      result.firstWriteMicros[frame[0]] = elapsed;
+    }
+    result.lastWriteMicros[frame[0]] = elapsed;
+    ++result.framesSent;
+  });
+
+  Settings settings;
+  settings.interleavePacketRepeats = interleave;
+  GroupStateStore stateStore(10, 0);
+  RadioSwitchboard radios(factory, &stateStore, settings);
+  PacketSender sender(radios, settings, nullptr);
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH] = { 0 };
+
+  for (uint8_t i = 0; i < MILIGHT_MAX_INTERLEAVED_PACKETS; i++) {
+    packet[0] = i;
+    sender.enqueue(packet, remoteConfig, repeats, deviceIds[i]);
+  }
+
+  start = micros();
+  while (sender.isSending()) {
+    sender.loop();
+    yield();
+  }
+
+  return result;
+}
+
+void test_interleaved_repeats() {
+  const size_t repeats = 20;
+  const size_t numPackets = MILIGHT_MAX_INTERLEAVED_PACKETS;
+  int32_t deviceIds[MILIGHT_MAX_INTERLEAVED_PACKETS];
+
+  for (size_t i = 0; i < numPackets; i++) {
+    deviceIds[i] = 0x1000 + i;
+  }
+
+  InterleaveResult sequential = run_interleave_burst(false, deviceIds, repeats);
+  InterleaveResult interleaved = run_interleave_burst(true, deviceIds, repeats);
+  uint32_t sequentialTotal = 0, interleavedTotal = 0;
+
+  for (size_t i = 0; i < numPackets; i++) {
+    sequentialTotal += sequential.firstWriteMicros[i];
+    interleavedTotal += interleaved.firstWriteMicros[i];
+  }
+
+  Serial.printf_P(
+    PSTR("Mean time to first repeat: sequential=%uus interleaved=%uus\n"),
+    sequentialTotal / numPackets,
+    interleavedTotal / numPackets
+  );
+
+  TEST_ASSERT_EQUAL_MESSAGE(numPackets * repeats, sequential.framesSent, "Should send every repeat");
+  TEST_ASSERT_EQUAL_MESSAGE(sequential.framesSent, interleaved.framesSent, "Interleaving shouldn't change air time");
+  TEST_ASSERT_TRUE_MESSAGE(interleavedTotal < sequentialTotal, "Interleaving should get packets out sooner");
+
+  // Packets for the same device have to go one after the other
+  for (size_t i = 0; i < numPackets; i++) {
+    deviceIds[i] = 0x1000;
+  }
+
+  InterleaveResult sameDevice = run_interleave_burst(true, deviceIds, repeats);
+
+  for (size_t i = 1; i < numPackets; i++) {
+    TEST_ASSERT_TRUE_MESSAGE(
+      sameDevice.firstWriteMicros[i] > sameDevice.lastWriteMicros[i - 1],
+      "Shouldn't interleave packets for the same device"
+    );
+  }
+
+  QueuedPacket known, raw;
+  known.remoteConfig = MiLightRemoteConfig::fromType(REMOTE_TYPE_RGB_CCT);
+  known.deviceId = 0x1000;
+  raw.remoteConfig = MiLightRemoteConfig::fromType(REMOTE_TYPE_FUT091);
+  raw.deviceId = QueuedPacket::UNKNOWN_DEVICE;
+
+  TEST_ASSERT_TRUE_MESSAGE(known.conflictsWith(raw), "Raw packets should conflict with every remote type");
+  TEST_ASSERT_TRUE(raw.conflictsWith(known));
+
+  raw.deviceId = 0x1000;
+  TEST_ASSERT_FALSE_MESSAGE(known.conflictsWith(raw), "Same ID under another remote type is another device");
+}
+
+// Rebuilding the radios hands unsent packets over to a new sender
+void test_packet_sender_handover() {
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(REMOTE_TYPE_RGB_CCT);
+  const size_t repeats = 20;
+  const uint8_t numPackets = 3;
+  std::shared_ptr<SimulatedRadioFactory> factory = std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::NRF24);
+  size_t framesSent[numPackets] = { };
+
+  factory->onWrite([&](const uint8_t* frame, size_t length) {
+    ++framesSent[frame[0]];
+  });
+
+  Settings settings;
+  settings.packetRepeatsPerLoop = 5;
+  GroupStateStore stateStore(10, 0);
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH] = { 0 };
+
+  RadioSwitchboard* radios = new RadioSwitchboard(factory, &stateStore, settings);
+  PacketSender* sender = new PacketSender(*radios, settings, nullptr);
+  CommandLatency::reset();
+
+  for (uint8_t i = 0; i < numPackets; i++) {
+    packet[0] = i;
+    sender->enqueue(packet, remoteConfig, repeats, 0x1000 + i, CommandStamp(CommandSource::UDP_V6));
+  }
+
+  // Part way through the first packet
+  sender->loop();
+  TEST_ASSERT_EQUAL(settings.packetRepeatsPerLoop, framesSent[0]);
+
+  RadioSwitchboard newRadios(factory, &stateStore, settings);
+  PacketSender newSender(newRadios, settings, nullptr);
+  newSender.adoptPackets(*sender);
+
+  delete sender;
+  delete radios;
+
+  while (newSender.isSending()) {
+    newSender.loop();
+    yield();
+  }
+
+  for (uint8_t i = 0; i < numPackets; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(repeats, framesSent[i], "Should send every repeat exactly once across the handover");
+  }
+
+  for (size_t stage = 0; stage < CommandLatency::NUM_STAGES; stage++) {
+    const LatencyHistogram& histogram = CommandLatency::getHistogram(CommandSource::UDP_V6, static_cast<LatencyStage>(stage));
+    TEST_ASSERT_EQUAL_MESSAGE(numPackets, histogram.count, "Each packet should be traced once per stage across the handover");
+  }
+
+  // A full sender, with every active slot taken as well
+  const size_t numFull = MILIGHT_MAX_INTERLEAVED_PACKETS + MILIGHT_MAX_QUEUED_PACKETS;
+  size_t fullFramesSent[numFull] = { };
+
+  factory->onWrite([&](const uint8_t* frame, size_t length) {
+    ++fullFramesSent[frame[0]];
+  });
+
+  settings.interleavePacketRepeats = true;
+  radios = new RadioSwitchboard(factory, &stateStore, settings);
+  sender = new PacketSender(*radios, settings, nullptr);
+
+  for (uint8_t i = 0; i < MILIGHT_MAX_INTERLEAVED_PACKETS; i++) {
+    packet[0] = i;
+    sender->enqueue(packet, remoteConfig, repeats, 0x1000 + i);
+  }
+
+  sender->loop();
+
+  for (size_t i = MILIGHT_MAX_INTERLEAVED_PACKETS; i < numFull; i++) {
+    packet[0] = i;
+    sender->enqueue(packet, remoteConfig, repeats, 0x1000 + i);
+  }
+
+  RadioSwitchboard fullRadios(factory, &stateStore, settings);
+  PacketSender fullSender(fullRadios, settings, nullptr);
+  fullSender.adoptPackets(*sender);
+
+  delete sender;
+  delete radios;
+
+  while (fullSender.isSending()) {
+    fullSender.loop();
+    yield();
+  }
+
+  TEST_ASSERT_EQUAL_MESSAGE(0, fullSender.droppedPackets(), "Handover shouldn't drop packets");
+
+  for (size_t i = 0; i < numFull; i++) {
+    TEST_ASSERT_EQUAL_MESSAGE(repeats, fullFramesSent[i], "Should send every repeat of a full sender");
+  }
+}
+
+void test_radio_switchboard_modules() {
+  const MiLightRemoteConfig* cct = MiLightRemoteConfig::fromType(REMOTE_TYPE_CCT);
+  const MiLightRemoteConfig* rgbCct = MiLightRemoteConfig::fromType(REMOTE_TYPE_RGB_CCT);
+  std::shared_ptr<MiLightRadioFactory> factory = std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::NRF24);
+  GroupStateStore stateStore(10, 0);
+  Settings settings;
+
+  RadioSwitchboard single(factory, &stateStore, settings);
+  TEST_ASSERT_FALSE(single.canListenWhileSending());
+  TEST_ASSERT_TRUE_MESSAGE(
+    single.switchRadio(cct) == single.switchListenRadio(cct),
+    "One module should send and listen with the same radio"
+  );
+
+  std::vector<std::shared_ptr<MiLightRadioFactory>> factories = {
+    factory,
+    std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::LT8900)
+  };
+
+  RadioSwitchboard dual(factories, &stateStore, settings);
+  TEST_ASSERT_TRUE(dual.canListenWhileSending());
+  TEST_ASSERT_TRUE_MESSAGE(
+    dual.switchRadio(cct) != dual.switchListenRadio(cct),
+    "Second module should be reserved for listening"
+  );
+
+  settings.listenRepeats = 0;
+  RadioSwitchboard dualSend(factories, &stateStore, settings);
+  std::shared_ptr<MiLightRadio> cctRadio = dualSend.switchRadio(cct);
+  std::shared_ptr<MiLightRadio> rgbCctRadio = dualSend.switchRadio(rgbCct);
+
+  TEST_ASSERT_FALSE(dualSend.canListenWhileSending());
+  TEST_ASSERT_TRUE_MESSAGE(cctRadio != rgbCctRadio, "Configs should be spread across both modules");
+  TEST_ASSERT_TRUE_MESSAGE(
+    cctRadio == dualSend.switchRadio(cct),
+    "Switching back to a config should reuse its module"
+  );
+}
+
+void test_listen_ignores_echoes() {
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(REMOTE_TYPE_RGB_CCT);
+  std::shared_ptr<SimulatedRadioFactory> sendFactory = std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::NRF24);
+  std::vector<std::shared_ptr<MiLightRadioFactory>> factories = {
+    sendFactory,
+    std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::LT8900)
+  };
+  std::shared_ptr<SimulatedMiLightRadio> listener;
+
+  // Everything the sending module puts on air reaches the listening one
+  sendFactory->onWrite([&](const uint8_t* frame, size_t length) {
+    if (listener) {
+      listener->hear(frame, length);
+    }
+  });
+
+  Settings settings;
+  settings.packetRepeats = 5;
+  GroupStateStore stateStore(10, 0);
+  RadioSwitchboard radios(factories, &stateStore, settings);
+  size_t numSent = 0;
+  PacketSender sender(radios, settings, [&](uint8_t* packet, const MiLightRemoteConfig& config) {
+    ++numSent;
+  });
+
+  TEST_ASSERT_TRUE(radios.canListenWhileSending());
+  listener = std::static_pointer_cast<SimulatedMiLightRadio>(radios.switchListenRadio(remoteConfig));
+
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH] = { 0x20, 0x01, 0x02, 0x03 };
+  const size_t packetLength = remoteConfig->packetFormatter->getPacketLength();
+  sender.enqueue(packet, remoteConfig, settings.packetRepeats);
+
+  while (sender.isSending()) {
+    sender.loop();
+  }
+
+  size_t numHeard = 0;
+  size_t numHandled = 0;
+  uint8_t readPacket[MILIGHT_MAX_PACKET_LENGTH];
+
+  while (radios.available()) {
+    size_t readLength = radios.read(readPacket);
+    ++numHeard;
+
+    if (!sender.isEcho(listener->config(), readPacket, readLength)) {
+      ++numHandled;
+    }
+  }
+
+  TEST_ASSERT_EQUAL_MESSAGE(settings.packetRepeats, numHeard, "Listening module should hear every repeat");
+  TEST_ASSERT_EQUAL_MESSAGE(0, numHandled, "Our own repeats shouldn't be handled again");
+  TEST_ASSERT_EQUAL(1, numSent);
+
+  uint8_t remotePacket[MILIGHT_MAX_PACKET_LENGTH] = { 0x20, 0x01, 0x02, 0x04 };
+  TEST_ASSERT_FALSE_MESSAGE(
+    sender.isEcho(listener->config(), remotePacket, packetLength),
+    "A packet we didn't send isn't an echo"
+  );
+
+  const MiLightRemoteConfig* otherRemote = MiLightRemoteConfig::fromType(REMOTE_TYPE_CCT);
+  TEST_ASSERT_FALSE_MESSAGE(
+    sender.isEcho(otherRemote->radioConfig, packet, packetLength),
+    "Same bytes under another radio config aren't an echo"
+  );
+
+  delay(MILIGHT_ECHO_WINDOW + 10);
+  TEST_ASSERT_FALSE_MESSAGE(
+    sender.isEcho(listener->config(), packet, packetLength),
+    "Packets heard after the echo window should be handled"
+  );
+}
+
+// Each window: packets heard back and packets missed, every one sent with
+// `frames` repeats while the listen radio was tuned in
+void observe_windows(AdaptiveRepeats& repeats, const MiLightRemoteConfig* remoteConfig,
+  size_t numWindows, size_t heard, size_t missed, size_t frames) {
+  for (size_t i = 0; i < numWindows; i++) {
+    for (size_t j = 0; j < heard; j++) {
+      repeats.observe(remoteConfig->radioConfig, true, frames);
+    }
+    for (size_t j = 0; j < missed; j++) {
+      repeats.observe(remoteConfig->radioConfig, false, frames);
+    }
+  }
+}
+
+void test_adaptive_repeats() {
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(REMOTE_TYPE_RGB_CCT);
+  Settings settings;
+
+  TEST_ASSERT_EQUAL_MESSAGE(3, AdaptiveRepeats::repeatsForLoss(0, 3, 50), "Clean link should use the minimum");
+  TEST_ASSERT_EQUAL_MESSAGE(14, AdaptiveRepeats::repeatsForLoss(500, 3, 50), "0.5^14 is the first power under 100ppm");
+  TEST_ASSERT_EQUAL_MESSAGE(50, AdaptiveRepeats::repeatsForLoss(1000, 3, 50), "Dead link should use the maximum");
+  TEST_ASSERT_EQUAL_MESSAGE(50, AdaptiveRepeats::repeatsForLoss(0, 60, 50), "Minimum shouldn't exceed the maximum");
+
+  AdaptiveRepeats clean(settings);
+
+  TEST_ASSERT_EQUAL_MESSAGE(settings.packetRepeats, clean.repeatsFor(*remoteConfig), "Should use packetRepeats before learning");
+
+  // Packets sent while nothing was listening say nothing about the link
+  observe_windows(clean, remoteConfig, ADAPTIVE_REPEATS_WARMUP_WINDOWS * 4, 0, ADAPTIVE_REPEATS_WINDOW_PACKETS, 0);
+  TEST_ASSERT_EQUAL_MESSAGE(settings.packetRepeats, clean.repeatsFor(*remoteConfig), "Unheard packets need a listener");
+
+  observe_windows(clean, remoteConfig, ADAPTIVE_REPEATS_WARMUP_WINDOWS - 1, ADAPTIVE_REPEATS_WINDOW_PACKETS, 0, 5);
+  TEST_ASSERT_EQUAL_MESSAGE(settings.packetRepeats, clean.repeatsFor(*remoteConfig), "Should warm up first");
+
+  observe_windows(clean, remoteConfig, 1, ADAPTIVE_REPEATS_WINDOW_PACKETS, 0, 5);
+  TEST_ASSERT_EQUAL_MESSAGE(settings.packetRepeatMinimum, clean.repeatsFor(*remoteConfig), "Clean link should learn the minimum");
+
+  // Half of the packets missed after 4 frames each: 0.5^(1/4) of frames lost
+  AdaptiveRepeats lossy(settings);
+  observe_windows(lossy, remoteConfig, ADAPTIVE_REPEATS_WARMUP_WINDOWS, 8, 8, 4);
+  TEST_ASSERT_EQUAL_MESSAGE(
+    AdaptiveRepeats::repeatsForLoss(841, settings.packetRepeatMinimum, settings.packetRepeats),
+    lossy.repeatsFor(*remoteConfig),
+    "Should turn missed packets into per-frame loss"
+  );
+
+  // Remotes sharing a radio config share the estimate
+  TEST_ASSERT_EQUAL(
+    lossy.repeatsFor(*remoteConfig),
+    lossy.repeatsFor(*MiLightRemoteConfig::fromType(REMOTE_TYPE_FUT089))
+  );
+
+  AdaptiveRepeats deaf(settings);
+  observe_windows(deaf, remoteConfig, ADAPTIVE_REPEATS_WARMUP_WINDOWS, 0, ADAPTIVE_REPEATS_WINDOW_PACKETS, 5);
+  TEST_ASSERT_EQUAL_MESSAGE(settings.packetRepeats, deaf.repeatsFor(*remoteConfig), "Hearing nothing back should keep every repeat");
+}
+
+void test_adaptive_repeats_from_echoes() {
+  const MiLightRemoteConfig* remoteConfig = MiLightRemoteConfig::fromType(REMOTE_TYPE_RGB_CCT);
+  std::shared_ptr<SimulatedRadioFactory> sendFactory = std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::NRF24);
+  std::vector<std::shared_ptr<MiLightRadioFactory>> factories = {
+    sendFactory,
+    std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::LT8900)
+  };
+  std::shared_ptr<SimulatedMiLightRadio> listener;
+  bool listenerInRange = true;
+
+  sendFactory->onWrite([&](const uint8_t* frame, size_t length) {
+    if (listener && listenerInRange) {
+      listener->hear(frame, length);
+    }
+  });
+
+  Settings settings;
+  settings.packetRepeats = 5;
+  settings.packetRepeatMinimum = 2;
+  GroupStateStore stateStore(10, 0);
+  RadioSwitchboard radios(factories, &stateStore, settings);
+  PacketSender sender(radios, settings, nullptr);
+  AdaptiveRepeats& adaptiveRepeats = sender.getAdaptiveRepeats();
+
+  listener = std::static_pointer_cast<SimulatedMiLightRadio>(radios.switchListenRadio(remoteConfig));
+  TEST_ASSERT_EQUAL_PTR(&remoteConfig->radioConfig, radios.listenConfig());
+
+  // Entries are only judged once they drop out of the recent packet ring
+  const size_t numPackets = ADAPTIVE_REPEATS_WINDOW_PACKETS * ADAPTIVE_REPEATS_WARMUP_WINDOWS + MILIGHT_MAX_RECENT_PACKETS;
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH] = { 0x20, 0x01, 0x02 };
+  uint8_t readPacket[MILIGHT_MAX_PACKET_LENGTH];
+  uint8_t sequence = 0;
+
+  for (size_t phase = 0; phase < 2; phase++) {
+    for (size_t i = 0; i < numPackets; i++) {
+      packet[3] = ++sequence;
+      sender.enqueue(packet, remoteConfig, settings.packetRepeats);
+
+      while (sender.isSending()) {
+        sender.loop();
+      }
+
+      while (radios.available()) {
+        size_t readLength = radios.read(readPacket);
+        sender.isEcho(listener->config(), readPacket, readLength);
+      }
+    }
+
+    if (phase == 0) {
+      TEST_ASSERT_EQUAL_MESSAGE(settings.packetRepeatMinimum, adaptiveRepeats.repeatsFor(*remoteConfig), "Every packet heard back");
+      listenerInRange = false;
+    }
+  }
+
+  TEST_ASSERT_EQUAL_MESSAGE(settings.packetRepeats, adaptiveRepeats.repeatsFor(*remoteConfig), "Nothing heard back");
+}
+
+// Sends a request through MiLightClient::update and decodes what comes out
+// of the sender
+std::vector<ParsedPacket> send_client_update(MiLightClient& client, PacketSender& sender, std::vector<ParsedPacket>& sent, const char* request) {
+  StaticJsonDocument<256> doc;
+  deserializeJson(doc, request);
+  sent.clear();
+
+  client.prepare(REMOTE_TYPE_RGB_CCT, 0x1234, 1);
+  client.update(doc.as<JsonObject>());
+
+  while (sender.isSending()) {
+    sender.loop();
+    yield();
+  }
+
+  return sent;
+}
+
+const ParsedPacket* find_parsed_field(const std::vector<ParsedPacket>& packets, ParsedPacketField field) {
+  for (const ParsedPacket& packet : packets) {
+    if (packet.has(field)) {
+      return &packet;
+    }
+  }
+  return NULL;
+}
+
+void test_client_field_setters() {
+  Settings settings;
+  settings.packetRepeats = 1;
+
+  GroupStateStore stateStore(10, 0);
+  RadioSwitchboard radios(std::make_shared<SimulatedRadioFactory>(SimulatedRadioTiming::NRF24), &stateStore, settings);
+  TransitionController transitions;
+  std::vector<ParsedPacket> sent;
+
+  PacketSender sender(radios, settings, [&sent](uint8_t* packet, const MiLightRemoteConfig& config) {
+    ParsedPacket result;
+    config.packetFormatter->parsePacket(packet, result);
+    sent.push_back(result);
+  });
+  MiLightClient client(radios, sender, &stateStore, settings, transitions);
+
+  std::vector<ParsedPacket> packets;
+  const ParsedPacket* parsed;
+
+  packets = send_client_update(client, sender, sent, "{\"hue\":120}");
+  parsed = find_parsed_field(packets, ParsedPacketField::HUE);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "hue should set hue");
+  TEST_ASSERT_INT_WITHIN_MESSAGE(2, 120, parsed->hue, "hue should set hue");
+
+  packets = send_client_update(client, sender, sent, "{\"saturation\":40}");
+  parsed = find_parsed_field(packets, ParsedPacketField::SATURATION);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "saturation should set saturation");
+  TEST_ASSERT_EQUAL_MESSAGE(40, parsed->saturation, "saturation should set saturation");
+
+  const char* temperatureRequests[] = { "{\"kelvin\":30}", "{\"temperature\":30}" };
+  for (const char* request : temperatureRequests) {
+    packets = send_client_update(client, sender, sent, request);
+    parsed = find_parsed_field(packets, ParsedPacketField::COLOR_TEMP);
+    TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "kelvin and temperature should set the white temperature");
+    TEST_ASSERT_INT_WITHIN_MESSAGE(10, Units::whiteValToMireds(30, 100), parsed->colorTemp, "kelvin and temperature should set the white temperature");
+  }
+
+  packets = send_client_update(client, sender, sent, "{\"color_temp\":300}");
+  parsed = find_parsed_field(packets, ParsedPacketField::COLOR_TEMP);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "color_temp should set mireds");
+  TEST_ASSERT_INT_WITHIN_MESSAGE(10, 300, parsed->colorTemp, "color_temp should set mireds");
+
+  packets = send_client_update(client, sender, sent, "{\"mode\":3}");
+  parsed = find_parsed_field(packets, ParsedPacketField::MODE);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "mode should set the mode");
+  TEST_ASSERT_EQUAL_MESSAGE(3, parsed->mode, "mode should set the mode");
+
+  packets = send_client_update(client, sender, sent, "{\"effect\":\"night_mode\"}");
+  parsed = find_parsed_field(packets, ParsedPacketField::COMMAND);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "effect should run the effect");
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(MiLightCommandNames::NIGHT_MODE, parsed->command, "effect should run the effect");
+
+  packets = send_client_update(client, sender, sent, "{\"color\":{\"r\":255,\"g\":0,\"b\":0}}");
+  parsed = find_parsed_field(packets, ParsedPacketField::HUE);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "color should set hue");
+  TEST_ASSERT_EQUAL_MESSAGE(0, parsed->hue, "color should set hue");
+  parsed = find_parsed_field(packets, ParsedPacketField::SATURATION);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "color should set saturation");
+  TEST_ASSERT_EQUAL_MESSAGE(100, parsed->saturation, "color should set saturation");
+
+  packets = send_client_update(client, sender, sent, "{\"level\":50}");
+  parsed = find_parsed_field(packets, ParsedPacketField::BRIGHTNESS);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "level should set brightness");
+  TEST_ASSERT_INT_WITHIN_MESSAGE(2, 128, parsed->brightness, "level should be a percentage");
+
+  packets = send_client_update(client, sender, sent, "{\"brightness\":255}");
+  parsed = find_parsed_field(packets, ParsedPacketField::BRIGHTNESS);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "brightness should set brightness");
+  TEST_ASSERT_EQUAL_MESSAGE(255, parsed->brightness, "brightness should be 0-255");
+
+  packets = send_client_update(client, sender, sent, "{\"command\":\"mode_speed_up\"}");
+  parsed = find_parsed_field(packets, ParsedPacketField::COMMAND);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "command should run the command");
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(MiLightCommandNames::MODE_SPEED_UP, parsed->command, "command should run the command");
+
+  packets = send_client_update(client, sender, sent, "{\"commands\":[\"mode_speed_down\"]}");
+  parsed = find_parsed_field(packets, ParsedPacketField::COMMAND);
+  TEST_ASSERT_NOT_NULL_MESSAGE(parsed, "commands should run each command");
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(MiLightCommandNames::MODE_SPEED_DOWN, parsed->command, "commands should run each command");
+
+  packets = send_client_update(client, sender, sent, "{\"not_a_field\":1}");
+  TEST_ASSERT_EQUAL_MESSAGE(0, packets.size(), "Unknown fields should be ignored");
+
+  // Brightness goes after mode whatever order the request has them in
+  packets = send_client_update(client, sender, sent, "{\"brightness\":255,\"mode\":2}");
+  TEST_ASSERT_EQUAL_MESSAGE(2, packets.size(), "Should send mode and brightness");
+  TEST_ASSERT_TRUE_MESSAGE(packets[0].has(ParsedPacketField::MODE), "Mode should be sent first");
+  TEST_ASSERT_TRUE_MESSAGE(packets[1].has(ParsedPacketField::BRIGHTNESS), "Brightness should be sent last");
+
+  // "temperature" transitions as kelvin
+  BulbId bulbId(0x1234, 1, REMOTE_TYPE_RGB_CCT);
+  GroupState state = GroupState::defaultState(REMOTE_TYPE_RGB_CCT);
+  state.setState(MiLightStatus::ON);
+  state.setKelvin(20);
+  stateStore.set(bulbId, state);
+
+  packets = send_client_update(client, sender, sent, "{\"temperature\":80,\"transition\":1}");
+  TEST_ASSERT_EQUAL_MESSAGE(0, packets.size(), "Transitions shouldn't send right away");
+
+  ListNode<std::shared_ptr<Transition>>* node = transitions.getTransitions();
+  TEST_ASSERT_NOT_NULL_MESSAGE(node, "temperature with a period should start a transition");
+
+  StaticJsonDocument<256> transitionJson;
+  JsonObject transition = transitionJson.to<JsonObject>();
+  node->data->serialize(transition);
+
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(GroupStateFieldNames::KELVIN, transition["field"], "temperature should transition kelvin");
+  TEST_ASSERT_EQUAL_MESSAGE(80, transition["end_value"].as<uint16_t>(), "Should transition to the requested temperature");
+
+  transitions.clear();
+
+  // A stamp covers one command, not whatever is sent after it
+  CommandLatency::reset();
+  client.stampCommand(CommandSource::MQTT);
+  packets = send_client_update(client, sender, sent, "{\"hue\":10,\"saturation\":20}");
+
+  const LatencyHistogram& stamped = CommandLatency::getHistogram(CommandSource::MQTT, LatencyStage::SENT);
+  const size_t numStamped = packets.size();
+  TEST_ASSERT_EQUAL_MESSAGE(2, numStamped, "Should send hue and saturation");
+  TEST_ASSERT_EQUAL_MESSAGE(numStamped, stamped.count, "Every packet of the stamped update should be traced");
+
+  send_client_update(client, sender, sent, "{\"hue\":30}");
+  client.updateStatus(MiLightStatus::OFF);
+
+  while (sender.isSending()) {
+    sender.loop();
+  }
+
+  TEST_ASSERT_EQUAL_MESSAGE(numStamped, stamped.count, "Later packets shouldn't reuse the stamp");
+}
+
+//================================================================================
+// Settings
+//================================================================================
+
+void test_settings_blob() {
+  Settings saved;
+  saved.adminUsername = "admin";
+  saved.ledPin = -2;
+  saved.packetRepeats = 20;
+  saved.wifiMode = WifiMode::G;
+  saved.rf24Channels = { RF24Channel::RF24_HIGH };
+  saved.deviceIds = { 0x1234, 0xBEEF };
+  saved.gatewayConfigs.push_back(std::make_shared<GatewayConfig>(0x1234, 5987, 6));
+  saved.groupIdAliases["kitchen"] = BulbId(0xAB, 2, REMOTE_TYPE_FUT089);
+
+  StaticJsonDocument<200> budgets;
+  deserializeJson(budgets, "{\"loop_stage_budgets\":{\"http\":20000,\"not_a_stage\":1}}");
+  saved.patch(budgets.as<JsonObject>());
+
+  // Keep clear of the hub's own settings
+  const char* blobFile = "/config.test.bin";
+  saved.save(blobFile);
+
+  Settings loaded;
+  Settings::load(loaded, blobFile);
+  SPIFFS.remove(blobFile);
+
+  TEST_ASSERT_EQUAL_MESSAGE(SUBSYSTEM_NONE, loaded.changedSubsystems(saved), "Should read back what was saved");
+  TEST_ASSERT_TRUE(loaded.adminUsername == "admin");
+  TEST_ASSERT_EQUAL(20, loaded.packetRepeats);
+  TEST_ASSERT_EQUAL(2, loaded.deviceIds.size());
+  TEST_ASSERT_EQUAL(0xBEEF, loaded.deviceIds[1]);
+  TEST_ASSERT_TRUE(loaded.wifiMode == WifiMode::G);
+  TEST_ASSERT_EQUAL(1, loaded.groupIdAliases.size());
+  TEST_ASSERT_EQUAL(LoopProfiler::NUM_STAGES, loaded.loopStageBudgets.size());
+  TEST_ASSERT_EQUAL_MESSAGE(20000, loaded.loopStageBudgets[static_cast<size_t>(LoopStage::HTTP)], "Budgets are keyed by stage name");
+  TEST_ASSERT_EQUAL(0, loaded.loopStageBudgets[static_cast<size_t>(LoopStage::LISTEN)]);
+
+  // Importing keeps the JSON around for older firmware
+  const char* jsonFile = "/config.test.json";
+  File f = SPIFFS.open(jsonFile, "w");
+  f.print(F("{\"packet_repeats\":30}"));
+  f.close();
+
+  Settings imported;
+  TEST_ASSERT_TRUE(Settings::importJson(imported, jsonFile, blobFile));
+  TEST_ASSERT_TRUE_MESSAGE(SPIFFS.exists(jsonFile), "JSON settings should be left in place");
+  SPIFFS.remove(jsonFile);
+
+  Settings reloaded;
+  Settings::load(reloaded, blobFile);
+  SPIFFS.remove(blobFile);
+  TEST_ASSERT_EQUAL_MESSAGE(30, reloaded.packetRepeats, "Import should save to the given binary file");
+
+  // A corrupt count shouldn't be trusted with an allocation
+  const uint8_t truncated[] = { 0xFF, 0xFF, 0x01, 0x02 };
+  std::vector<uint16_t> ids = { 0x1234 };
+  SettingsBlobReader reader(truncated, sizeof(truncated));
+  reader.field(ids);
+
+  TEST_ASSERT_TRUE(reader.isExhausted());
+  TEST_ASSERT_EQUAL_MESSAGE(1, ids.size(), "Field should keep its value");
+}
+
+void test_settings_changed_subsystems() {
+  Settings previous;
+  Settings settings = previous;
+
+  TEST_ASSERT_EQUAL(SUBSYSTEM_NONE, settings.changedSubsystems(previous));
+
+  settings.ledPin = 2;
+  TEST_ASSERT_EQUAL_MESSAGE(SUBSYSTEM_LED, settings.changedSubsystems(previous), "LED pin should only touch the LED");
+
+  settings = previous;
+  settings.packetRepeatsPerLoop = 1;
+  settings.mqttStateRateLimit = 1;
+  TEST_ASSERT_EQUAL_MESSAGE(SUBSYSTEM_NONE, settings.changedSubsystems(previous), "Settings read on use shouldn't rebuild anything");
+
+  settings = previous;
+  settings.csnPin = 16;
+  settings._mqttServer = "mqtt";
+  TEST_ASSERT_EQUAL(SUBSYSTEM_RADIOS | SUBSYSTEM_MQTT, settings.changedSubsystems(previous));
+
+  settings = previous;
+  settings.groupIdAliases["kitchen"] = BulbId(0xAB, 2, REMOTE_TYPE_FUT089);
+  TEST_ASSERT_EQUAL_MESSAGE(SUBSYSTEM_HOME_ASSISTANT, settings.changedSubsystems(previous), "Aliases shouldn't reconnect MQTT");
+}
+
+void test_loop_scheduler() {
+  // No budget, so everything after the first task is put off
+  LoopScheduler scheduler(0);
+  String order;
+
+  scheduler.addTask(LoopStage::HTTP, LoopTaskPriority::NORMAL, 0, [&order]() { order += "h"; });
+  scheduler.addTask(LoopStage::PACKET_SENDER, LoopTaskPriority::CRITICAL, 0, [&order]() { order += "p"; });
+  scheduler.addTask(LoopStage::LISTEN, LoopTaskPriority::CRITICAL, 0, [&order]() { order += "l"; });
+
+  scheduler.loop();
+  TEST_ASSERT_EQUAL_STRING_MESSAGE("pl", order.c_str(), "Critical tasks run regardless of budget, in the order added");
+
+  for (size_t i = 1; i < MILIGHT_LOOP_MAX_DEFERRALS; i++) {
+    scheduler.loop();
+  }
+  TEST_ASSERT_EQUAL_MESSAGE(-1, order.indexOf('h'), "Other tasks wait while the loop is over budget");
+
+  scheduler.loop();
+  TEST_ASSERT_TRUE_MESSAGE(order.endsWith("plh"), "Tasks put off too many times run anyway");
+}
+
+void test_packet_log() {
+  const uint16_t capacity = 5;
+  const uint8_t numPackets = 7;
+  const MiLightRadioConfig& radioConfig = MiLightRadioConfig::ALL_CONFIGS[1];
+  uint8_t packet[MILIGHT_MAX_PACKET_LENGTH];
+  // Keep clear of the hub's own log
+  const char* logFile = "/packets.test.log";
+
+  {
+    PacketLog log(logFile);
+    log.setCapacity(capacity);
+    log.clear();
+
+    // Two batches, the second wrapping around the end of the ring
+    for (uint8_t i = 0; i < numPackets; i++) {
+      memset(packet, i, sizeof(packet));
+      log.record(i % 2 ? PacketDirection::RECEIVED : PacketDirection::SENT, radioConfig, packet, radioConfig.packetLength);
+
+      if (i == 2) {
+        log.flush();
+      }
+    }
+    log.flush();
+  }
+
+  // Picks up where the last one left off
+  PacketLog log(logFile);
+  log.setCapacity(capacity);
+
+  std::vector<PacketLogEntry> replayed;
+  TEST_ASSERT_TRUE_MESSAGE(
+    log.startReplay(0, [&replayed](const PacketLogEntry& entry) {
+      replayed.push_back(entry);
+      return true;
+    }),
+    "Should start replaying a non-empty log"
+  );
+
+  for (size_t i = 0; i < numPackets && log.isReplaying(); i++) {
+    log.loop();
+  }
+
+  TEST_ASSERT_FALSE_MESSAGE(log.isReplaying(), "Replay should finish");
+  TEST_ASSERT_EQUAL_MESSAGE(capacity, replayed.size(), "Only the newest packets fit in the ring");
+
+  for (size_t i = 0; i < replayed.size(); i++) {
+    const PacketLogEntry& entry = replayed[i];
+    const uint8_t expected = numPackets - capacity + i;
+
+    TEST_ASSERT_EQUAL_MESSAGE(expected, entry.packet[0], "Should replay oldest first");
+    TEST_ASSERT_EQUAL_MESSAGE(radioConfig.packetLength, entry.length, "Should keep packet length");
+    TEST_ASSERT_EQUAL_MESSAGE(1, entry.radioConfig, "Should keep radio config");
+    TEST_ASSERT_TRUE_MESSAGE(
+      entry.direction == (expected % 2 ? PacketDirection::RECEIVED : PacketDirection::SENT),
+      "Should keep direction"
+    );
+  }
+
+  // Nothing is logged while replaying, and a handler that isn't ready gets
+  // the same packet again
+  size_t attempts = 0;
+  log.startReplay(0, [&attempts](const PacketLogEntry& entry) {
+    return ++attempts > 1;
+  });
+  log.record(PacketDirection::SENT, radioConfig, packet, radioConfig.packetLength);
+  log.loop();
+  log.loop();
+  log.stopReplay();
+
+  StaticJsonDocument<200> stats;
+  log.serialize(stats.to<JsonObject>());
+
+  TEST_ASSERT_EQUAL_MESSAGE(capacity, stats["count"].as<uint16_t>(), "Replay shouldn't be logged");
+  TEST_ASSERT_TRUE_MESSAGE(attempts > 1, "Declined packet should be offered again");
+
+  log.setCapacity(0);
+  TEST_ASSERT_FALSE_MESSAGE(SPIFFS.exists(logFile), "Turning the log off should remove it");
+}
+
 // setup connects serial, runs test cases (upcoming)
 void setup() {
   delay(2000);
@@ -354,9 +1877,40 @@ void setup() {
   RUN_TEST(test_persistence);
   RUN_TEST(test_store);
   RUN_TEST(test_group_0);
+  RUN_TEST(test_state_snapshot);
+  RUN_TEST(test_json_patch);
+  RUN_TEST(test_packet_replay_patch_benchmark);
 
   RUN_TEST(test_fut091_packet_formatter);
   RUN_TEST(test_fut092_packet_formatter);
+  RUN_TEST(test_received_packet_classifier);
+  RUN_TEST(test_cct_step_planner);
+  RUN_TEST(test_cct_step_planner_group_0);
+
+  RUN_TEST(test_v5_udp_command_table);
+  RUN_TEST(test_v5_udp_command_table_matches_reference);
+  RUN_TEST(test_v5_udp_decode_benchmark);
+  RUN_TEST(test_v6_udp_button_table);
+
+  RUN_TEST(test_rgb_to_hsv_accuracy);
+  RUN_TEST(test_hsv_to_rgb_accuracy);
+  RUN_TEST(test_color_conversion_benchmark);
+  RUN_TEST(test_hsv_transition_plan);
+
+  RUN_TEST(test_radio_throughput_by_remote);
+  RUN_TEST(test_radio_throughput_by_load);
+  RUN_TEST(test_radio_switchboard_modules);
+  RUN_TEST(test_listen_ignores_echoes);
+  RUN_TEST(test_interleaved_repeats);
+  RUN_TEST(test_packet_sender_handover);
+  RUN_TEST(test_adaptive_repeats);
+  RUN_TEST(test_adaptive_repeats_from_echoes);
+  RUN_TEST(test_client_field_setters);
+
+  RUN_TEST(test_settings_blob);
+  RUN_TEST(test_settings_changed_subsystems);
+  RUN_TEST(test_loop_scheduler);
+  RUN_TEST(test_packet_log);
 
   UNITY_END();
 }
@@ -0,0 +1,124 @@
+require 'json'
+
+module PerfHelpers
+  # Thresholds can be overridden with ESPMH_PERF_<NAME> environment variables
+  def perf_setting(name, default)
+    Float(ENV.fetch("ESPMH_PERF_#{name.to_s.upcase}", default))
+  end
+
+  def monotonic_now
+    Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  end
+
+  # Nearest-rank percentile.  Returns nil for an empty list.
+  def percentile(samples, pct)
+    return nil if samples.empty?
+
+    sorted = samples.sort
+    sorted[[(pct / 100.0 * sorted.length).ceil - 1, 0].max]
+  end
+
+  # Calls the block `rate` times a second for `duration` seconds, on a fixed
+  # schedule so a slow call doesn't lower the offered rate.  The block should
+  # return true if the command was handled.  Returns the latency of each
+  # handled command (in ms), the number that weren't, and how long it took.
+  def drive_at_rate(rate, duration)
+    interval = 1.0 / rate
+    latencies = []
+    failures = 0
+    start = monotonic_now
+
+    (rate * duration).to_i.times do |i|
+      delay = (start + i * interval) - monotonic_now
+      sleep(delay) if delay > 0
+
+      sent_at = monotonic_now
+      handled =
+        begin
+          yield i
+        rescue StandardError => e
+          puts "Command #{i} failed: #{e}"
+          false
+        end
+
+      if handled
+        latencies << (monotonic_now - sent_at) * 1000
+      else
+        failures += 1
+      end
+    end
+
+    {
+      latencies: latencies,
+      failures: failures,
+      elapsed: monotonic_now - start
+    }
+  end
+
+  # Counters from /about that should stay flat while the hub keeps up
+  def hub_counters(client)
+    about = client.get('/about')
+
+    {
+      free_heap: about['free_heap'],
+      dropped_packets: about['queue_stats']['dropped_packets'],
+      dropped_datagrams: about['udp_stats'].map { |s| s['dropped'] }.sum
+    }
+  end
+
+  def counter_deltas(before, after)
+    {
+      dropped_packets: after[:dropped_packets] - before[:dropped_packets],
+      dropped_datagrams: after[:dropped_datagrams] - before[:dropped_datagrams]
+    }
+  end
+
+  # On-air latency for one source, as reported by /command_latency
+  def on_air_latency(client, source)
+    stats = client.get('/command_latency')['sources'][source]
+    return nil unless stats
+
+    {
+      count: stats['sent']['count'],
+      p50_ms: stats['sent']['p50_us'] / 1000.0,
+      p99_ms: stats['sent']['p99_us'] / 1000.0
+    }
+  end
+
+  # Anything in extra overrides the figures worked out from the run
+  def summarize_run(name, rate, run, extra = {})
+    result = {
+      offered_rate: rate,
+      throughput: run[:latencies].length / run[:elapsed],
+      failures: run[:failures],
+      p50_ms: percentile(run[:latencies], 50),
+      p99_ms: percentile(run[:latencies], 99)
+    }.merge(extra)
+
+    puts "#{name}: #{result.to_json}"
+    result
+  end
+
+  def perf_baseline
+    path = ENV.fetch('ESPMH_PERF_BASELINE', 'perf_baseline.json')
+    File.exist?(path) ? JSON.parse(File.read(path)) : {}
+  end
+
+  def write_perf_results(results)
+    path = ENV.fetch('ESPMH_PERF_RESULTS', 'perf_results.json')
+    File.write(path, JSON.pretty_generate(results))
+  end
+
+  # Fails if throughput dropped more than the allowed fraction below what's
+  # recorded in the baseline file.  Results files can be used as baselines.
+  def expect_no_throughput_regression(name, result)
+    baseline = perf_baseline[name]
+    return unless baseline
+
+    tolerance = perf_setting(:throughput_tolerance, 0.1)
+    minimum = baseline['throughput'] * (1 - tolerance)
+
+    expect(result[:throughput]).to be >= minimum,
+      "#{name} throughput #{result[:throughput].round(2)}/s is below baseline #{baseline['throughput'].round(2)}/s"
+  end
+end
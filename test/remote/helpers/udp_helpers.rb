@@ -0,0 +1,81 @@
+require 'socket'
+
+module UdpHelpers
+  # Matches V6_MAX_SESSIONS in V6MiLightUdpServer.h
+  V6_MAX_SESSIONS = 10
+
+  V6_START_SESSION_COMMAND = [
+    0x20, 0x00, 0x00, 0x00, 0x16, 0x02, 0x62, 0x3A, 0xD5, 0xED, 0xA3, 0x01, 0xAE,
+    0x08, 0x2D, 0x46, 0x61, 0x41, 0xA7, 0xF6, 0xDC, 0xAF
+  ]
+
+  # Trace captured from the official iOS app controlling an RGBW group: a
+  # keepalive followed by on, color, and brightness slider commands.
+  V6_RGBW_TRACE = [
+    [:heartbeat],
+    [:command, [0x31, 0x00, 0x00, 0x07, 0x03, 0x01, 0x00, 0x00, 0x00]],
+    [:command, [0x31, 0x00, 0x00, 0x07, 0x01, 0x10, 0x00, 0x00, 0x00]],
+    [:command, [0x31, 0x00, 0x00, 0x07, 0x01, 0x48, 0x00, 0x00, 0x00]],
+    [:command, [0x31, 0x00, 0x00, 0x07, 0x02, 0x0A, 0x00, 0x00, 0x00]],
+    [:heartbeat],
+    [:command, [0x31, 0x00, 0x00, 0x07, 0x02, 0x28, 0x00, 0x00, 0x00]],
+    [:command, [0x31, 0x00, 0x00, 0x07, 0x02, 0x3C, 0x00, 0x00, 0x00]]
+  ]
+
+  def v6_start_session(socket, host, port)
+    socket.send(V6_START_SESSION_COMMAND.pack('C*'), 0, host, port)
+    response = udp_receive(socket)
+
+    raise "No response to V6 start session command" if response.nil?
+
+    bytes = response.unpack('C*')
+    (bytes[19] << 8) | bytes[20]
+  end
+
+  def v6_heartbeat_packet(session_id)
+    [0xD0, 0x00, 0x00, 0x00, 0x02, session_id >> 8, session_id & 0xFF, 0x00].pack('C*')
+  end
+
+  def v6_command_packet(session_id, sequence_num, command, group)
+    payload = command + [group, 0x00]
+    header = [0x80, 0x00, 0x00, 0x00, 0x11, session_id >> 8, session_id & 0xFF, 0x00, sequence_num & 0xFF, 0x00]
+
+    (header + payload + [payload.sum & 0xFF]).pack('C*')
+  end
+
+  # Sends each packet in the trace for the given session.  Returns the
+  # sequence numbers used for commands, which are echoed in the hub's acks.
+  def v6_replay_trace(socket, host, port, session_id, group, trace, sequence_start = 0)
+    sequence_num = sequence_start
+
+    trace.map do |(type, command)|
+      if type == :heartbeat
+        socket.send(v6_heartbeat_packet(session_id), 0, host, port)
+        nil
+      else
+        socket.send(v6_command_packet(session_id, sequence_num, command, group), 0, host, port)
+        sequence_num += 1
+        sequence_num - 1
+      end
+    end.compact
+  end
+
+  # Collects command acks (0x88 responses) until the socket goes quiet.
+  # Returns the acknowledged sequence numbers.
+  def v6_collect_acks(socket, timeout = 1)
+    acks = []
+
+    while (response = udp_receive(socket, timeout))
+      bytes = response.unpack('C*')
+      acks << bytes[6] if bytes[0] == 0x88
+    end
+
+    acks
+  end
+
+  def udp_receive(socket, timeout = 1)
+    return nil unless IO.select([socket], nil, nil, timeout)
+    response, _ = socket.recvfrom_nonblock(1024)
+    response
+  end
+end
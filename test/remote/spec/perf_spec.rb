@@ -0,0 +1,151 @@
+require 'api_client'
+require 'socket'
+
+# Drives sustained command rates and checks the hub keeps up.  Excluded from
+# the default run, use `bundle exec rspec --tag perf`.
+#
+# Runs in order regardless of the random ordering in spec_helper, so the heap
+# check sees the samples from every run before it.
+RSpec.describe 'Performance', perf: true, order: :defined do
+  before(:all) do
+    @client = ApiClient.from_environment
+    @client.upload_json('/settings', 'settings.json')
+
+    @duration = perf_setting(:duration, 20)
+    @min_throughput_ratio = perf_setting(:min_throughput_ratio, 0.95)
+    @max_dropped = perf_setting(:max_dropped, 0)
+
+    @results = {}
+    @heap_samples = [hub_counters(@client)[:free_heap]]
+  end
+
+  after(:all) do
+    @results['heap'] = { free_heap: @heap_samples }
+    write_perf_results(@results)
+  end
+
+  before(:each) do
+    @id_params = {
+      id: @client.generate_id,
+      type: 'rgb_cct',
+      group_id: 1
+    }
+    @client.delete_state(@id_params)
+    @client.delete('/command_latency')
+    @counters_before = hub_counters(@client)
+  end
+
+  after(:each) do
+    # Let the queue drain before the next sample
+    sleep 2
+    @heap_samples << hub_counters(@client)[:free_heap]
+  end
+
+  def check_result(name, result)
+    expect(result[:throughput]).to be >= result[:offered_rate] * @min_throughput_ratio
+    expect(result[:p99_ms]).to be <= perf_setting("#{name}_p99_ms", 500)
+    expect(result[:dropped_packets]).to be <= @max_dropped
+    expect(result[:dropped_datagrams]).to be <= @max_dropped
+
+    expect_no_throughput_regression(name, result)
+  end
+
+  context 'HTTP' do
+    it 'should keep up with a sustained command rate' do
+      rate = perf_setting(:http_rate, 10)
+
+      run = drive_at_rate(rate, @duration) do |i|
+        @client.patch_state({ level: i % 100 }, @id_params.merge(blockOnQueue: false))
+        true
+      end
+
+      sleep 2
+      deltas = counter_deltas(@counters_before, hub_counters(@client))
+      result = summarize_run('http', rate, run, deltas.merge(on_air: on_air_latency(@client, 'http')))
+
+      @results['http'] = result
+      check_result('http', result)
+    end
+  end
+
+  context 'MQTT' do
+    before(:all) do
+      @client.patch_settings(mqtt_parameters())
+      @mqtt_client = create_mqtt_client()
+    end
+
+    it 'should keep up with a sustained command rate' do
+      rate = perf_setting(:mqtt_rate, 10)
+
+      # Publishing doesn't wait for the hub, so throughput and latency come
+      # from what the hub reports having sent
+      run = drive_at_rate(rate, @duration) do |i|
+        @mqtt_client.patch_state(@id_params, level: i % 100)
+        true
+      end
+
+      sleep 2
+      deltas = counter_deltas(@counters_before, hub_counters(@client))
+      on_air = on_air_latency(@client, 'mqtt')
+
+      expect(on_air).to_not be_nil, 'Hub should have sent MQTT commands'
+
+      result = summarize_run('mqtt', rate, run, deltas.merge(
+        on_air: on_air,
+        throughput: on_air[:count] / run[:elapsed],
+        p50_ms: on_air[:p50_ms],
+        p99_ms: on_air[:p99_ms]
+      ))
+
+      @results['mqtt'] = result
+      check_result('mqtt', result)
+    end
+  end
+
+  context 'UDP' do
+    before(:all) do
+      @v6_udp_port = Integer(ENV.fetch('ESPMH_V6_UDP_PORT'))
+      @v6_device_id = @client.generate_id
+
+      @client.patch_settings(gateway_configs: [[@v6_device_id, @v6_udp_port, 6]])
+
+      @socket = UDPSocket.new
+      @session_id = v6_start_session(@socket, ENV.fetch('ESPMH_HOSTNAME'), @v6_udp_port)
+    end
+
+    after(:all) do
+      @socket.close
+    end
+
+    it 'should keep up with a sustained v6 command rate' do
+      rate = perf_setting(:udp_rate, 20)
+      host = ENV.fetch('ESPMH_HOSTNAME')
+      trace = UdpHelpers::V6_RGBW_TRACE.select { |(type, _)| type == :command }.map(&:last)
+
+      # Latency is time to the hub's ack
+      run = drive_at_rate(rate, @duration) do |i|
+        sequence_num = i & 0xFF
+        @socket.send(v6_command_packet(@session_id, sequence_num, trace[i % trace.length], 1), 0, host, @v6_udp_port)
+
+        response = udp_receive(@socket)
+        !response.nil? && response.unpack('C*')[6] == sequence_num
+      end
+
+      sleep 2
+      deltas = counter_deltas(@counters_before, hub_counters(@client))
+      result = summarize_run('udp', rate, run, deltas.merge(on_air: on_air_latency(@client, 'udp_v6')))
+
+      @results['udp'] = result
+      check_result('udp', result)
+    end
+  end
+
+  context 'heap' do
+    it 'should not trend down across the runs' do
+      max_loss = perf_setting(:max_heap_loss, 2048)
+
+      puts "Free heap after each run: #{@heap_samples.join(', ')}"
+      expect(@heap_samples.last).to be >= @heap_samples.first - max_loss
+    end
+  end
+end
@@ -2,6 +2,8 @@ require 'dotenv'
 require './helpers/state_helpers'
 require './helpers/mqtt_helpers'
 require './helpers/transition_helpers'
+require './helpers/udp_helpers'
+require './helpers/perf_helpers'
 
 Dotenv.load('espmh.env')
 
@@ -24,6 +26,11 @@ RSpec.configure do |config|
   config.include StateHelpers
   config.include MqttHelpers
   config.include TransitionHelpers
+  config.include UdpHelpers
+  config.include PerfHelpers
+
+  # Performance specs take a while.  Run them with `--tag perf`.
+  config.filter_run_excluding perf: true
 
   # rspec-expectations config goes here. You can use an alternate
   # assertion/expectation library such as wrong or the stdlib/minitest
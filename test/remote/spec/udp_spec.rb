@@ -106,6 +106,73 @@ RSpec.describe 'UDP servers' do
     end
   end
 
+  context 'v6 sessions under load' do
+    before(:each) do
+      @v6_host = ENV.fetch('ESPMH_HOSTNAME')
+      @v6_sockets = []
+    end
+
+    after(:each) do
+      @v6_sockets.each(&:close)
+    end
+
+    def open_v6_session
+      socket = UDPSocket.new
+      socket.bind('0.0.0.0', 0)
+      @v6_sockets << socket
+
+      [socket, v6_start_session(socket, @v6_host, @v6_udp_port)]
+    end
+
+    it 'should acknowledge a captured trace replayed at high rate' do
+      sessions = (1..UdpHelpers::V6_MAX_SESSIONS).map { open_v6_session }
+      sent = Hash.new { |h, k| h[k] = [] }
+
+      20.times do |i|
+        sessions.each do |(socket, session_id)|
+          sent[socket] += v6_replay_trace(
+            socket,
+            @v6_host,
+            @v6_udp_port,
+            session_id,
+            @v6_id_params[:group_id],
+            UdpHelpers::V6_RGBW_TRACE,
+            i * UdpHelpers::V6_RGBW_TRACE.length
+          )
+        end
+      end
+
+      total_sent = sent.values.map(&:length).sum
+      total_acked = sent.keys.map { |socket| (v6_collect_acks(socket) & sent[socket]).length }.sum
+
+      expect(total_acked.to_f / total_sent).to be >= 0.9
+
+      # Wait for the queue to drain
+      state = @client.get_state(@v6_id_params)
+      expect(state['status']).to eq('ON')
+      expect(state['level']).to eq(60)
+    end
+
+    it 'should evict the least recently used session' do
+      socket, active_session = open_v6_session
+      others = (1...UdpHelpers::V6_MAX_SESSIONS).map { open_v6_session }
+
+      # Keep the first session fresh, then open one more to force an eviction
+      socket.send(v6_heartbeat_packet(active_session), 0, @v6_host, @v6_udp_port)
+      expect(udp_receive(socket)).to_not be_nil
+      open_v6_session
+
+      command = UdpHelpers::V6_RGBW_TRACE.find { |(type, _)| type == :command }[1]
+
+      socket.send(v6_command_packet(active_session, 1, command, @v6_id_params[:group_id]), 0, @v6_host, @v6_udp_port)
+      expect(v6_collect_acks(socket)).to include(1)
+
+      evicted_socket, evicted_session = others.first
+      evicted_socket.send(v6_command_packet(evicted_session, 1, command, @v6_id_params[:group_id]), 0, @v6_host, @v6_udp_port)
+      expect(v6_collect_acks(evicted_socket)).to be_empty
+    end
+  end
+
   context 'discovery' do
     before(:all) do
       @client.patch_settings(
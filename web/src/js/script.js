@@ -216,6 +216,35 @@ var UI_FIELDS = [ {
       'LT8900': 'PL1167/LT8900'
     },
     tab: "tab-radio"
+  }, {
+    tag:   "secondary_radio_interface_type",
+    friendly: "Secondary radio interface type",
+    help: "Optional second 2.4 GHz radio.  It listens for packets while the primary radio is sending.",
+    type: "option_buttons",
+    options: {
+      'none': 'None',
+      'nRF24': 'nRF24',
+      'LT8900': 'PL1167/LT8900'
+    },
+    tab: "tab-radio"
+  }, {
+    tag:   "secondary_csn_pin",
+    friendly: "Secondary CSN pin",
+    help: "CSN pin (nRF24) or CS pin (LT8900) for the secondary radio. Default for D1 Mini is 16 (D0)",
+    type: "string",
+    tab: "tab-setup"
+  }, {
+    tag:   "secondary_ce_pin",
+    friendly: "Secondary CE pin",
+    help: "CE pin (nRF24) or PKT_FLAG pin (LT8900) for the secondary radio. Default for D1 Mini is 5 (D1)",
+    type: "string",
+    tab: "tab-setup"
+  }, {
+    tag:   "secondary_reset_pin",
+    friendly: "Secondary reset pin",
+    help: "Reset pin for a secondary LT8900",
+    type: "string",
+    tab: "tab-setup"
   }, {
     tag:   "rf24_power_level",
     friendly: "nRF24 Power Level",
@@ -297,6 +326,29 @@ var UI_FIELDS = [ {
     "of repeated packets (defaults to 3)",
     type: "string",
     tab: "tab-radio"
+  }, {
+    tag:   "interleave_packet_repeats",
+    friendly: "Interleave packet repeats",
+    help: "Send repeats of queued packets for different devices round-robin instead of one packet " +
+    "after another.  Each packet in a burst reaches bulbs sooner.",
+    type: "option_buttons",
+    options: {
+      true: 'Enable',
+      false: 'Disable'
+    },
+    tab: "tab-radio"
+  }, {
+    tag:   "adaptive_packet_repeats",
+    friendly: "Adaptive packet repeats",
+    help: "Learn how many repeats each remote type needs from how many of its own packets a second " +
+    "radio module hears back.  Stays between the packet repeat minimum and packet repeats.  Requires " +
+    "a second radio and listen repeats.",
+    type: "option_buttons",
+    options: {
+      true: 'Enable',
+      false: 'Disable'
+    },
+    tab: "tab-radio"
   }, {
     tag:   "group_state_fields",
     friendly: "Group state fields",